@@ -0,0 +1,66 @@
+#ifndef ANEL_SHM_H
+#define ANEL_SHM_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#define ANEL_SHM_CAPACIDADE (256 * 1024)   // bytes de cada sentido (potência de 2)
+#define ANEL_SHM_VERSAO 1
+
+// Pedido do cliente pelo socket Unix e respostas do servidor (o aceite
+// chega com memfd, eventfd do servidor e eventfd do cliente em SCM_RIGHTS)
+#define ANEL_SHM_PEDIDO "/shm"
+#define ANEL_SHM_ACEITE "shm ok"
+#define ANEL_SHM_RECUSA "shm recusado"
+
+/*
+ * Anel de bytes de um produtor e um consumidor em memória compartilhada
+ * entre processos (canal de clientes na mesma máquina). Os bytes são os
+ * mesmos do protocolo de enquadramento, como num socket. Cabeça e cauda
+ * são contadores monotônicos, cada um escrito por um único lado.
+ *
+ * Sinalização (eventfd de cada lado): quem vai dormir marca o próprio
+ * lado como esperando e confere o anel de novo; o outro lado só paga o
+ * write no eventfd quando encontra a marca. Com os dois lados ocupados
+ * nenhum syscall é feito.
+ */
+typedef struct {
+    _Alignas(64) atomic_uint_fast64_t cabeca;   // bytes escritos (só o produtor altera)
+    atomic_int produtor_esperando;              // produtor sem espaço: acordar ao consumir
+    _Alignas(64) atomic_uint_fast64_t cauda;    // bytes consumidos (só o consumidor altera)
+    atomic_int consumidor_ocioso;               // consumidor dormindo: acordar ao escrever
+    _Alignas(64) char dados[ANEL_SHM_CAPACIDADE];
+} anel_shm_t;
+
+// Região mapeada por servidor e cliente (memfd passado pelo socket Unix)
+typedef struct {
+    uint32_t versao;
+    uint32_t capacidade;
+    anel_shm_t entrada;     // cliente -> servidor
+    anel_shm_t saida;       // servidor -> cliente
+} canal_shm_t;
+
+void anel_shm_iniciar(canal_shm_t *canal);
+
+// Produtor: copia o que couber dos iovecs. @return bytes copiados
+size_t anel_shm_escrever(anel_shm_t *a, const struct iovec *iov, size_t n);
+
+// Consumidor: trecho contíguo já escrito (válido até anel_shm_consumir)
+// @return bytes em *dados (0 = anel vazio)
+size_t anel_shm_trecho(anel_shm_t *a, const char **dados);
+void anel_shm_consumir(anel_shm_t *a, size_t n);
+
+// Consumidor sem dados: marca ocioso e confere de novo
+// @return 1 se pode dormir no eventfd, 0 se chegaram dados nesse meio tempo
+int anel_shm_adormecer(anel_shm_t *a);
+// Produtor sem espaço: marca a espera e confere de novo
+// @return 1 se pode dormir no eventfd, 0 se já há espaço
+int anel_shm_aguardar_espaco(anel_shm_t *a);
+
+// Depois de escrever / consumir: @return 1 se o outro lado deve ser acordado
+int anel_shm_publicado(anel_shm_t *a);
+int anel_shm_liberado(anel_shm_t *a);
+
+#endif
@@ -0,0 +1,185 @@
+#ifndef CONEXAO_H
+#define CONEXAO_H
+
+#include "../include/protocolo.h"
+#include "../include/quadro.h"
+#include "../include/limites.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// Máximo de quadros reunidos em um único writev
+#define SAIDA_MAX_IOV 64
+#define SAIDA_CAPACIDADE_INICIAL 16
+
+// Fila de saída limitada por marcas alta/baixa (em bytes). Guarda apenas
+// referências a quadros compartilhados, em um anel que cresce sob demanda.
+typedef struct {
+    pthread_mutex_t mutex;
+    quadro_t **itens;
+    size_t capacidade;           // potência de 2
+    size_t inicio;
+    size_t quantidade;
+    size_t enviados;             // bytes já enviados do primeiro quadro
+    size_t bytes;                // bytes pendentes na fila
+    int escrita_armada;          // EPOLLOUT registrado no epoll do dono
+    int lenta;                   // passou da marca alta e ainda não desceu da baixa
+    struct timespec lenta_desde;
+    uint64_t desde_ns;           // chegada do quadro mais antigo da fila (coalescência)
+    int transferida;             // socket passado a outro processo: a fila só acumula
+} fila_saida_t;
+
+// Laço de eventos dono de conexões (um reactor ou a thread de um cliente)
+typedef struct laco {
+    uint64_t id;
+    int epfd;
+    struct conexao *pendentes;   // conexões com saída a descarregar ao fim da iteração
+    struct conexao *adiados;     // pendentes segurados pela janela de coalescência
+    uint64_t prazo_ns;           // fim da janela mais próxima entre os adiados
+    struct conexao *suspensas;   // leitura parada pelo limite de taxa (atrasar)
+    uint64_t retomada_ns;        // retomada mais próxima entre as suspensas
+    // Envio próprio do backend (NULL = conexao_descarregar com sendmsg)
+    int (*descarregar)(struct laco *laco, struct conexao *c);
+} laco_t;
+
+typedef struct conexao {
+    uint64_t id;                 // identificador único (nunca reutilizado)
+    uint64_t handle;             // handle no registro de conexões (0 = fora dele)
+    int fd;
+    char ip[INET_ADDRSTRLEN];    // "unix" nas conexões locais
+    int porta;                   // id da conexão nas conexões locais
+    int local;                   // aceita pelo socket Unix
+    struct canal_local *shm;     // anéis em memória compartilhada (NULL = socket)
+    atomic_int refs;
+    atomic_int encerrada;
+    proto_ring_t ring;           // buffer de recepção com quadros parciais (no mesmo objeto do slab)
+    size_t memoria;              // custo fixo cobrado do orçamento no add_client (0 = fora dele)
+    fila_saida_t saida;
+
+    // Laço dono: só ele lê, descarrega a fila e fecha a conexão
+    int epfd;
+    uint64_t laco_id;
+    int epfd_proprio;            // epfd é fechado junto com a conexão (modo threads)
+    struct conexao *prox_pendente;
+    int pendente;
+    void *transporte;            // estado do backend de I/O do laço dono (modo uring)
+
+    // Limite de taxa de entrada (só o laço dono cobra e suspende)
+    limite_conexao_t limite;
+    uint64_t retomar_ns;         // suspensa até este instante (0 = lendo)
+    struct conexao *prox_suspensa;
+
+    // Sala atual e posição no índice de membros dela (só o laço dono altera)
+    struct sala *sala;
+    size_t indice_sala;
+
+    // Lista de conexões do reactor dono
+    struct conexao *ant;
+    struct conexao *prox;
+} conexao_t;
+
+// Parâmetros de backpressure da fila de saída
+typedef struct {
+    size_t marca_alta;           // acima disso novas mensagens são descartadas
+    size_t marca_baixa;          // abaixo disso o cliente deixa de ser considerado lento
+    int despejo_ms;              // tempo máximo acima da marca alta antes do despejo
+    int coalescer_us;            // janela de coalescência (0 = envio a cada iteração)
+    size_t coalescer_bytes;      // bytes na fila que encerram a janela antes do prazo
+} config_saida_t;
+
+#define SAIDA_MARCA_ALTA_PADRAO (1024 * 1024)
+#define SAIDA_MARCA_BAIXA_PADRAO (256 * 1024)
+#define SAIDA_DESPEJO_MS_PADRAO 5000
+#define SAIDA_COALESCER_BYTES_PADRAO (16 * 1024)
+
+void conexao_configurar_saida(const config_saida_t *cfg);
+
+// Cria o slab das conexões (antes do primeiro conexao_criar)
+// @return 0 em sucesso, -1 se não há classe de slab livre
+int conexao_iniciar(void);
+
+// Cria a conexão com uma referência (do chamador); endereço que não é
+// AF_INET (ou NULL) indica uma conexão do socket Unix
+conexao_t *conexao_criar(int fd, const struct sockaddr_in *addr);
+void conexao_ref(conexao_t *c);
+void conexao_unref(conexao_t *c);
+
+// Registra o socket no epoll do laço dono (edge-triggered); em um laço
+// sem epoll (epfd < 0) apenas associa a conexão ao laço
+int conexao_registrar(conexao_t *c, laco_t *laco);
+
+// Troca o laço dono de uma conexão já registrada (pool de workers: o worker
+// que a atende no momento). Só quem é dono no momento chama.
+void conexao_definir_laco(conexao_t *c, const laco_t *laco);
+
+// Enfileira um payload (codifica o quadro) ou uma referência a um quadro
+// compartilhado (a fila toma sua própria referência, sem copiar os bytes).
+// Pode ser chamado de qualquer thread; nunca bloqueia em I/O.
+// @return 0 se enfileirado, -1 se descartado (conexão encerrada, acima da marca
+// alta ou sem espaço no orçamento de memória)
+int conexao_enviar(conexao_t *c, const char *payload, size_t tamanho);
+int conexao_enfileirar(conexao_t *c, quadro_t *q);
+// Enfileira vários quadros compartilhados de uma vez (uma trava, um único
+// agendamento de envio); para no primeiro que passaria da marca alta (ou do
+// orçamento de memória), sem contar descarte nem despejo. @return quantidade enfileirada
+size_t conexao_enfileirar_lote(conexao_t *c, quadro_t *const *quadros, size_t n);
+
+// Socket gravável (EPOLLOUT, apenas o laço dono): agenda o envio para o fim
+// da iteração, junto com o resto da saída do laço
+void conexao_escrita_pronta(conexao_t *c);
+
+// Envia o que couber no socket em lotes de writev (apenas o laço dono)
+// @return 0 se a conexão continua, -1 em erro de escrita
+int conexao_descarregar(conexao_t *c);
+
+// Envio assíncrono em duas etapas (apenas o laço dono): o iovec aponta para
+// quadros que continuam na fila até conexao_confirmar_envio consumir os bytes
+size_t conexao_preparar_envio(conexao_t *c, struct iovec *iov, size_t max);
+void conexao_confirmar_envio(conexao_t *c, size_t enviado);
+
+// Troca o socket pelo canal em memória compartilhada (apenas o laço dono):
+// envia aviso (resposta com os descritores) e, se ele saiu inteiro, passa a
+// descarregar a fila no anel. Exige a fila sem quadro pela metade.
+// @return 0 se ativado, -1 com EBUSY (nada enviado) ou EPIPE (fluxo corrompido)
+int conexao_ativar_shm(conexao_t *c, struct canal_local *shm, const struct msghdr *aviso);
+
+// Interrompe o socket; o laço dono detecta o EOF e fecha a conexão
+void conexao_encerrar(conexao_t *c);
+
+// Hot upgrade: o socket segue para outro processo. A fila continua aceitando
+// quadros, mas nenhum laço escreve mais no socket; conexao_extrair_saida
+// entrega os bytes pendentes (o primeiro quadro pode estar pela metade) em um
+// buffer alocado e esvazia a fila. @return bytes em *dados (0 = nada ou sem memória)
+void conexao_transferir(conexao_t *c);
+size_t conexao_extrair_saida(conexao_t *c, char **dados);
+
+// Para de processar e de ler a conexão por espera_ns (limite de taxa com
+// atrasar, apenas o laço dono): ela entra nas suspensas do laço atual com
+// uma referência até laco_retomar devolvê-la
+void conexao_suspender(conexao_t *c, uint64_t espera_ns);
+
+void laco_iniciar(laco_t *laco, int epfd);
+void laco_definir_atual(laco_t *laco);
+// Descarrega as conexões que receberam saída durante a iteração do laço.
+// Com coalescência, as filas pequenas e recentes ficam para uma iteração
+// posterior (até a janela vencer ou a fila atingir coalescer_bytes)
+void laco_descarregar(laco_t *laco);
+// Descarrega tudo, inclusive os adiados, e solta as suspensas (fim do laço)
+void laco_finalizar(laco_t *laco);
+// Próxima suspensa cuja espera venceu (todas = qualquer uma), já fora da
+// lista; a referência passa ao chamador. @return NULL se não há
+conexao_t *laco_retomar(laco_t *laco, int todas);
+// Prazo absoluto mais próximo entre adiados e suspensas (0 = nenhum)
+uint64_t laco_proximo_prazo(const laco_t *laco);
+// Tempo máximo de espera por eventos sem perder o prazo dos adiados e das suspensas
+int laco_espera_ms(const laco_t *laco, int padrao);
+
+// Contadores globais de backpressure
+void conexao_estatisticas(uint64_t *descartadas, uint64_t *despejadas);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef DIFUSAO_H
+#define DIFUSAO_H
+
+#include "../include/conexao.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define DIFUSAO_LIMIAR_PADRAO 4096   // destinatários a partir dos quais o broadcast é dividido
+#define DIFUSAO_MAX_FATIAS 64
+
+/*
+ * Fan-out paralelo de broadcasts grandes: acima do limiar, os membros da
+ * sala são divididos em fatias contíguas; o remetente publica o trabalho,
+ * threads ajudantes pegam fatias e enfileiram nas conexões delas, e o
+ * próprio remetente também pega fatias até acabarem. O remetente só volta
+ * quando todas terminam, ainda com o mutex de ordem da sala, então a ordem
+ * das mensagens de uma sala continua a mesma para todo destinatário.
+ * As ajudantes não são donas de laço: acordam cada conexão armando EPOLLOUT,
+ * como qualquer outra thread. Por isso não é usado no modo uring.
+ */
+typedef struct {
+    size_t limiar;              // 0 = desativado (sempre serial)
+    int fatias;                 // fatias por broadcast dividido (0 = uma por CPU)
+} config_difusao_t;
+
+typedef struct {
+    uint64_t divididos;         // broadcasts acima do limiar
+    uint64_t fatias_remetente;  // fatias executadas pelo próprio remetente
+    uint64_t fatias_ajudantes;  // fatias executadas pelas threads ajudantes
+    int ajudantes;
+} difusao_info_t;
+
+// Cria as fatias-1 threads ajudantes (nada com limiar 0 ou uma fatia)
+// @return 0 em sucesso, -1 em erro (o fan-out segue serial)
+int difusao_iniciar(const config_difusao_t *cfg);
+
+// Enfileira o quadro para membros[0..n) exceto excluir; acima do limiar a
+// lista é dividida entre o remetente e as ajudantes (a lista não pode mudar
+// até o retorno: passar uma cópia ou chamar com o mutex da sala travado)
+// @return quantidade de membros que receberam
+int difusao_entregar(conexao_t *const *membros, size_t n, quadro_t *q, const conexao_t *excluir);
+
+void difusao_estatisticas(difusao_info_t *info);
+
+// Encerra as ajudantes (depois que os laços pararam de difundir)
+void difusao_encerrar(void);
+
+#endif
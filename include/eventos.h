@@ -0,0 +1,37 @@
+#ifndef EVENTOS_H
+#define EVENTOS_H
+
+#include <stdint.h>
+#include <netinet/in.h>
+
+// Tipos de evento do log binário do servidor (valores gravados em disco: só acrescentar)
+typedef enum {
+    EVENTO_CONECTADO = 1,    // payload: evento_endereco_t
+    EVENTO_DESCONECTADO,     // payload: evento_endereco_t
+    EVENTO_MENSAGEM,         // payload: texto recebido do cliente
+    EVENTO_BROADCAST,        // payload: texto distribuído; cliente = remetente excluído
+    EVENTO_DESPEJO,          // payload: uint64_t bytes pendentes na fila de saída
+    EVENTO_REJEITADO,        // sem payload (servidor cheio)
+    EVENTO_SALA,             // payload: nome da sala em que o cliente entrou
+    EVENTO_QUANTIDADE
+} evento_t;
+
+typedef struct {
+    char ip[INET_ADDRSTRLEN];
+    uint16_t porta;
+} evento_endereco_t;
+
+static inline const char *evento_nome(unsigned int tipo) {
+    static const char *const nomes[EVENTO_QUANTIDADE] = {
+        [EVENTO_CONECTADO] = "CONECTADO",
+        [EVENTO_DESCONECTADO] = "DESCONECTADO",
+        [EVENTO_MENSAGEM] = "MENSAGEM",
+        [EVENTO_BROADCAST] = "BROADCAST",
+        [EVENTO_DESPEJO] = "DESPEJO",
+        [EVENTO_REJEITADO] = "REJEITADO",
+        [EVENTO_SALA] = "SALA",
+    };
+    return (tipo > 0 && tipo < EVENTO_QUANTIDADE) ? nomes[tipo] : NULL;
+}
+
+#endif
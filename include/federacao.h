@@ -0,0 +1,54 @@
+#ifndef FEDERACAO_H
+#define FEDERACAO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FEDERACAO_MAX_PARES 16                 // --par aceitos na linha de comando
+#define FEDERACAO_MAX_ENLACES 64               // pares configurados + conexões recebidas
+#define FEDERACAO_LOTE_MAX (1024 * 1024)       // bytes pendentes por enlace (acima: descarta)
+#define FEDERACAO_VISTOS 4096                  // ids recentes lembrados (potência de 2)
+#define FEDERACAO_SALTOS_MAX 8                 // reencaminhamentos de uma mesma mensagem
+#define FEDERACAO_RECONEXAO_MS 500             // primeira espera para reconectar a um par
+#define FEDERACAO_RECONEXAO_MAX_MS 8000
+
+/*
+ * Federação de várias instâncias do servidor: cada nó escuta os pares em uma
+ * porta própria e conecta nos pares configurados. Todo broadcast de sala
+ * local segue para os enlaces com o id do nó de origem e um número de
+ * sequência; quem recebe entrega aos membros locais da sala e reencaminha
+ * aos demais enlaces, descartando o que já viu (vale para topologias que não
+ * são malha completa). Uma única thread cuida de todos os enlaces: as
+ * mensagens publicadas enquanto ela envia se acumulam no lote de cada
+ * enlace e saem juntas no próximo send. Enlace que cai perde o lote; os
+ * pares configurados são reconectados com espera crescente, e os clientes
+ * locais continuam atendidos.
+ */
+typedef struct {
+    int porta;                                 // porta dos pares (0 = sem escuta)
+    const char *pares[FEDERACAO_MAX_PARES];    // HOST:PORTA de cada par
+    int num_pares;
+} config_federacao_t;
+
+typedef struct {
+    uint64_t enviadas;       // mensagens colocadas em lotes de enlaces
+    uint64_t recebidas;      // mensagens novas vindas de pares
+    uint64_t duplicadas;     // recebidas de novo por outro caminho (descartadas)
+    uint64_t descartadas;    // não couberam no lote do enlace (par lento)
+    int enlaces;             // enlaces conectados no momento
+} federacao_info_t;
+
+// Inicia a thread da federação (sem porta nem pares não faz nada)
+// @return 0 em sucesso, -1 em erro (errno definido)
+int federacao_iniciar(const config_federacao_t *cfg);
+
+// Publica um broadcast local da sala para os pares (qualquer thread, não bloqueia)
+void federacao_publicar(const char *sala, const char *msg, size_t tamanho);
+
+void federacao_estatisticas(federacao_info_t *info);
+
+// Encerra a thread e os enlaces (chamar depois do shutdown_requested; chamadas
+// seguintes não fazem nada)
+void federacao_encerrar(void);
+
+#endif
@@ -1,26 +1,49 @@
-#include <pthread.h>
+#ifndef FILA_THREADSAFE_H
+#define FILA_THREADSAFE_H
 
-#define QUEUE_CAPACITY 50
-#define MSG_SIZE 1024
+#include <stdatomic.h>
+#include <stddef.h>
 
+#define MSG_SIZE 1024                           // maior mensagem (com '\0'); o excesso é truncado
+#define QUEUE_CAPACIDADE_PADRAO (64 * 1024)     // bytes do anel
+#define CACHE_LINE 64
+
+/*
+ * Fila MPSC sem lock sobre um anel de bytes: cada mensagem vira um registro
+ * [cabeçalho de 4 bytes][texto com '\0'] alinhado em 8 bytes, então uma
+ * linha curta ocupa só o próprio tamanho. Produtores reservam bytes com CAS
+ * na cauda e publicam gravando o cabeçalho; o consumidor único lê os
+ * registros prontos em ordem e devolve o espaço avançando a cabeça. Futex
+ * só é usado quando o consumidor está sem mensagens ou o anel está cheio.
+ */
 typedef struct {
-    char buffer[QUEUE_CAPACITY][MSG_SIZE]; // mensagens armazenadas
-    int head;
-    int tail;
-    int size;
-    pthread_mutex_t mutex;
-    pthread_cond_t not_empty;
-    pthread_cond_t not_full;
+    _Alignas(CACHE_LINE) atomic_size_t tail;            // bytes reservados (produtores)
+    _Alignas(CACHE_LINE) atomic_size_t head;            // bytes liberados (só o consumidor escreve)
+    _Alignas(CACHE_LINE) atomic_uint consumidor_dormindo; // palavra de futex
+    atomic_uint espaco;                                 // futex: muda quando bytes são liberados
+    atomic_uint produtores_esperando;
+    char *dados;
+    size_t capacidade;                                  // potência de 2
 } ThreadSafeQueue;
 
-// Inicializa a fila
-void tsqueue_init(ThreadSafeQueue *q);
+// Inicializa a fila com um anel de ao menos capacidade bytes
+// @return 0 em sucesso, -1 sem memória
+int tsqueue_init(ThreadSafeQueue *q, size_t capacidade);
 
-// Destroi a fila
+// Destroi a fila e libera o anel
 void tsqueue_destroy(ThreadSafeQueue *q);
 
-// Insere mensagem (bloqueia se fila cheia)
+// Insere mensagem (bloqueia se fila cheia); seguro para vários produtores
 void tsqueue_push(ThreadSafeQueue *q, const char *msg);
 
-// Remove mensagem (bloqueia se fila vazia)
+// Remove mensagem (bloqueia se fila vazia); apenas um consumidor
 void tsqueue_pop(ThreadSafeQueue *q, char *out);
+
+// Remove até max mensagens de uma vez (bloqueia até haver ao menos uma)
+// @return quantidade de mensagens copiadas para out
+size_t tsqueue_pop_many(ThreadSafeQueue *q, char (*out)[MSG_SIZE], size_t max);
+
+// Bytes ocupados no anel (reservados e ainda não liberados); leitura aproximada, sem lock
+size_t tsqueue_bytes_pendentes(ThreadSafeQueue *q);
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef HISTOGRAMA_H
+#define HISTOGRAMA_H
+
+#include <stdint.h>
+
+/*
+ * Histograma log-linear de latências (em ns) para as ferramentas de medição:
+ * valores abaixo de 64 têm faixa própria; acima, cada potência de 2 é
+ * dividida em 64 sub-faixas (erro relativo de ~1,5%). Registro em O(1) e
+ * sem alocação, então cada thread mantém o seu e eles são somados no fim.
+ */
+#define HIST_SUB_BITS 6
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_FAIXAS ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+typedef struct {
+    uint64_t contagem;
+    uint64_t max;
+    uint64_t faixas[HIST_FAIXAS];
+} histograma_t;
+
+static inline int hist_indice(uint64_t v) {
+    if (v < HIST_SUB) {
+        return (int)v;
+    }
+    int e = 63 - __builtin_clzll(v);
+    return (e - HIST_SUB_BITS + 1) * HIST_SUB + (int)((v >> (e - HIST_SUB_BITS)) - HIST_SUB);
+}
+
+// Limite inferior da faixa
+static inline uint64_t hist_valor(int indice) {
+    if (indice < HIST_SUB) {
+        return (uint64_t)indice;
+    }
+    int e = indice / HIST_SUB + HIST_SUB_BITS - 1;
+    uint64_t m = (uint64_t)(indice % HIST_SUB + HIST_SUB);
+    return m << (e - HIST_SUB_BITS);
+}
+
+static inline void hist_registrar(histograma_t *h, uint64_t ns) {
+    h->faixas[hist_indice(ns)]++;
+    h->contagem++;
+    if (ns > h->max) {
+        h->max = ns;
+    }
+}
+
+static inline void hist_somar(histograma_t *total, const histograma_t *h) {
+    total->contagem += h->contagem;
+    if (h->max > total->max) {
+        total->max = h->max;
+    }
+    for (int i = 0; i < HIST_FAIXAS; i++) {
+        total->faixas[i] += h->faixas[i];
+    }
+}
+
+// Percentil p (0-100); 0 se o histograma está vazio
+static inline uint64_t hist_percentil(const histograma_t *h, double p) {
+    if (h->contagem == 0) {
+        return 0;
+    }
+    uint64_t alvo = (uint64_t)(p / 100.0 * (double)h->contagem);
+    if (alvo >= h->contagem) {
+        alvo = h->contagem - 1;
+    }
+    uint64_t acumulado = 0;
+    for (int i = 0; i < HIST_FAIXAS; i++) {
+        acumulado += h->faixas[i];
+        if (acumulado > alvo) {
+            return hist_valor(i);
+        }
+    }
+    return h->max;
+}
+
+#endif
@@ -1,11 +1,72 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define LOG_LOTE_PADRAO (16 * 1024)       // bytes acumulados que disparam o group commit
+#define LOG_INTERVALO_MS_PADRAO 50        // tempo máximo de uma linha no buffer
+#define LOG_BUFFER_THREAD (64 * 1024)     // buffer de cada thread no modo assíncrono
+
+// Log binário: cabeçalho do arquivo seguido de registros log_registro_t + payload
+#define LOG_BINARIO_MAGICO "TSLB"
+#define LOG_BINARIO_VERSAO 1
+
+// Registro binário (ordem de bytes nativa, 24 bytes) seguido de tamanho bytes de payload
+typedef struct {
+    uint64_t timestamp_ns;       // CLOCK_REALTIME
+    uint64_t cliente_id;         // 0 = sem cliente
+    uint32_t tamanho;
+    uint16_t tipo;               // identificador do evento (definido pela aplicação)
+    uint16_t reservado;
+} log_registro_t;
 
 typedef struct {
-    pthread_mutex_t mutex;
+    char magico[4];
+    uint16_t versao;
+    uint16_t tamanho_registro;   // sizeof(log_registro_t) de quem gravou
+} log_binario_cabecalho_t;
+
+// Área de acumulação de linhas já formatadas
+typedef struct {
+    char *dados;
+    size_t usado;
+} log_area_t;
+
+// Buffer de uma thread produtora (modo assíncrono)
+typedef struct log_buffer_thread {
+    struct log_buffer_thread *prox;
+    pthread_mutex_t mutex;       // disputado só pela thread dona e pelo escritor
+    log_area_t arquivo;
+    log_area_t terminal;
+    log_area_t binario;
+    int orfao;                   // a thread terminou: o escritor descarrega e libera
+} log_buffer_thread_t;
+
+typedef struct {
+    pthread_mutex_t mutex;       // protege o arquivo e o terminal
     FILE *arquivo;
+    FILE *binario;               // log binário opcional (NULL = desativado)
     int verbose;  // controle de exibição
+
+    // Modo assíncrono (group commit)
+    int assincrono;
+    size_t lote_bytes;
+    int intervalo_ms;
+    pthread_t escritor;
+    pthread_key_t chave;         // buffer da thread atual
+    pthread_mutex_t lista_mutex;
+    log_buffer_thread_t *buffers;
+    log_area_t reserva_arquivo;  // trocadas com as áreas dos produtores a cada lote
+    log_area_t reserva_terminal;
+    log_area_t reserva_binario;
+    pthread_mutex_t controle;
+    pthread_cond_t acordar;
+    pthread_cond_t descarregado;
+    uint64_t flush_pedidos;
+    uint64_t flush_concluidos;
+    int parar;
+    atomic_int sinalizado;       // escritor já foi acordado por lote cheio
 } logger_t;
 
 logger_t* log_init(const char *nomeArquivo);
@@ -13,4 +74,25 @@ void log_escrever(logger_t *log, const char *mensagem);
 void log_escrever_verbose(logger_t *log, const char *mensagem);  
 void log_set_verbose(logger_t *log, int verbose);
 void log_erro(logger_t *log, const char *operacao, int error_code); 
-void log_destruir(logger_t *log);
\ No newline at end of file
+void log_destruir(logger_t *log);
+
+// Ativa o modo assíncrono: cada thread acumula linhas no próprio buffer e uma
+// thread escritora grava tudo em lote (um fflush por lote) quando algum buffer
+// passa de lote_bytes ou a cada intervalo_ms. Retorna 0 em sucesso, -1 em erro.
+int log_set_assincrono(logger_t *log, size_t lote_bytes, int intervalo_ms);
+
+// Abre o log binário (acrescenta ao arquivo; grava o cabeçalho se estiver vazio).
+// Retorna 0 em sucesso, -1 em erro.
+int log_abrir_binario(logger_t *log, const char *nomeArquivo);
+
+// Registra um evento binário sem formatação: timestamp, tipo, cliente e payload
+// bruto. Sem efeito se o log binário não estiver aberto.
+void log_evento(logger_t *log, uint16_t tipo, uint64_t cliente_id,
+                const void *payload, size_t tamanho);
+
+// Indica se há log binário aberto
+int log_binario_ativo(const logger_t *log);
+
+// Barreira: retorna depois que tudo o que foi registrado antes da chamada
+// estiver gravado e descarregado no arquivo
+void log_flush(logger_t *log);
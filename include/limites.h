@@ -0,0 +1,63 @@
+#ifndef LIMITES_H
+#define LIMITES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LIMITES_RAJADA_MS_PADRAO 1000
+
+/*
+ * Limite de taxa de entrada por conexão e global, em mensagens/s e bytes/s.
+ * Cada balde é um GCRA (token bucket guardado como o instante teórico de
+ * chegada): cobrar é somar custo/taxa a esse instante, e o balde está acima
+ * do limite quando ele passa de agora + rajada. Os baldes globais são um
+ * único atômico atualizado com CAS, sem trava.
+ */
+typedef enum {
+    LIMITE_ATRASAR,      // processa e para de ler a conexão até o balde esvaziar
+    LIMITE_DESCARTAR,    // descarta o quadro
+    LIMITE_DESCONECTAR   // encerra a conexão
+} limite_acao_t;
+
+// Balde que disparou (contadores de acionamento)
+typedef enum {
+    LIMITE_CONEXAO_MENSAGENS,
+    LIMITE_CONEXAO_BYTES,
+    LIMITE_GLOBAL_MENSAGENS,
+    LIMITE_GLOBAL_BYTES,
+    LIMITE_QUANTIDADE
+} limite_balde_t;
+
+typedef struct {
+    uint64_t mensagens;          // mensagens/s por conexão (0 = sem limite)
+    uint64_t bytes;              // bytes/s por conexão (0 = sem limite)
+    uint64_t global_mensagens;   // mensagens/s somando todas as conexões
+    uint64_t global_bytes;       // bytes/s somando todas as conexões
+    int rajada_ms;               // rajada aceita acima da taxa, em ms de taxa
+    limite_acao_t acao;
+} config_limites_t;
+
+// Estado dos baldes de uma conexão (só o laço dono cobra)
+typedef struct {
+    uint64_t mensagens_ns;
+    uint64_t bytes_ns;
+} limite_conexao_t;
+
+void limites_configurar(const config_limites_t *cfg);
+
+// Há algum limite configurado (senão limites_cobrar nem precisa ser chamado)
+int limites_ativos(void);
+
+limite_acao_t limites_acao(void);
+const char *limites_nome_acao(limite_acao_t acao);
+
+// Cobra um quadro de tamanho bytes da conexão e dos baldes globais.
+// Com LIMITE_ATRASAR o quadro é sempre cobrado; nas demais ações um quadro
+// acima do limite não é cobrado (o chamador o descarta ou desconecta).
+// @return 0 dentro dos limites; senão ns até os baldes voltarem à rajada
+uint64_t limites_cobrar(limite_conexao_t *l, size_t bytes);
+
+// Acionamentos acumulados de cada balde
+void limites_estatisticas(uint64_t acionamentos[LIMITE_QUANTIDADE]);
+
+#endif
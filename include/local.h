@@ -0,0 +1,66 @@
+#ifndef LOCAL_H
+#define LOCAL_H
+
+#include "../include/conexao.h"
+#include "../include/anel_shm.h"
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/*
+ * Transporte para clientes na mesma máquina: um socket Unix (SOCK_STREAM)
+ * com o mesmo protocolo do TCP, atendido pelos laços de todos os modos.
+ * Com --shm, um cliente local pode pedir /shm: o servidor cria um memfd
+ * com dois anéis (canal_shm_t) e dois eventfds e os passa por SCM_RIGHTS.
+ * Dali em diante os quadros nos dois sentidos passam pelos anéis; o socket
+ * continua aberto só para detectar o fim da conexão, e o eventfd do
+ * servidor entra no epoll do laço dono como a própria conexão.
+ * Disponível nos modos com epoll (threads, epoll e pool).
+ */
+typedef struct {
+    const char *caminho;        // socket Unix (NULL = desativado)
+    int shm;                    // aceita /shm nas conexões locais
+} config_local_t;
+
+typedef struct {
+    uint64_t aceitas;           // conexões recebidas pelo socket Unix
+    uint64_t canais;            // canais de memória compartilhada ativados
+    uint64_t recusas;           // pedidos /shm recusados
+    uint64_t sinais;            // writes em eventfd de clientes (o resto foi sem syscall)
+} local_info_t;
+
+// Cria o socket Unix (remove um arquivo antigo no caminho)
+// @return 0 em sucesso ou sem caminho, -1 em erro (errno definido)
+int local_iniciar(const config_local_t *cfg);
+// Socket de escuta local (-1 = desativado)
+int local_escuta(void);
+// Conta uma conexão aceita pelo socket Unix
+void local_aceita(void);
+
+// Atende o pedido /shm (laço dono): responde com os descritores ou recusa
+// @return 0 se a conexão continua, -1 se deve ser encerrada
+int local_ativar_shm(conexao_t *c);
+
+// Lê o anel de entrada para o anel de recepção e processa os quadros
+// (laço dono, depois do socket chegar a EAGAIN)
+// @return 0 se a conexão continua, -1 se deve ser encerrada
+int local_shm_receber(conexao_t *c);
+
+// Copia o que couber do iovec no anel de saída (no lugar do sendmsg; o
+// iovec é consumido). Anel cheio: o cliente avisa pelo eventfd ao consumir
+// @return bytes copiados, -1 com EAGAIN se nada coube
+ssize_t local_shm_enviar(conexao_t *c, struct iovec *iov, size_t n);
+// Acorda o cliente se ele dorme à espera de dados (fim do descarregar)
+void local_shm_notificar(conexao_t *c);
+
+// Tira o eventfd do epoll do dono (close_client)
+void local_fechar(conexao_t *c);
+// Desfaz o mapeamento e fecha os eventfds (última referência da conexão)
+void local_liberar(conexao_t *c);
+
+void local_estatisticas(local_info_t *info);
+
+// Fecha e remove o socket Unix (no hot upgrade o arquivo fica para o processo novo)
+void local_encerrar(void);
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef MEMORIA_H
+#define MEMORIA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MEMORIA_MAX_SLABS 8
+#define SLAB_BLOCO_MIN (1024 * 1024)   // bytes mapeados de cada vez (ao menos 8 objetos)
+
+/*
+ * Memória do servidor com tamanho previsível:
+ * - slabs: classes de objetos de tamanho fixo (alinhados a 64 bytes) em
+ *   blocos mapeados com mmap e nunca devolvidos; objetos liberados voltam
+ *   para uma lista livre da classe. Cada conexão é um objeto do slab de
+ *   conexões (estado + anel de recepção) e, conforme o modo, um do slab do
+ *   transporte.
+ * - orçamento global (--memoria-max): cada conexão aceita é cobrada pelo
+ *   custo fixo (soma dos slabs por conexão + pilha da thread no modo
+ *   threads) e cada fila de saída pelos bytes enfileirados (cota
+ *   conservadora: um quadro compartilhado conta em cada fila). Acima do
+ *   limite a conexão é recusada e o quadro descartado.
+ */
+typedef struct slab slab_t;
+
+typedef enum {
+    MEMORIA_CONEXOES,           // custo fixo das conexões aceitas
+    MEMORIA_FILAS,              // bytes nas filas de saída
+    MEMORIA_USOS
+} memoria_uso_t;
+
+typedef struct {
+    size_t limite;              // bytes (0 = sem limite, só contabiliza)
+    size_t pilha;               // pilha reservada por conexão (modo threads; 0 nos demais)
+} config_memoria_t;
+
+typedef struct {
+    size_t limite;
+    size_t por_conexao;         // custo fixo cobrado de cada conexão
+    size_t pilha;
+    uint64_t uso[MEMORIA_USOS];
+    uint64_t recusas[MEMORIA_USOS];
+    uint64_t mapeados;          // bytes mapeados por todos os slabs
+    struct {
+        const char *nome;
+        size_t objeto;          // tamanho arredondado do objeto
+        uint64_t em_uso;
+        uint64_t capacidade;    // objetos nos blocos já mapeados
+    } slabs[MEMORIA_MAX_SLABS];
+    int num_slabs;
+} memoria_info_t;
+
+void memoria_configurar(const config_memoria_t *cfg);
+
+// Cria uma classe de objetos de tamanho fixo (na inicialização do módulo
+// dono); por_conexao soma o objeto ao custo fixo de cada conexão
+// @return slab ou NULL se já há MEMORIA_MAX_SLABS classes
+slab_t *slab_criar(const char *nome, size_t tamanho, int por_conexao);
+// Objeto não zerado; mapeia um novo bloco quando a lista livre acaba
+// @return objeto ou NULL sem memória
+void *slab_alocar(slab_t *s);
+void slab_liberar(slab_t *s, void *obj);
+
+// Custo fixo cobrado por conexão (slabs por conexão + pilha)
+size_t memoria_custo_conexao(void);
+
+// Cobra bytes do orçamento
+// @return 0 se coube, -1 se passaria do limite (nada é cobrado)
+int memoria_reservar(memoria_uso_t uso, size_t bytes);
+void memoria_devolver(memoria_uso_t uso, size_t bytes);
+
+void memoria_estatisticas(memoria_info_t *info);
+
+#endif
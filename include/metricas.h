@@ -0,0 +1,49 @@
+#ifndef METRICAS_H
+#define METRICAS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define METRICAS_PORTA_PADRAO 9090
+#define METRICAS_RESPOSTA_MAX (64 * 1024)
+
+/*
+ * Métricas do servidor: cada thread soma nos próprios contadores e no próprio
+ * histograma (um único escritor, sem lock e sem RMW atômico); a leitura soma
+ * os blocos de todas as threads. Threads que terminam têm os valores
+ * acumulados em um bloco de aposentadas. A exposição é em texto no formato
+ * do Prometheus, por um listener HTTP local separado do chat.
+ */
+typedef enum {
+    METRICA_ACEITAS,
+    METRICA_REJEITADAS,
+    METRICA_BYTES_RECEBIDOS,
+    METRICA_BYTES_ENVIADOS,
+    METRICA_MENSAGENS,
+    METRICA_BROADCASTS,
+    METRICA_ENTREGAS,
+    METRICA_FALHAS_ENVIO,
+    METRICA_QUANTIDADE
+} metrica_t;
+
+// Soma valor ao contador na thread atual
+void metricas_somar(metrica_t m, uint64_t valor);
+
+// Registra a duração (ns) de um fan-out de broadcast na thread atual
+void metricas_registrar_fanout(uint64_t ns);
+
+// Relógio monotônico em ns para medir durações
+uint64_t metricas_agora_ns(void);
+
+// Formata todas as métricas em buf (texto Prometheus)
+// @return bytes escritos (truncado em max - 1)
+size_t metricas_formatar(char *buf, size_t max);
+
+// Inicia o listener de administração em 127.0.0.1:porta (porta 0 = desativado)
+// @return 0 em sucesso, -1 em erro
+int metricas_iniciar(int porta);
+
+// Encerra o listener (chamar depois do shutdown_requested)
+void metricas_encerrar(void);
+
+#endif
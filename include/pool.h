@@ -0,0 +1,21 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+#define POOL_PILHA_KB_PADRAO 256       // pilha de cada worker (e das threads por cliente)
+#define POOL_DEQUE_INICIAL 64
+
+/*
+ * Pool fixo de workers para o modelo com threads: uma thread de despacho
+ * aceita as conexões e espera os eventos de todas em um único epoll; cada
+ * evento vira uma tarefa na deque de um worker (o último que atendeu a
+ * conexão). Worker sem tarefas rouba das deques dos outros. Uma conexão
+ * nunca é atendida por dois workers ao mesmo tempo.
+ */
+
+// Executa o pool até o shutdown (workers 0 = um por CPU)
+// @return 0 ao finalizar, -1 em erro de inicialização
+int pool_executar(int listen_fd, int workers, size_t pilha);
+
+#endif
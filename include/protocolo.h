@@ -0,0 +1,58 @@
+#ifndef PROTOCOLO_H
+#define PROTOCOLO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * Protocolo de enquadramento: cada mensagem é precedida por um cabeçalho de
+ * 4 bytes com o tamanho do payload (uint32, network byte order).
+ *
+ *   +----------------+----------------------+
+ *   | tamanho (u32)  | payload (tamanho B)  |
+ *   +----------------+----------------------+
+ */
+#define PROTO_CABECALHO 4
+#define PROTO_MAX_PAYLOAD 8192
+// Texto enviado por clientes: deixa espaço para o prefixo "[ip:porta]: " do broadcast
+#define PROTO_MAX_TEXTO (PROTO_MAX_PAYLOAD - 256)
+// Capacidade padrão do buffer de recepção (potência de 2, comporta ao menos um quadro máximo)
+#define PROTO_RING_CAPACIDADE 16384
+
+// Buffer circular de recepção por conexão
+typedef struct {
+    char *dados;
+    size_t capacidade;  // potência de 2
+    size_t inicio;      // índice de leitura (monotônico)
+    size_t fim;         // índice de escrita (monotônico)
+    char *quadro;       // área contígua para quadros que cruzam o fim do anel
+} proto_ring_t;
+
+// Inicializa o anel (capacidade deve ser potência de 2 >= PROTO_CABECALHO + PROTO_MAX_PAYLOAD)
+int proto_ring_init(proto_ring_t *r, size_t capacidade);
+void proto_ring_destroy(proto_ring_t *r);
+// Inicializa o anel sobre áreas do chamador (dados com capacidade bytes,
+// quadro com PROTO_MAX_PAYLOAD); não chamar proto_ring_destroy depois
+int proto_ring_usar(proto_ring_t *r, size_t capacidade, char *dados, char *quadro);
+
+// Lê do socket para o espaço livre do anel com um único readv
+// @return bytes lidos, 0 em EOF, -1 em erro (errno preservado; ENOBUFS se o anel está cheio)
+ssize_t proto_ring_ler(proto_ring_t *r, int fd);
+
+// Copia bytes já recebidos (ex.: buffer do io_uring) para o espaço livre do anel
+// @return bytes copiados (menos que n se o anel encheu)
+size_t proto_ring_escrever(proto_ring_t *r, const char *dados, size_t n);
+
+// Extrai o próximo quadro completo. O ponteiro retornado é válido até a próxima leitura.
+// @return 1 se há quadro, 0 se faltam bytes, -1 se o quadro excede PROTO_MAX_PAYLOAD
+int proto_proximo_quadro(proto_ring_t *r, const char **payload, size_t *tamanho);
+
+// Escreve cabeçalho + payload em dst (deve ter PROTO_CABECALHO + tamanho bytes)
+size_t proto_codificar(char *dst, const char *payload, size_t tamanho);
+
+// Envia um quadro completo em socket bloqueante
+// @return 0 em sucesso, -1 em erro
+int proto_enviar(int fd, const char *payload, size_t tamanho);
+
+#endif
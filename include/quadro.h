@@ -0,0 +1,32 @@
+#ifndef QUADRO_H
+#define QUADRO_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+/*
+ * Quadro imutável já codificado (cabeçalho + payload) compartilhado por
+ * contagem de referências: um broadcast codifica a mensagem uma única vez e
+ * cada fila de saída guarda apenas uma referência, não uma cópia.
+ */
+typedef struct {
+    atomic_int refs;
+    size_t tamanho;     // bytes do quadro completo (cabeçalho incluso)
+    char dados[];
+} quadro_t;
+
+// Codifica o payload em um novo quadro com uma referência (do chamador)
+quadro_t *quadro_criar(const char *payload, size_t tamanho);
+
+// Quadro com bytes já enquadrados, copiados sem recodificar (saída herdada
+// de outro processo, que pode começar no meio de um quadro)
+quadro_t *quadro_copiar(const char *dados, size_t tamanho);
+
+static inline quadro_t *quadro_ref(quadro_t *q) {
+    atomic_fetch_add_explicit(&q->refs, 1, memory_order_relaxed);
+    return q;
+}
+
+void quadro_unref(quadro_t *q);
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef RASTRO_H
+#define RASTRO_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Rastreamento do caminho quente (make RASTRO=1, que define RASTRO).
+ * Cada ponto grava um intervalo (início, duração, nome, argumento) no anel
+ * da própria thread: sem trava e sem syscall, só rdtsc (clock_gettime fora
+ * do x86) e quatro stores. O anel sobrescreve os mais antigos; a exportação
+ * lê todos os anéis sem parar ninguém e gera JSON no formato Chrome trace
+ * (chrome://tracing, ui.perfetto.dev). Sem RASTRO as macros somem na
+ * compilação e rastro_exportar falha com ENOTSUP.
+ *
+ *     RASTRO_INICIO(t);
+ *     ssize_t n = recv(...);
+ *     RASTRO_FIM(t, "recv", n);
+ */
+
+#ifndef RASTRO_SPANS
+#define RASTRO_SPANS 4096       // intervalos guardados por thread (potência de 2)
+#endif
+
+#ifdef RASTRO
+
+#include <stdatomic.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+typedef struct {
+    uint64_t inicio;            // ticks do relógio do rastro
+    uint32_t duracao;           // ticks (satura em 2^32-1)
+    uint32_t tid;
+    const char *nome;           // literal: só o ponteiro é guardado
+    uint64_t arg;
+} rastro_span_t;
+
+typedef struct rastro_anel {
+    struct rastro_anel *prox;   // lista global (anéis nunca são liberados)
+    atomic_int livre;           // thread dona terminou: reaproveitado pela próxima
+    uint32_t tid;
+    char nome[16];
+    atomic_uint_fast64_t cabeca; // escrito só pela dona; lido pela exportação
+    rastro_span_t spans[RASTRO_SPANS];
+} rastro_anel_t;
+
+extern _Thread_local rastro_anel_t *rastro_anel_atual;
+
+// Anel da thread atual (criado ou reaproveitado no primeiro evento)
+rastro_anel_t *rastro_anel_obter(void);
+
+static inline uint64_t rastro_relogio(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static inline void rastro_registrar(const char *nome, uint64_t inicio, uint64_t arg) {
+    uint64_t fim = rastro_relogio();
+    rastro_anel_t *a = rastro_anel_atual;
+    if (a == NULL && (a = rastro_anel_obter()) == NULL) {
+        return;
+    }
+    uint64_t h = atomic_load_explicit(&a->cabeca, memory_order_relaxed);
+    rastro_span_t *s = &a->spans[h & (RASTRO_SPANS - 1)];
+    uint64_t duracao = fim - inicio;
+    s->inicio = inicio;
+    s->duracao = duracao > UINT32_MAX ? UINT32_MAX : (uint32_t)duracao;
+    s->tid = a->tid;
+    s->nome = nome;
+    s->arg = arg;
+    atomic_store_explicit(&a->cabeca, h + 1, memory_order_release);
+}
+
+// Nome da thread atual no rastro (até 15 caracteres)
+void rastro_nomear(const char *nome);
+
+#define RASTRO_INICIO(var) uint64_t var = rastro_relogio()
+#define RASTRO_FIM(var, nome, arg) rastro_registrar(nome, var, (uint64_t)(arg))
+#define RASTRO_NOMEAR(nome) rastro_nomear(nome)
+
+#else
+
+#define RASTRO_INICIO(var) ((void)0)
+#define RASTRO_FIM(var, nome, arg) ((void)0)
+#define RASTRO_NOMEAR(nome) ((void)0)
+
+#endif
+
+// Calibra o relógio e cria a thread que grava o rastro a cada rastro_sinal;
+// avisar recebe a linha de resultado de cada gravação (pode ser NULL)
+// @return 0 em sucesso ou sem RASTRO, -1 em erro
+int rastro_iniciar(void (*avisar)(const char *msg));
+
+// Pede uma gravação em rastro-PID-N.json (async-signal-safe: para o SIGUSR1)
+void rastro_sinal(void);
+
+// Escreve os intervalos de todos os anéis como JSON Chrome trace
+// @return intervalos escritos, -1 com ENOTSUP se compilado sem RASTRO
+long rastro_exportar(FILE *saida);
+
+void rastro_encerrar(void);
+
+#endif
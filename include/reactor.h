@@ -0,0 +1,10 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Executa n reactors (um por socket de escuta) até o shutdown
+int reactor_executar(const int *listen_fds, int n, int fixar_cpu);
+
+#endif
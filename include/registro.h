@@ -0,0 +1,48 @@
+#ifndef REGISTRO_H
+#define REGISTRO_H
+
+#include "../include/conexao.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Registro de conexões: tabela de slots que cresce sob demanda, com lista de
+ * slots livres (inserção, remoção e contagem O(1)). Cada slot tem um contador
+ * de geração; o handle (geração << 32 | índice) deixa de valer quando o slot
+ * é reutilizado, então um handle antigo nunca aponta para outro cliente.
+ *
+ * Escritores (inserir/remover) se serializam em um mutex do registro. A
+ * leitura (registro_para_cada) não trava: usa seções de leitura por época e
+ * as conexões removidas só perdem a referência do registro depois que todos
+ * os leitores que podiam vê-las saíram da seção.
+ */
+typedef uint64_t registro_handle_t;
+
+#define REGISTRO_HANDLE_INVALIDO 0
+#define REGISTRO_CAPACIDADE_INICIAL 64
+
+// Inicializa o registro com o limite de conexões simultâneas
+int registro_iniciar(size_t limite);
+
+// Insere a conexão (o registro toma uma referência e grava c->handle)
+// @return 0 em sucesso, -1 se o limite foi atingido ou sem memória
+int registro_inserir(conexao_t *c);
+
+// Remove pelo handle da conexão; sem efeito se ela não está (mais) registrada
+// @return 0 se removida, -1 caso contrário
+int registro_remover(conexao_t *c);
+
+// Conexão do handle, com referência (do chamador), ou NULL se a geração não confere
+conexao_t *registro_obter(registro_handle_t handle);
+
+size_t registro_contar(void);
+size_t registro_limite(void);
+
+// Percorre as conexões sem trava global. fn roda dentro da seção de leitura:
+// não deve bloquear nem remover conexões; a conexão é válida durante a chamada.
+void registro_para_cada(void (*fn)(conexao_t *c, void *arg), void *arg);
+
+// Libera o que já passou do período de graça (chamado periodicamente pelos laços)
+void registro_coletar(void);
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef SALAS_H
+#define SALAS_H
+
+#include "../include/conexao.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SALA_NOME_MAX 32
+#define SALA_PADRAO "geral"
+#define SALAS_BUCKETS 256
+#define SALA_CAPACIDADE_INICIAL 8
+#define SALA_HISTORICO_PADRAO 50               // quadros guardados por sala
+#define SALA_HISTORICO_BYTES_PADRAO (64 * 1024)
+#define SALA_COPIA_LOCAL 64                    // membros copiados na pilha antes de recorrer ao malloc
+
+/*
+ * Sala de chat com índice próprio de membros: o broadcast de uma sala percorre
+ * só os membros dela. Cada conexão está em no máximo uma sala e guarda sua
+ * posição no vetor de membros (remoção O(1) por troca com o último).
+ * O histórico guarda referências aos últimos quadros difundidos na sala,
+ * reenviados sem recodificação a quem entra.
+ * O broadcast copia os membros (com uma referência cada) sob o mutex e
+ * entrega depois de soltá-lo; o mutex de ordem serializa só os broadcasts da
+ * sala, para que todo membro receba as mensagens na mesma sequência.
+ */
+typedef struct sala {
+    struct sala *prox;                 // encadeamento no bucket da tabela
+    char nome[SALA_NOME_MAX];
+    pthread_mutex_t mutex;             // protege os membros e o histórico
+    pthread_mutex_t ordem;             // um broadcast por vez na sala (tomado antes do mutex)
+    conexao_t **membros;
+    size_t num_membros;
+    size_t capacidade;
+    quadro_t **historico;              // anel dos últimos broadcasts (protegido pelo mutex)
+    size_t hist_inicio;
+    size_t hist_quantidade;
+    size_t hist_bytes;
+    atomic_uint_fast64_t mensagens;    // broadcasts na sala
+    atomic_uint_fast64_t entregas;     // quadros enfileirados para membros (fan-out)
+} sala_t;
+
+// Resumo de uma sala para listagem/estatísticas
+typedef struct {
+    char nome[SALA_NOME_MAX];
+    size_t membros;
+    uint64_t mensagens;
+    uint64_t entregas;
+} sala_info_t;
+
+// Limites do histórico de cada sala (0 em qualquer um desativa)
+void sala_configurar_historico(size_t quadros, size_t bytes);
+
+// Coloca a conexão na sala (criada no primeiro uso), saindo da atual, e
+// enfileira para ela o histórico da sala em um único lote.
+// Apenas o laço dono da conexão chama. @return 0 em sucesso, -1 em erro
+int sala_entrar(conexao_t *c, const char *nome);
+
+// Tira a conexão da sala atual; salas vazias (exceto a padrão) são liberadas
+void sala_sair(conexao_t *c);
+
+// Enfileira o texto para os membros da sala da conexão (exceto ela mesma se
+// excluir_remetente) e o publica para os nós federados.
+// @return quantidade de membros que receberam
+int sala_broadcast(conexao_t *c, const char *msg, size_t tamanho, int excluir_remetente);
+
+// Entrega aos membros locais da sala pelo nome (mensagem vinda de outro nó,
+// não é reenviada à federação); sala inexistente não é criada
+// @return quantidade de membros que receberam
+int sala_difundir(const char *nome, const char *msg, size_t tamanho);
+
+// Nome válido: 1..SALA_NOME_MAX-1 caracteres alfanuméricos, '-' ou '_'
+int sala_nome_valido(const char *nome, size_t tamanho);
+
+// Copia até max salas em info, ordenadas por entregas (mais quentes primeiro)
+// @return quantidade copiada
+size_t sala_listar(sala_info_t *info, size_t max);
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef SERVIDOR_H
+#define SERVIDOR_H
+
+#include "../include/libtslog.h"
+#include "../include/fila_threadsafe.h"
+#include "../include/protocolo.h"
+#include "../include/conexao.h"
+#include "../include/eventos.h"
+#include "../include/registro.h"
+#include "../include/salas.h"
+#include "../include/uring.h"
+#include "../include/metricas.h"
+#include "../include/pool.h"
+#include "../include/transferencia.h"
+#include "../include/limites.h"
+#include "../include/federacao.h"
+#include "../include/local.h"
+#include "../include/difusao.h"
+#include "../include/memoria.h"
+#include "../include/rastro.h"
+#include <signal.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#define PORT 8080
+#define MAX_CLIENTS 10        // limite padrão de clientes simultâneos (--max-clientes)
+#define BUFFER_SIZE 1024
+#define MAX_REACTORS 64
+#define SALAS_LISTAGEM 10     // salas mostradas em /salas e nas estatísticas finais
+// Recusa de conexão já enquadrada (cabeçalho com o tamanho de 43 bytes)
+#define REJECT_FRAME "\0\0\0\x2b" "Servidor cheio. Tente novamente mais tarde."
+
+// Modelos de atendimento selecionáveis na inicialização
+typedef enum {
+    MODO_THREADS,   // uma thread por cliente
+    MODO_EPOLL,     // um ou mais event loops epoll edge-triggered
+    MODO_URING,     // um event loop io_uring (cai para epoll se indisponível)
+    MODO_POOL       // pool fixo de workers com roubo de tarefas
+} modo_servidor_t;
+
+typedef struct {
+    modo_servidor_t modo;
+    int porta;              // porta do chat
+    int num_reactors;       // reactors no modo epoll (um socket SO_REUSEPORT cada)
+    int num_workers;        // workers no modo pool (0 = um por CPU)
+    size_t pilha_kb;        // pilha das threads de atendimento (workers ou por cliente)
+    size_t max_clientes;    // limite de conexões simultâneas
+    int fixar_cpu;          // fixa cada reactor em uma CPU
+    config_saida_t saida;   // marcas da fila de saída e despejo de clientes lentos
+    int log_assincrono;     // libtslog em modo group commit
+    const char *log_binario; // arquivo do log binário de eventos (NULL = desativado)
+    int admin_porta;        // listener local de métricas (0 = desativado)
+    size_t historico;       // quadros no histórico de cada sala (0 = desativado)
+    size_t historico_bytes; // limite em bytes do histórico de cada sala
+    const char *transferencia; // socket Unix do hot upgrade (NULL = desativado)
+    config_limites_t limites; // limites de taxa de entrada por conexão e globais
+    config_federacao_t federacao; // porta dos pares e pares a conectar
+    config_local_t local;   // socket Unix e canal em memória compartilhada
+    config_difusao_t difusao; // fan-out paralelo dos broadcasts grandes
+    config_memoria_t memoria; // orçamento global de memória (conexões e filas de saída)
+} config_servidor_t;
+
+// Estado global compartilhado entre os modos de atendimento
+extern ThreadSafeQueue msg_queue;
+extern volatile sig_atomic_t shutdown_requested;
+extern int server_fd_global;
+
+void log_server_error(const char *operacao, int error_code);
+// Registra o evento no log binário, se ativo (cliente_id 0 = sem cliente)
+// @return 0 se registrado, -1 se o log binário está desativado (usar o log texto)
+int log_server_event(evento_t tipo, uint64_t cliente_id, const void *payload, size_t len);
+void log_client_address(evento_t tipo, const conexao_t *c);
+void mark_socket_for_removal(conexao_t *c);
+int count_connected_clients(void);
+
+// Registro de clientes (retorna 0 em sucesso, -1 se o limite foi atingido)
+int add_client(conexao_t *c);
+void remove_client(conexao_t *c);
+// Envia o aviso de servidor cheio (o chamador fecha o socket)
+void reject_client(int client_fd);
+
+// Eventos do chat comuns a todos os modos
+int announce_client_join(conexao_t *c);
+int process_client_message(conexao_t *c, const char *buffer, size_t len);
+void announce_client_leave(conexao_t *c);
+
+// Atendimento de uma conexão pelo seu laço dono
+int handle_client_event(conexao_t *c, uint32_t events);
+// Retoma uma conexão suspensa pelo limite de taxa (devolvida por laco_retomar)
+int resume_client(conexao_t *c);
+// Processa os quadros completos do anel de recepção (-1 = encerrar a conexão)
+int process_client_frames(conexao_t *c);
+void close_client(conexao_t *c);
+// Thread de um cliente herdado no hot upgrade (arg: herdada_t)
+void *handle_inherited_client(void *arg);
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef TRANSFERENCIA_H
+#define TRANSFERENCIA_H
+
+#include "../include/conexao.h"
+#include "../include/salas.h"
+#include <stddef.h>
+
+#define TRANSFERENCIA_BLOCO (32 * 1024)     // saída pendente por registro SEQPACKET
+#define TRANSFERENCIA_ESPERA_MS 3000        // espera pelas threads por cliente no hot upgrade
+
+/*
+ * Hot upgrade: o processo novo conecta no socket Unix do antigo, que passa
+ * os sockets de escuta e, depois que os laços param, cada conexão viva com
+ * SCM_RIGHTS junto do estado dela (sala, quadro parcial recebido e saída
+ * ainda não enviada). Nenhum socket é fechado no caminho: o kernel segura
+ * as conexões novas na fila de escuta e os bytes recebidos durante a troca.
+ */
+
+// Conexão recebida do processo antigo, ainda fora de qualquer laço
+typedef struct herdada {
+    conexao_t *c;                    // referência de criação (passa para quem adota)
+    char sala[SALA_NOME_MAX];
+    char *saida;                     // bytes já enquadrados a reenviar antes de tudo
+    size_t saida_bytes;
+    struct herdada *prox;
+} herdada_t;
+
+// Processo novo: conecta em caminho e recebe os sockets de escuta e as
+// conexões do processo antigo (bloqueia até o fim da transferência)
+// @return sockets de escuta recebidos (0 = não há processo antigo), -1 em erro
+int transferencia_receber(const char *caminho, int *escutas, int max);
+
+// Próxima conexão herdada (NULL = acabaram); chamar antes de iniciar os laços
+herdada_t *transferencia_proxima(void);
+
+// Registra a herdada no laço (conexao_registrar), no registro de clientes e
+// na sala, com a saída herdada à frente do histórico. Consome h.
+// @return a conexão (referência de criação) ou NULL se recusada e encerrada
+conexao_t *transferencia_adotar(herdada_t *h, laco_t *laco);
+// Encerra uma herdada que o backend não conseguiu adotar. Consome h.
+void transferencia_descartar(herdada_t *h);
+
+// Processo antigo: espera um sucessor em caminho; quando ele conecta, envia
+// os sockets de escuta e pede o shutdown dos laços
+// @return 0 em sucesso, -1 em erro
+int transferencia_iniciar(const char *caminho, const int *escutas, int n);
+
+// Indica que um sucessor assumiu: close_client guarda em vez de fechar
+int transferencia_ativa(void);
+
+// Guarda a conexão para o sucessor (no lugar do close_client). A fila deixa
+// de ser enviada e continua acumulando broadcasts até transferencia_concluir.
+// @return 0 se guardada, -1 se não há transferência em andamento (ou canal shm)
+int transferencia_guardar(conexao_t *c);
+
+// Envia as conexões guardadas e encerra a transferência (laços já parados)
+void transferencia_concluir(void);
+
+// Fecha o socket Unix (e remove o arquivo, se nenhum sucessor o assumiu)
+void transferencia_encerrar(void);
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef URING_H
+#define URING_H
+
+// Retorno de uring_executar quando o kernel não oferece o necessário
+// (io_uring desativado, sem anel de buffers fornecidos etc.)
+#define URING_INDISPONIVEL (-2)
+
+// Submissões por chamada de io_uring_enter e buffers de recepção fornecidos ao kernel
+#define URING_ENTRADAS 1024
+#define URING_BUFFERS 1024
+#define URING_BUFFER_TAMANHO 4096
+
+// Executa o event loop io_uring no socket de escuta até o shutdown
+// @return 0 ao finalizar, -1 em erro, URING_INDISPONIVEL se o backend não pode ser usado
+int uring_executar(int listen_fd);
+
+#endif
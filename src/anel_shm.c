@@ -0,0 +1,83 @@
+#include "../include/anel_shm.h"
+#include <string.h>
+
+#define MASCARA (ANEL_SHM_CAPACIDADE - 1)
+
+void anel_shm_iniciar(canal_shm_t *canal) {
+    memset(canal, 0, offsetof(canal_shm_t, entrada));
+    canal->versao = ANEL_SHM_VERSAO;
+    canal->capacidade = ANEL_SHM_CAPACIDADE;
+    anel_shm_t *aneis[2] = { &canal->entrada, &canal->saida };
+    for (int i = 0; i < 2; i++) {
+        atomic_init(&aneis[i]->cabeca, 0);
+        atomic_init(&aneis[i]->cauda, 0);
+        atomic_init(&aneis[i]->produtor_esperando, 0);
+        atomic_init(&aneis[i]->consumidor_ocioso, 1);  // ninguém leu ainda: o 1º dado avisa
+    }
+}
+
+size_t anel_shm_escrever(anel_shm_t *a, const struct iovec *iov, size_t n) {
+    uint64_t cabeca = atomic_load_explicit(&a->cabeca, memory_order_relaxed);
+    uint64_t cauda = atomic_load_explicit(&a->cauda, memory_order_acquire);
+    size_t livre = ANEL_SHM_CAPACIDADE - (size_t)(cabeca - cauda);
+    size_t total = 0;
+
+    for (size_t i = 0; i < n && livre > 0; i++) {
+        size_t len = iov[i].iov_len < livre ? iov[i].iov_len : livre;
+        size_t pos = (size_t)(cabeca + total) & MASCARA;
+        size_t primeiro = ANEL_SHM_CAPACIDADE - pos < len ? ANEL_SHM_CAPACIDADE - pos : len;
+        memcpy(a->dados + pos, iov[i].iov_base, primeiro);
+        memcpy(a->dados, (const char *)iov[i].iov_base + primeiro, len - primeiro);
+        total += len;
+        livre -= len;
+    }
+    atomic_store_explicit(&a->cabeca, cabeca + total, memory_order_release);
+    return total;
+}
+
+size_t anel_shm_trecho(anel_shm_t *a, const char **dados) {
+    uint64_t cauda = atomic_load_explicit(&a->cauda, memory_order_relaxed);
+    uint64_t cabeca = atomic_load_explicit(&a->cabeca, memory_order_acquire);
+    size_t pos = (size_t)cauda & MASCARA;
+    size_t disponivel = (size_t)(cabeca - cauda);
+    *dados = a->dados + pos;
+    return ANEL_SHM_CAPACIDADE - pos < disponivel ? ANEL_SHM_CAPACIDADE - pos : disponivel;
+}
+
+void anel_shm_consumir(anel_shm_t *a, size_t n) {
+    atomic_store_explicit(&a->cauda, atomic_load_explicit(&a->cauda, memory_order_relaxed) + n,
+                          memory_order_release);
+}
+
+int anel_shm_adormecer(anel_shm_t *a) {
+    atomic_store(&a->consumidor_ocioso, 1);
+    if (atomic_load(&a->cabeca) != atomic_load_explicit(&a->cauda, memory_order_relaxed)) {
+        atomic_store(&a->consumidor_ocioso, 0);
+        return 0;
+    }
+    return 1;
+}
+
+int anel_shm_aguardar_espaco(anel_shm_t *a) {
+    atomic_store(&a->produtor_esperando, 1);
+    uint64_t ocupados = atomic_load_explicit(&a->cabeca, memory_order_relaxed) - atomic_load(&a->cauda);
+    if (ocupados < ANEL_SHM_CAPACIDADE) {
+        atomic_store(&a->produtor_esperando, 0);
+        return 0;
+    }
+    return 1;
+}
+
+// As marcas e os contadores são seq_cst dos dois lados: quem publica vê a
+// marca de quem foi dormir, ou quem foi dormir vê o que foi publicado
+int anel_shm_publicado(anel_shm_t *a) {
+    atomic_thread_fence(memory_order_seq_cst);
+    return atomic_load_explicit(&a->consumidor_ocioso, memory_order_relaxed) &&
+           atomic_exchange(&a->consumidor_ocioso, 0);
+}
+
+int anel_shm_liberado(anel_shm_t *a) {
+    atomic_thread_fence(memory_order_seq_cst);
+    return atomic_load_explicit(&a->produtor_esperando, memory_order_relaxed) &&
+           atomic_exchange(&a->produtor_esperando, 0);
+}
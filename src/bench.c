@@ -0,0 +1,784 @@
+#define _GNU_SOURCE
+#include "../include/protocolo.h"
+#include "../include/histograma.h"
+#include "../include/anel_shm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define PORT 8080
+#define BENCH_MAX_THREADS 64
+#define BENCH_MAX_EVENTOS 256
+#define BENCH_LEITURA (64 * 1024)
+#define BENCH_TICK_MS 1
+#define BENCH_AQUECIMENTO_MS 1000   // espera após as conexões (boas-vindas e anúncios de entrada)
+#define BENCH_DRENAGEM_MS 1000      // espera pelas entregas em trânsito ao fim da medição
+
+// Marca do carimbo de tempo no payload: "#B" + 16 dígitos hexadecimais (ns, CLOCK_MONOTONIC)
+#define BENCH_MARCA "#B"
+#define BENCH_CARIMBO 18
+#define BENCH_REJEICAO "Servidor cheio"
+
+typedef enum {
+    FASE_AQUECIMENTO,
+    FASE_MEDICAO,
+    FASE_DRENAGEM,
+    FASE_FIM
+} fase_t;
+
+typedef struct {
+    const char *servidor;
+    int porta;
+    int sessoes;
+    double taxa;            // mensagens por segundo (somando todas as sessões)
+    size_t tamanho;         // bytes de payload por mensagem
+    int duracao_s;
+    int threads;
+    int salas;              // 0/1 = todas na sala padrão; K = sessões distribuídas em K salas
+    const char *unix_caminho; // socket Unix do servidor (NULL = TCP)
+    int shm;                // pede o canal em memória compartilhada (exige unix_caminho)
+} config_bench_t;
+
+typedef struct {
+    uint64_t enviadas;
+    uint64_t bytes_recebidos;
+    uint64_t erros_conexao;
+    uint64_t rejeitadas;
+    uint64_t erros_envio;
+    uint64_t desconexoes;
+    uint64_t atrasadas;         // envio adiado: sessão ainda com quadro anterior pendente
+    histograma_t latencia;      // uma amostra por cópia recebida com carimbo da medição
+} contadores_t;
+
+typedef struct {
+    int fd;
+    int ativa;
+    char *saida;                // quadro em envio (parcial quando saida_off < saida_len)
+    size_t saida_len;
+    size_t saida_off;
+    char *parcial;              // quadro incompleto da última leitura
+    size_t parcial_len;
+    canal_shm_t *shm;           // canal em memória compartilhada (NULL = socket)
+    int evfd_servidor;          // acorda o servidor (dados na entrada, espaço na saída)
+    int evfd_cliente;           // acordado pelo servidor (no epoll da thread)
+} sessao_t;
+
+typedef struct {
+    int id;
+    pthread_t tid;
+    int epfd;
+    sessao_t *sessoes;
+    int num_sessoes;
+    int proxima;                // rodízio de envio
+    char *leitura;
+    contadores_t cont;
+} worker_t;
+
+static config_bench_t cfg;
+static struct sockaddr_in endereco;
+static struct sockaddr_un endereco_local;
+static atomic_int fase = FASE_AQUECIMENTO;
+static atomic_int conectando;
+static atomic_uint_fast64_t inicio_medicao_ns;
+
+static uint64_t agora_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void fechar_sessao(worker_t *w, sessao_t *s) {
+    if (!s->ativa) {
+        return;
+    }
+    epoll_ctl(w->epfd, EPOLL_CTL_DEL, s->fd, NULL);
+    close(s->fd);
+    if (s->shm != NULL) {
+        epoll_ctl(w->epfd, EPOLL_CTL_DEL, s->evfd_cliente, NULL);
+        close(s->evfd_cliente);
+        close(s->evfd_servidor);
+        munmap(s->shm, sizeof(canal_shm_t));
+        s->shm = NULL;
+    }
+    s->ativa = 0;
+}
+
+static void sinalizar(int evfd) {
+    uint64_t um = 1;
+    ssize_t escrito = write(evfd, &um, sizeof(um));
+    (void)escrito;  // contador cheio (EAGAIN) já acorda o outro lado
+}
+
+/**
+ * Recebe da sessão: do socket ou, com o canal ativo, do anel de saída do
+ * servidor (o socket então só indica o fim da conexão)
+ * @return bytes recebidos, 0 no fim da conexão, -1 com errno (EAGAIN = nada agora)
+ */
+static ssize_t receber(sessao_t *s, char *destino, size_t max) {
+    if (s->shm == NULL) {
+        return recv(s->fd, destino, max, 0);
+    }
+    anel_shm_t *a = &s->shm->saida;
+    while (1) {
+        const char *dados;
+        size_t n = anel_shm_trecho(a, &dados);
+        if (n > 0) {
+            n = n < max ? n : max;
+            memcpy(destino, dados, n);
+            anel_shm_consumir(a, n);
+            if (anel_shm_liberado(a)) {
+                sinalizar(s->evfd_servidor);
+            }
+            return (ssize_t)n;
+        }
+        if (anel_shm_adormecer(a)) {
+            break;
+        }
+    }
+    char byte;
+    if (recv(s->fd, &byte, 1, MSG_DONTWAIT) == 0) {
+        return 0;
+    }
+    errno = EAGAIN;
+    return -1;
+}
+
+/**
+ * Interpreta um quadro recebido: broadcasts com carimbo viram amostras de
+ * latência; o aviso de servidor cheio conta como rejeição
+ */
+static void tratar_quadro(worker_t *w, const char *payload, size_t len, uint64_t agora) {
+    const char *marca = memmem(payload, len, BENCH_MARCA, sizeof(BENCH_MARCA) - 1);
+    if (marca == NULL) {
+        if (memmem(payload, len, BENCH_REJEICAO, sizeof(BENCH_REJEICAO) - 1) != NULL) {
+            w->cont.rejeitadas++;
+        }
+        return;
+    }
+    if ((size_t)(payload + len - marca) < BENCH_CARIMBO) {
+        return;
+    }
+
+    uint64_t enviado = 0;
+    for (int i = 2; i < BENCH_CARIMBO; i++) {
+        char d = marca[i];
+        enviado = (enviado << 4) | (uint64_t)(d <= '9' ? d - '0' : d - 'a' + 10);
+    }
+    // Mensagens da fase de aquecimento (ou de outra execução) não entram na amostra
+    if (enviado >= atomic_load(&inicio_medicao_ns) && agora >= enviado) {
+        hist_registrar(&w->cont.latencia, agora - enviado);
+    }
+}
+
+/**
+ * Lê tudo o que estiver disponível na sessão e processa os quadros completos.
+ * O quadro incompleto do fim da leitura vai para um buffer da sessão,
+ * alocado só quando necessário, para manter milhares de sessões baratas.
+ * @return 0 se a sessão continua, -1 se foi encerrada pelo servidor
+ */
+static int ler_sessao(worker_t *w, sessao_t *s) {
+    const size_t maximo = PROTO_CABECALHO + PROTO_MAX_PAYLOAD;
+
+    // Zera o eventfd antes de olhar o anel: um aviso posterior fica pendente
+    if (s->shm != NULL) {
+        uint64_t valor;
+        ssize_t lido = read(s->evfd_cliente, &valor, sizeof(valor));
+        (void)lido;
+    }
+
+    while (1) {
+        size_t total = s->parcial_len;
+        if (total > 0) {
+            memcpy(w->leitura, s->parcial, total);
+        }
+        ssize_t n = receber(s, w->leitura + total, BENCH_LEITURA);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return 0;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        w->cont.bytes_recebidos += (uint64_t)n;
+        total += (size_t)n;
+
+        uint64_t agora = agora_ns();
+        size_t pos = 0;
+        while (total - pos >= PROTO_CABECALHO) {
+            uint32_t cabecalho;
+            memcpy(&cabecalho, w->leitura + pos, PROTO_CABECALHO);
+            size_t len = ntohl(cabecalho);
+            if (len > PROTO_MAX_PAYLOAD) {
+                return -1;
+            }
+            if (total - pos < PROTO_CABECALHO + len) {
+                break;
+            }
+            tratar_quadro(w, w->leitura + pos + PROTO_CABECALHO, len, agora);
+            pos += PROTO_CABECALHO + len;
+        }
+
+        s->parcial_len = total - pos;
+        if (s->parcial_len > 0) {
+            if (s->parcial == NULL && (s->parcial = malloc(maximo)) == NULL) {
+                return -1;
+            }
+            memmove(s->parcial, w->leitura + pos, s->parcial_len);
+        }
+    }
+}
+
+/**
+ * Continua o envio do quadro pendente da sessão
+ * @return 0 se a sessão continua, -1 em erro de escrita
+ */
+static int escrever_sessao(worker_t *w, sessao_t *s) {
+    // Canal em memória compartilhada: sem espaço, o servidor avisa pelo
+    // eventfd da sessão ao consumir (o laço tenta de novo a cada evento)
+    if (s->shm != NULL) {
+        anel_shm_t *a = &s->shm->entrada;
+        while (s->saida_off < s->saida_len) {
+            struct iovec iov = { s->saida + s->saida_off, s->saida_len - s->saida_off };
+            size_t n = anel_shm_escrever(a, &iov, 1);
+            s->saida_off += n;
+            if (n == 0 && anel_shm_aguardar_espaco(a)) {
+                break;
+            }
+        }
+        if (anel_shm_publicado(a)) {
+            sinalizar(s->evfd_servidor);
+        }
+        if (s->saida_off == s->saida_len) {
+            s->saida_len = 0;
+            s->saida_off = 0;
+        }
+        return 0;
+    }
+
+    while (s->saida_off < s->saida_len) {
+        ssize_t n = send(s->fd, s->saida + s->saida_off, s->saida_len - s->saida_off,
+                         MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                struct epoll_event ev;
+                ev.events = EPOLLIN | EPOLLOUT;
+                ev.data.ptr = s;
+                epoll_ctl(w->epfd, EPOLL_CTL_MOD, s->fd, &ev);
+                return 0;
+            }
+            w->cont.erros_envio++;
+            return -1;
+        }
+        s->saida_off += (size_t)n;
+    }
+    if (s->saida_len > 0) {
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = s;
+        epoll_ctl(w->epfd, EPOLL_CTL_MOD, s->fd, &ev);
+    }
+    s->saida_len = 0;
+    s->saida_off = 0;
+    return 0;
+}
+
+/**
+ * Monta o quadro "#B<carimbo>xxxx..." do tamanho configurado e inicia o envio
+ */
+static void enviar_mensagem(worker_t *w, sessao_t *s) {
+    char *p = s->saida + PROTO_CABECALHO;
+    uint32_t cabecalho = htonl((uint32_t)cfg.tamanho);
+    memcpy(s->saida, &cabecalho, PROTO_CABECALHO);
+
+    uint64_t carimbo = agora_ns();
+    snprintf(p, BENCH_CARIMBO + 1, BENCH_MARCA "%016llx", (unsigned long long)carimbo);
+    memset(p + BENCH_CARIMBO, 'x', cfg.tamanho - BENCH_CARIMBO);
+
+    s->saida_len = PROTO_CABECALHO + cfg.tamanho;
+    s->saida_off = 0;
+    w->cont.enviadas++;
+    if (escrever_sessao(w, s) < 0) {
+        fechar_sessao(w, s);
+        w->cont.desconexoes++;
+    }
+}
+
+/**
+ * Envia as mensagens devidas pela taxa da thread, em rodízio entre as sessões
+ */
+static void enviar_devidas(worker_t *w, uint64_t agora, double taxa_thread) {
+    uint64_t inicio = atomic_load(&inicio_medicao_ns);
+    uint64_t devidas = (uint64_t)((double)(agora - inicio) / 1e9 * taxa_thread);
+    uint64_t ja_tentadas = w->cont.enviadas + w->cont.atrasadas;
+
+    for (; ja_tentadas < devidas; ja_tentadas++) {
+        sessao_t *s = NULL;
+        for (int i = 0; i < w->num_sessoes; i++) {
+            sessao_t *candidata = &w->sessoes[w->proxima];
+            w->proxima = (w->proxima + 1) % w->num_sessoes;
+            if (candidata->ativa) {
+                s = candidata;
+                break;
+            }
+        }
+        if (s == NULL) {
+            return;
+        }
+        if (s->saida_len > 0) {
+            w->cont.atrasadas++;
+            continue;
+        }
+        enviar_mensagem(w, s);
+    }
+}
+
+/**
+ * Pede o canal em memória compartilhada (socket ainda bloqueante) e espera
+ * o aceite, que chega com memfd e eventfds; os quadros anteriores a ele
+ * (boas-vindas, anúncios) são ignorados
+ * @return 0 em sucesso, -1 se recusado ou em erro
+ */
+static int ativar_shm(sessao_t *s) {
+    if (proto_enviar(s->fd, ANEL_SHM_PEDIDO, sizeof(ANEL_SHM_PEDIDO) - 1) < 0) {
+        return -1;
+    }
+
+    proto_ring_t ring;
+    if (proto_ring_init(&ring, PROTO_RING_CAPACIDADE) != 0) {
+        return -1;
+    }
+    int fds[3] = { -1, -1, -1 };
+    int resultado = -1;
+    while (resultado < 0) {
+        char dados[PROTO_RING_CAPACIDADE / 2];
+        struct iovec iov = { dados, sizeof(dados) };
+        union {
+            char buf[CMSG_SPACE(sizeof(fds))];
+            struct cmsghdr alinhamento;
+        } controle;
+        struct msghdr msg = {0};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = controle.buf;
+        msg.msg_controllen = sizeof(controle.buf);
+        ssize_t n = recvmsg(s->fd, &msg, MSG_CMSG_CLOEXEC);
+        if (n <= 0) {
+            break;
+        }
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+            cmsg->cmsg_len == CMSG_LEN(sizeof(fds))) {
+            memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+        }
+        proto_ring_escrever(&ring, dados, (size_t)n);
+
+        const char *payload;
+        size_t len;
+        int status;
+        while ((status = proto_proximo_quadro(&ring, &payload, &len)) == 1) {
+            if (len == sizeof(ANEL_SHM_ACEITE) - 1 && memcmp(payload, ANEL_SHM_ACEITE, len) == 0) {
+                resultado = fds[0] >= 0 ? 0 : -1;
+                status = resultado;  // aceite sem descritores: desiste
+                break;
+            }
+            if (len >= sizeof(ANEL_SHM_RECUSA) - 1 &&
+                memcmp(payload, ANEL_SHM_RECUSA, sizeof(ANEL_SHM_RECUSA) - 1) == 0) {
+                fprintf(stderr, "%.*s\n", (int)len, payload);
+                status = -1;
+                break;
+            }
+        }
+        if (status < 0 || resultado == 0) {
+            break;
+        }
+    }
+    proto_ring_destroy(&ring);
+
+    if (resultado == 0) {
+        void *mapa = mmap(NULL, sizeof(canal_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+        if (mapa == MAP_FAILED || ((canal_shm_t *)mapa)->versao != ANEL_SHM_VERSAO) {
+            if (mapa != MAP_FAILED) {
+                munmap(mapa, sizeof(canal_shm_t));
+            }
+            resultado = -1;
+        } else {
+            s->shm = mapa;
+            s->evfd_servidor = fds[1];
+            s->evfd_cliente = fds[2];
+        }
+    }
+    if (fds[0] >= 0) {
+        close(fds[0]);
+    }
+    if (resultado != 0 && fds[0] >= 0) {
+        close(fds[1]);
+        close(fds[2]);
+    }
+    return resultado;
+}
+
+/**
+ * Conecta a sessão (connect bloqueante, depois não-bloqueante) e a coloca
+ * na sala designada
+ */
+static int conectar_sessao(worker_t *w, sessao_t *s, int indice) {
+    if (cfg.unix_caminho != NULL) {
+        s->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (s->fd < 0) {
+            return -1;
+        }
+        if (connect(s->fd, (struct sockaddr *)&endereco_local, sizeof(endereco_local)) < 0 ||
+            (cfg.shm && ativar_shm(s) < 0)) {
+            close(s->fd);
+            return -1;
+        }
+    } else {
+        s->fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (s->fd < 0) {
+            return -1;
+        }
+        if (connect(s->fd, (struct sockaddr *)&endereco, sizeof(endereco)) < 0) {
+            close(s->fd);
+            return -1;
+        }
+        int um = 1;
+        setsockopt(s->fd, IPPROTO_TCP, TCP_NODELAY, &um, sizeof(um));
+    }
+
+    if (cfg.salas > 1) {
+        char comando[64];
+        int len = snprintf(comando, sizeof(comando), "/entrar bench-%d", indice % cfg.salas);
+        if (proto_enviar(s->fd, comando, (size_t)len) < 0) {
+            close(s->fd);
+            return -1;
+        }
+    }
+    fcntl(s->fd, F_SETFL, fcntl(s->fd, F_GETFL, 0) | O_NONBLOCK);
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = s;
+    s->ativa = 1;
+    if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, s->fd, &ev) < 0 ||
+        (s->shm != NULL && epoll_ctl(w->epfd, EPOLL_CTL_ADD, s->evfd_cliente, &ev) < 0)) {
+        fechar_sessao(w, s);
+        return -1;
+    }
+    return 0;
+}
+
+static void *worker_loop(void *arg) {
+    worker_t *w = arg;
+    double taxa_thread = cfg.taxa / cfg.threads;
+
+    for (int i = 0; i < w->num_sessoes; i++) {
+        if (conectar_sessao(w, &w->sessoes[i], i * cfg.threads + w->id) < 0) {
+            w->cont.erros_conexao++;
+        }
+    }
+    atomic_fetch_sub(&conectando, 1);
+
+    struct epoll_event eventos[BENCH_MAX_EVENTOS];
+    int f;
+    while ((f = atomic_load(&fase)) != FASE_FIM) {
+        int n = epoll_wait(w->epfd, eventos, BENCH_MAX_EVENTOS, BENCH_TICK_MS);
+        for (int i = 0; i < n; i++) {
+            sessao_t *s = eventos[i].data.ptr;
+            if (!s->ativa) {
+                continue;
+            }
+            int erro = 0;
+            if ((eventos[i].events & EPOLLOUT) || (s->shm != NULL && s->saida_len > 0)) {
+                erro = escrever_sessao(w, s) < 0;
+            }
+            if (!erro && (eventos[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+                erro = ler_sessao(w, s) < 0;
+            }
+            if (erro) {
+                fechar_sessao(w, s);
+                w->cont.desconexoes++;
+            }
+        }
+        if (f == FASE_MEDICAO) {
+            enviar_devidas(w, agora_ns(), taxa_thread);
+        }
+    }
+
+    for (int i = 0; i < w->num_sessoes; i++) {
+        fechar_sessao(w, &w->sessoes[i]);
+    }
+    return NULL;
+}
+
+static void somar(contadores_t *total, const contadores_t *c) {
+    total->enviadas += c->enviadas;
+    total->bytes_recebidos += c->bytes_recebidos;
+    total->erros_conexao += c->erros_conexao;
+    total->rejeitadas += c->rejeitadas;
+    total->erros_envio += c->erros_envio;
+    total->desconexoes += c->desconexoes;
+    total->atrasadas += c->atrasadas;
+    hist_somar(&total->latencia, &c->latencia);
+}
+
+/**
+ * Resultado em uma linha JSON (stdout); latências em microssegundos
+ */
+static void imprimir_json(const contadores_t *t, int conectadas, double duracao) {
+    printf("{\"sessoes\":%d,\"conectadas\":%d,\"threads\":%d,\"salas\":%d,"
+           "\"taxa_alvo\":%.1f,\"tamanho\":%zu,\"duracao_s\":%.3f,"
+           "\"enviadas\":%llu,\"entregas\":%llu,\"bytes_recebidos\":%llu,"
+           "\"vazao_envio\":%.1f,\"vazao_entrega\":%.1f,"
+           "\"latencia_us\":{\"p50\":%.1f,\"p90\":%.1f,\"p99\":%.1f,\"p999\":%.1f,\"max\":%.1f},"
+           "\"erros\":{\"conexao\":%llu,\"rejeitadas\":%llu,\"envio\":%llu,"
+           "\"desconexoes\":%llu,\"atrasadas\":%llu}}\n",
+           cfg.sessoes, conectadas, cfg.threads, cfg.salas, cfg.taxa, cfg.tamanho, duracao,
+           (unsigned long long)t->enviadas, (unsigned long long)t->latencia.contagem,
+           (unsigned long long)t->bytes_recebidos,
+           t->enviadas / duracao, t->latencia.contagem / duracao,
+           hist_percentil(&t->latencia, 50.0) / 1e3, hist_percentil(&t->latencia, 90.0) / 1e3,
+           hist_percentil(&t->latencia, 99.0) / 1e3, hist_percentil(&t->latencia, 99.9) / 1e3,
+           t->latencia.max / 1e3,
+           (unsigned long long)t->erros_conexao, (unsigned long long)t->rejeitadas,
+           (unsigned long long)t->erros_envio, (unsigned long long)t->desconexoes,
+           (unsigned long long)t->atrasadas);
+}
+
+static void dormir_ms(long ms) {
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR) {
+    }
+}
+
+/**
+ * Interpreta os argumentos de linha de comando
+ * @return 0 em sucesso, -1 se houver argumento inválido
+ */
+static int parse_args(int argc, char *argv[]) {
+    static const struct option opcoes[] = {
+        {"servidor", required_argument, NULL, 's'},
+        {"porta",    required_argument, NULL, 'p'},
+        {"sessoes",  required_argument, NULL, 'n'},
+        {"taxa",     required_argument, NULL, 'r'},
+        {"tamanho",  required_argument, NULL, 't'},
+        {"duracao",  required_argument, NULL, 'd'},
+        {"threads",  required_argument, NULL, 'w'},
+        {"salas",    required_argument, NULL, 'k'},
+        {"unix",     required_argument, NULL, 'u'},
+        {"shm",      no_argument,       NULL, 'm'},
+        {"help",     no_argument,       NULL, 'h'},
+        {NULL,       0,                 NULL, 0}
+    };
+    int opt;
+
+    cfg.servidor = "127.0.0.1";
+    cfg.porta = PORT;
+    cfg.sessoes = 100;
+    cfg.taxa = 1000.0;
+    cfg.tamanho = 64;
+    cfg.duracao_s = 10;
+    cfg.threads = 1;
+    cfg.salas = 0;
+    cfg.unix_caminho = NULL;
+    cfg.shm = 0;
+
+    while ((opt = getopt_long(argc, argv, "s:p:n:r:t:d:w:k:u:mh", opcoes, NULL)) != -1) {
+        switch (opt) {
+        case 's':
+            cfg.servidor = optarg;
+            break;
+        case 'p':
+            cfg.porta = atoi(optarg);
+            break;
+        case 'n':
+            cfg.sessoes = atoi(optarg);
+            break;
+        case 'r':
+            cfg.taxa = atof(optarg);
+            break;
+        case 't':
+            cfg.tamanho = strtoul(optarg, NULL, 10);
+            break;
+        case 'd':
+            cfg.duracao_s = atoi(optarg);
+            break;
+        case 'w':
+            cfg.threads = atoi(optarg);
+            break;
+        case 'k':
+            cfg.salas = atoi(optarg);
+            break;
+        case 'u':
+            cfg.unix_caminho = optarg;
+            break;
+        case 'm':
+            cfg.shm = 1;
+            break;
+        default:
+            fprintf(stderr, "Uso: %s [--servidor IP] [--porta N] [--sessoes N] [--threads N]\n"
+                            "          [--taxa MSGS/S] [--tamanho BYTES] [--duracao S] [--salas K]\n"
+                            "          [--unix CAMINHO [--shm]]\n",
+                    argv[0]);
+            return -1;
+        }
+    }
+
+    if (cfg.sessoes < 1 || cfg.taxa <= 0 || cfg.duracao_s < 1 || cfg.porta <= 0 ||
+        cfg.threads < 1 || cfg.threads > BENCH_MAX_THREADS || cfg.salas < 0) {
+        fprintf(stderr, "Parâmetros inválidos\n");
+        return -1;
+    }
+    if (cfg.tamanho < BENCH_CARIMBO || cfg.tamanho > PROTO_MAX_TEXTO) {
+        fprintf(stderr, "Tamanho deve estar entre %d e %d bytes\n", BENCH_CARIMBO, PROTO_MAX_TEXTO);
+        return -1;
+    }
+    if (cfg.shm && cfg.unix_caminho == NULL) {
+        fprintf(stderr, "--shm exige --unix CAMINHO\n");
+        return -1;
+    }
+    if (cfg.unix_caminho != NULL && strlen(cfg.unix_caminho) >= sizeof(endereco_local.sun_path)) {
+        fprintf(stderr, "Caminho do socket Unix muito longo\n");
+        return -1;
+    }
+    if (cfg.threads > cfg.sessoes) {
+        cfg.threads = cfg.sessoes;
+    }
+    return 0;
+}
+
+/**
+ * Gerador de carga: abre as sessões, espera o aquecimento, envia na taxa
+ * configurada durante a medição, espera as entregas em trânsito e imprime
+ * o resultado em JSON. Mensagens de progresso vão para stderr.
+ */
+int main(int argc, char *argv[]) {
+    if (parse_args(argc, argv) != 0) {
+        return 1;
+    }
+
+    memset(&endereco, 0, sizeof(endereco));
+    endereco.sin_family = AF_INET;
+    endereco.sin_port = htons((uint16_t)cfg.porta);
+    if (inet_pton(AF_INET, cfg.servidor, &endereco.sin_addr) <= 0) {
+        fprintf(stderr, "Endereço IP inválido: %s\n", cfg.servidor);
+        return 1;
+    }
+    memset(&endereco_local, 0, sizeof(endereco_local));
+    endereco_local.sun_family = AF_UNIX;
+    if (cfg.unix_caminho != NULL) {
+        strcpy(endereco_local.sun_path, cfg.unix_caminho);
+    }
+
+    // Milhares de sessões precisam de descritores acima do limite padrão
+    struct rlimit lim;
+    if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < (rlim_t)cfg.sessoes + 64) {
+        lim.rlim_cur = (rlim_t)cfg.sessoes + 64 < lim.rlim_max ? (rlim_t)cfg.sessoes + 64 : lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim);
+    }
+
+    worker_t *workers = calloc((size_t)cfg.threads, sizeof(worker_t));
+    if (workers == NULL) {
+        perror("calloc");
+        return 1;
+    }
+    atomic_store(&conectando, cfg.threads);
+    atomic_store(&inicio_medicao_ns, UINT64_MAX);
+
+    int iniciados = 0;
+    for (; iniciados < cfg.threads; iniciados++) {
+        worker_t *w = &workers[iniciados];
+        w->id = iniciados;
+        w->num_sessoes = cfg.sessoes / cfg.threads + (iniciados < cfg.sessoes % cfg.threads);
+        w->sessoes = calloc((size_t)w->num_sessoes, sizeof(sessao_t));
+        w->leitura = malloc(PROTO_CABECALHO + PROTO_MAX_PAYLOAD + BENCH_LEITURA);
+        w->epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (w->sessoes == NULL || w->leitura == NULL || w->epfd < 0) {
+            perror("worker");
+            break;
+        }
+        for (int i = 0; i < w->num_sessoes; i++) {
+            w->sessoes[i].saida = malloc(PROTO_CABECALHO + cfg.tamanho);
+            if (w->sessoes[i].saida == NULL) {
+                perror("malloc");
+                return 1;
+            }
+        }
+        if (pthread_create(&w->tid, NULL, worker_loop, w) != 0) {
+            perror("pthread_create");
+            break;
+        }
+    }
+    if (iniciados < cfg.threads) {
+        atomic_store(&fase, FASE_FIM);
+        for (int i = 0; i < iniciados; i++) {
+            pthread_join(workers[i].tid, NULL);
+        }
+        return 1;
+    }
+
+    if (cfg.unix_caminho != NULL) {
+        fprintf(stderr, "Conectando %d sessões a %s%s...\n", cfg.sessoes, cfg.unix_caminho,
+                cfg.shm ? " (memória compartilhada)" : "");
+    } else {
+        fprintf(stderr, "Conectando %d sessões a %s:%d...\n", cfg.sessoes, cfg.servidor, cfg.porta);
+    }
+    while (atomic_load(&conectando) > 0) {
+        dormir_ms(10);
+    }
+    dormir_ms(BENCH_AQUECIMENTO_MS);
+
+    fprintf(stderr, "Medindo por %d s a %.0f msg/s (%zu bytes)...\n", cfg.duracao_s, cfg.taxa, cfg.tamanho);
+    uint64_t inicio = agora_ns();
+    atomic_store(&inicio_medicao_ns, inicio);
+    atomic_store(&fase, FASE_MEDICAO);
+    dormir_ms(cfg.duracao_s * 1000L);
+    double duracao = (double)(agora_ns() - inicio) / 1e9;
+    atomic_store(&fase, FASE_DRENAGEM);
+    dormir_ms(BENCH_DRENAGEM_MS);
+    atomic_store(&fase, FASE_FIM);
+
+    contadores_t *total = calloc(1, sizeof(contadores_t));
+    if (total == NULL) {
+        perror("calloc");
+        return 1;
+    }
+    for (int i = 0; i < cfg.threads; i++) {
+        worker_t *w = &workers[i];
+        pthread_join(w->tid, NULL);
+        somar(total, &w->cont);
+        for (int j = 0; j < w->num_sessoes; j++) {
+            free(w->sessoes[j].saida);
+            free(w->sessoes[j].parcial);
+        }
+        free(w->sessoes);
+        free(w->leitura);
+        close(w->epfd);
+    }
+
+    int conectadas = cfg.sessoes - (int)total->erros_conexao;
+    imprimir_json(total, conectadas, duracao);
+
+    free(total);
+    free(workers);
+    return conectadas > 0 ? 0 : 1;
+}
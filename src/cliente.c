@@ -1,4 +1,5 @@
 #include "../include/libtslog.h"
+#include "../include/protocolo.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -7,9 +8,9 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <errno.h>
 
 #define PORT 8080
-#define BUFFER_SIZE 1024
 
 // Variável global para o logger do cliente
 static logger_t *log = NULL;
@@ -21,24 +22,44 @@ static logger_t *log = NULL;
  */
 void *receive_messages(void *arg) {
     int sock = *(int *)arg;
-    char buffer[BUFFER_SIZE];
-    int read_size;
+    proto_ring_t ring;
 
-    // Loop principal de recebimento de mensagens
-    while ((read_size = recv(sock, buffer, BUFFER_SIZE - 1, 0)) > 0) {
-        buffer[read_size] = '\0'; // Adiciona null terminator
-        
-        // Exibir mensagem recebida de forma destacada no terminal
-        printf("\n📨 MENSAGEM DO SERVIDOR: %s\n", buffer);
-        printf("> ");
-        fflush(stdout); // Força exibição imediata
-        
-        // Log da mensagem recebida no arquivo de log
-        char log_msg[BUFFER_SIZE + 50];
-        sprintf(log_msg, "Mensagem recebida do servidor: %s", buffer);
-        log_escrever_verbose(log, log_msg);
+    if (proto_ring_init(&ring, PROTO_RING_CAPACIDADE) != 0) {
+        log_escrever_verbose(log, "ERRO: Falha ao alocar buffer de recepção");
+        return NULL;
     }
 
+    // Loop principal de recebimento: cada leitura pode conter vários quadros
+    while (1) {
+        ssize_t read_size = proto_ring_ler(&ring, sock);
+        if (read_size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (read_size <= 0) {
+            break;
+        }
+
+        const char *payload;
+        size_t len;
+        int status;
+        while ((status = proto_proximo_quadro(&ring, &payload, &len)) == 1) {
+            // Exibir mensagem recebida de forma destacada no terminal
+            printf("\n📨 MENSAGEM DO SERVIDOR: %.*s\n", (int)len, payload);
+            printf("> ");
+            fflush(stdout); // Força exibição imediata
+            
+            // Log da mensagem recebida no arquivo de log
+            char log_msg[PROTO_MAX_PAYLOAD + 50];
+            snprintf(log_msg, sizeof(log_msg), "Mensagem recebida do servidor: %.*s", (int)len, payload);
+            log_escrever_verbose(log, log_msg);
+        }
+        if (status < 0) {
+            log_escrever_verbose(log, "ERRO: Quadro inválido recebido do servidor");
+            break;
+        }
+    }
+    proto_ring_destroy(&ring);
+
     // Servidor desconectou (recv retornou 0 ou erro)
     printf("\n❌ Servidor desconectou\n");
     log_escrever_verbose(log, "Servidor desconectou");
@@ -49,7 +70,8 @@ void *receive_messages(void *arg) {
 /**
  * Função principal do cliente
  * @param argc Número de argumentos
- * @param argv Argumentos: [0] nome programa, [1] IP do servidor (opcional)
+ * @param argv Argumentos: [0] nome programa, [1] IP do servidor (opcional),
+ *             [2] porta do servidor (opcional)
  * @return 0 em sucesso, -1 em erro
  */
 int main(int argc, char const *argv[]) {
@@ -67,15 +89,20 @@ int main(int argc, char const *argv[]) {
     struct sockaddr_in serv_addr;
     pthread_t recv_thread;
     char server_ip[100] = "127.0.0.1"; // IP padrão local (localhost)
+    int server_port = PORT;
 
     // Verifica se foi especificado IP do servidor por argumento
     if (argc > 1) {
         strncpy(server_ip, argv[1], sizeof(server_ip) - 1);
     }
+    // Porta de outra instância (ex.: nós de uma federação na mesma máquina)
+    if (argc > 2) {
+        server_port = atoi(argv[2]);
+    }
 
     // Interface inicial do usuário
     printf("=== CLIENTE DE CHAT ===\n");
-    printf("Conectando ao servidor %s:%d...\n", server_ip, PORT);
+    printf("Conectando ao servidor %s:%d...\n", server_ip, server_port);
 
     // Cria socket TCP
     if ((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
@@ -85,7 +112,7 @@ int main(int argc, char const *argv[]) {
 
     // Configura estrutura de endereço do servidor
     serv_addr.sin_family = AF_INET;          // Família IPv4
-    serv_addr.sin_port = htons(PORT);        // Porta (converte para network byte order)
+    serv_addr.sin_port = htons(server_port);        // Porta (converte para network byte order)
 
     // Converte endereço IP de string para binário
     if (inet_pton(AF_INET, server_ip, &serv_addr.sin_addr) <= 0) {
@@ -95,7 +122,7 @@ int main(int argc, char const *argv[]) {
 
     // Tenta conectar ao servidor
     if (connect(sock, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
-        printf("\n❌ Conexão falhou com %s:%d\n", server_ip, PORT);
+        printf("\n❌ Conexão falhou com %s:%d\n", server_ip, server_port);
         printf("   Certifique-se que o servidor está rodando\n");
         log_escrever_verbose(log, "ERRO: Falha na conexão com o servidor");
         return -1;
@@ -106,13 +133,13 @@ int main(int argc, char const *argv[]) {
     pthread_detach(recv_thread); // A thread se auto-liberará ao terminar
 
     // Loop principal para envio de mensagens
-    char message[BUFFER_SIZE];
+    char message[PROTO_MAX_TEXTO + 2];
     while (1) {
         printf("> ");
         fflush(stdout); // Força exibição do prompt
         
         // Lê mensagem do usuário
-        if (fgets(message, BUFFER_SIZE, stdin) == NULL) {
+        if (fgets(message, sizeof(message), stdin) == NULL) {
             break; // EOF ou erro de leitura
         }
         
@@ -122,16 +149,15 @@ int main(int argc, char const *argv[]) {
         // Ignora mensagens vazias
         if (strlen(message) == 0) continue;
 
-        // Envia mensagem para o servidor
-        int bytes_sent = send(sock, message, strlen(message), 0);
-        if (bytes_sent < 0) {
+        // Envia mensagem para o servidor (um quadro por linha)
+        if (proto_enviar(sock, message, strlen(message)) < 0) {
             printf("❌ Erro ao enviar mensagem\n");
             break;
         }
         
         // Log da mensagem enviada
-        char log_msg[BUFFER_SIZE + 50];
-        sprintf(log_msg, "Mensagem enviada para servidor: %s", message);
+        char log_msg[PROTO_MAX_TEXTO + 50];
+        snprintf(log_msg, sizeof(log_msg), "Mensagem enviada para servidor: %s", message);
         log_escrever_verbose(log, log_msg);
 
         // Verifica se é comando de saída
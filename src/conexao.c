@@ -0,0 +1,679 @@
+#include "../include/conexao.h"
+#include "../include/servidor.h"
+#include "../include/memoria.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/tcp.h>
+
+#define EVENTOS_BASE (EPOLLIN | EPOLLRDHUP | EPOLLET)
+
+static config_saida_t config_saida = {
+    SAIDA_MARCA_ALTA_PADRAO, SAIDA_MARCA_BAIXA_PADRAO, SAIDA_DESPEJO_MS_PADRAO,
+    0, SAIDA_COALESCER_BYTES_PADRAO
+};
+
+static atomic_uint_fast64_t proximo_id = 1;
+static atomic_uint_fast64_t total_descartadas = 0;
+static atomic_uint_fast64_t total_despejadas = 0;
+
+static _Thread_local laco_t *laco_atual = NULL;
+
+// Conexão e buffers de recepção em um único objeto do slab: tamanho fixo
+// por conexão, sem malloc no accept
+typedef struct {
+    conexao_t conexao;
+    char anel[PROTO_RING_CAPACIDADE];
+    char quadro[PROTO_MAX_PAYLOAD];
+} conexao_bloco_t;
+
+static slab_t *slab_conexoes = NULL;
+
+void conexao_configurar_saida(const config_saida_t *cfg) {
+    config_saida = *cfg;
+}
+
+int conexao_iniciar(void) {
+    slab_conexoes = slab_criar("conexao", sizeof(conexao_bloco_t), 1);
+    return slab_conexoes != NULL ? 0 : -1;
+}
+
+/**
+ * Cria a conexão com o buffer de recepção dentro do mesmo objeto do slab
+ * (só o estado é zerado: os buffers não precisam)
+ * @return conexão com uma referência ou NULL em erro
+ */
+conexao_t *conexao_criar(int fd, const struct sockaddr_in *addr) {
+    conexao_bloco_t *b = slab_alocar(slab_conexoes);
+    if (b == NULL) {
+        return NULL;
+    }
+    conexao_t *c = &b->conexao;
+    memset(c, 0, sizeof(*c));
+    proto_ring_usar(&c->ring, sizeof(b->anel), b->anel, b->quadro);
+
+    c->id = atomic_fetch_add(&proximo_id, 1);
+    c->fd = fd;
+    c->epfd = -1;
+    if (addr == NULL || addr->sin_family != AF_INET) {
+        // Socket Unix: sem endereço, o id identifica o cliente nas mensagens
+        c->local = 1;
+        strcpy(c->ip, "unix");
+        c->porta = (int)c->id;
+        local_aceita();
+    } else {
+        inet_ntop(AF_INET, &addr->sin_addr, c->ip, INET_ADDRSTRLEN);
+        c->porta = ntohs(addr->sin_port);
+    }
+    atomic_init(&c->refs, 1);
+    atomic_init(&c->encerrada, 0);
+    pthread_mutex_init(&c->saida.mutex, NULL);
+
+    // Com coalescência o próprio servidor junta as mensagens; o atraso do
+    // Nagle só somaria latência à janela
+    if (config_saida.coalescer_us > 0 && !c->local) {
+        int opt = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    }
+    return c;
+}
+
+void conexao_ref(conexao_t *c) {
+    atomic_fetch_add(&c->refs, 1);
+}
+
+/**
+ * Libera a referência; a última fecha o socket e libera a memória.
+ * O fd só é fechado aqui para que nenhuma thread com referência escreva
+ * em um descritor reutilizado por outra conexão.
+ */
+void conexao_unref(conexao_t *c) {
+    if (atomic_fetch_sub(&c->refs, 1) != 1) {
+        return;
+    }
+
+    fila_saida_t *f = &c->saida;
+    for (size_t i = 0; i < f->quantidade; i++) {
+        quadro_unref(f->itens[(f->inicio + i) & (f->capacidade - 1)]);
+    }
+    free(f->itens);
+    memoria_devolver(MEMORIA_FILAS, f->bytes);
+    memoria_devolver(MEMORIA_CONEXOES, c->memoria);
+    pthread_mutex_destroy(&c->saida.mutex);
+    local_liberar(c);
+    close(c->fd);
+    if (c->epfd_proprio && c->epfd >= 0) {
+        close(c->epfd);
+    }
+    // conexao é o primeiro membro do bloco
+    slab_liberar(slab_conexoes, c);
+}
+
+int conexao_registrar(conexao_t *c, laco_t *laco) {
+    struct epoll_event ev;
+    ev.events = EVENTOS_BASE;
+    ev.data.ptr = c;
+
+    c->epfd = laco->epfd;
+    c->laco_id = laco->id;
+    if (laco->epfd < 0) {
+        return 0;  // laço sem epoll (io_uring): o backend faz a própria espera
+    }
+    return epoll_ctl(c->epfd, EPOLL_CTL_ADD, c->fd, &ev);
+}
+
+void conexao_definir_laco(conexao_t *c, const laco_t *laco) {
+    pthread_mutex_lock(&c->saida.mutex);
+    c->laco_id = laco->id;
+    pthread_mutex_unlock(&c->saida.mutex);
+}
+
+/**
+ * Liga/desliga EPOLLOUT no epoll do dono (chamar com a fila travada)
+ */
+static void armar_escrita(conexao_t *c, int armar) {
+    struct epoll_event ev;
+    ev.events = EVENTOS_BASE | (armar ? EPOLLOUT : 0);
+    ev.data.ptr = c;
+    if (epoll_ctl(c->epfd, EPOLL_CTL_MOD, c->fd, &ev) == 0) {
+        c->saida.escrita_armada = armar;
+    }
+}
+
+static uint64_t agora_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static long ms_desde(const struct timespec *inicio) {
+    struct timespec agora;
+    clock_gettime(CLOCK_MONOTONIC, &agora);
+    return (agora.tv_sec - inicio->tv_sec) * 1000L + (agora.tv_nsec - inicio->tv_nsec) / 1000000L;
+}
+
+/**
+ * Dobra o anel da fila mantendo a ordem (chamar com a fila travada)
+ */
+static int fila_crescer(fila_saida_t *f) {
+    size_t nova = f->capacidade ? f->capacidade * 2 : SAIDA_CAPACIDADE_INICIAL;
+    quadro_t **itens = malloc(nova * sizeof(quadro_t *));
+    if (itens == NULL) {
+        return -1;
+    }
+    for (size_t i = 0; i < f->quantidade; i++) {
+        itens[i] = f->itens[(f->inicio + i) & (f->capacidade - 1)];
+    }
+    free(f->itens);
+    f->itens = itens;
+    f->capacidade = nova;
+    f->inicio = 0;
+    return 0;
+}
+
+/**
+ * Agenda o envio de uma fila que deixou de estar vazia (chamar com a fila
+ * travada)
+ */
+static void agendar_envio(conexao_t *c) {
+    if (config_saida.coalescer_us > 0) {
+        c->saida.desde_ns = agora_ns();
+    }
+    if (c->saida.escrita_armada || c->pendente || c->saida.transferida) {
+        return;
+    }
+    if (laco_atual != NULL && laco_atual->id == c->laco_id) {
+        c->pendente = 1;
+        conexao_ref(c);
+        c->prox_pendente = laco_atual->pendentes;
+        laco_atual->pendentes = c;
+    } else {
+        armar_escrita(c, 1);
+    }
+}
+
+/**
+ * A fila passou do limite de coalescência: outra thread acorda o dono
+ * (rearmar o EPOLLOUT gera um novo evento) para não esperar o prazo
+ * (chamar com a fila travada)
+ */
+static void antecipar_envio(conexao_t *c, size_t antes) {
+    size_t limite = config_saida.coalescer_bytes;
+    if (config_saida.coalescer_us == 0 || antes >= limite || c->saida.bytes < limite ||
+        c->saida.transferida) {
+        return;
+    }
+    if (c->epfd >= 0 && (laco_atual == NULL || laco_atual->id != c->laco_id)) {
+        armar_escrita(c, 1);
+    }
+}
+
+/**
+ * Enfileira uma referência ao quadro. O envio é feito pelo laço dono:
+ * - se a thread atual é o dono, a conexão entra na lista de pendentes e é
+ *   descarregada ao fim da iteração (várias mensagens, um único flush);
+ * - caso contrário, EPOLLOUT é armado no epoll do dono.
+ * Acima da marca alta a mensagem é descartada; se o cliente permanece lento
+ * por mais de despejo_ms ele é desconectado.
+ */
+int conexao_enfileirar(conexao_t *c, quadro_t *q) {
+    if (atomic_load(&c->encerrada)) {
+        return -1;
+    }
+
+    fila_saida_t *f = &c->saida;
+    pthread_mutex_lock(&f->mutex);
+
+    if (f->bytes + q->tamanho > config_saida.marca_alta) {
+        if (!f->lenta) {
+            f->lenta = 1;
+            clock_gettime(CLOCK_MONOTONIC, &f->lenta_desde);
+        }
+        int despejar = ms_desde(&f->lenta_desde) >= config_saida.despejo_ms;
+        size_t pendentes = f->bytes;
+        pthread_mutex_unlock(&f->mutex);
+
+        atomic_fetch_add(&total_descartadas, 1);
+        if (despejar && atomic_exchange(&c->encerrada, 1) == 0) {
+            atomic_fetch_add(&total_despejadas, 1);
+            shutdown(c->fd, SHUT_RDWR);
+
+            uint64_t bytes = pendentes;
+            if (log_server_event(EVENTO_DESPEJO, c->id, &bytes, sizeof(bytes)) != 0) {
+                char evict_msg[150];
+                sprintf(evict_msg, "Cliente lento %s:%d despejado (%zu bytes pendentes)",
+                        c->ip, c->porta, pendentes);
+                tsqueue_push(&msg_queue, evict_msg);
+            }
+        }
+        return -1;
+    }
+
+    // Orçamento global: sem memória a mensagem é descartada como acima da
+    // marca alta, mas sem contar para o despejo (o cliente não é o culpado)
+    if (memoria_reservar(MEMORIA_FILAS, q->tamanho) != 0) {
+        pthread_mutex_unlock(&f->mutex);
+        atomic_fetch_add(&total_descartadas, 1);
+        return -1;
+    }
+    if (f->quantidade == f->capacidade && fila_crescer(f) != 0) {
+        pthread_mutex_unlock(&f->mutex);
+        memoria_devolver(MEMORIA_FILAS, q->tamanho);
+        return -1;
+    }
+
+    int estava_vazia = (f->quantidade == 0);
+    size_t antes = f->bytes;
+    f->itens[(f->inicio + f->quantidade) & (f->capacidade - 1)] = quadro_ref(q);
+    f->quantidade++;
+    f->bytes += q->tamanho;
+
+    if (estava_vazia) {
+        agendar_envio(c);
+    } else {
+        antecipar_envio(c, antes);
+    }
+    pthread_mutex_unlock(&f->mutex);
+    return 0;
+}
+
+size_t conexao_enfileirar_lote(conexao_t *c, quadro_t *const *quadros, size_t n) {
+    if (n == 0 || atomic_load(&c->encerrada)) {
+        return 0;
+    }
+
+    fila_saida_t *f = &c->saida;
+    pthread_mutex_lock(&f->mutex);
+    int estava_vazia = (f->quantidade == 0);
+    size_t antes = f->bytes;
+    size_t i;
+    for (i = 0; i < n; i++) {
+        quadro_t *q = quadros[i];
+        if (f->bytes + q->tamanho > config_saida.marca_alta ||
+            (f->quantidade == f->capacidade && fila_crescer(f) != 0) ||
+            memoria_reservar(MEMORIA_FILAS, q->tamanho) != 0) {
+            break;
+        }
+        f->itens[(f->inicio + f->quantidade) & (f->capacidade - 1)] = quadro_ref(q);
+        f->quantidade++;
+        f->bytes += q->tamanho;
+    }
+    if (estava_vazia && i > 0) {
+        agendar_envio(c);
+    } else if (i > 0) {
+        antecipar_envio(c, antes);
+    }
+    pthread_mutex_unlock(&f->mutex);
+    return i;
+}
+
+int conexao_enviar(conexao_t *c, const char *payload, size_t tamanho) {
+    quadro_t *q = quadro_criar(payload, tamanho);
+    if (q == NULL) {
+        return -1;
+    }
+    int resultado = conexao_enfileirar(c, q);
+    quadro_unref(q);
+    return resultado;
+}
+
+/**
+ * Monta o iovec com até max quadros do início da fila, pulando a parte já
+ * enviada do primeiro (chamar com a fila travada)
+ * @return número de entradas preenchidas
+ */
+static size_t fila_montar_iov(fila_saida_t *f, struct iovec *iov, size_t max, size_t *total) {
+    size_t n = f->quantidade < max ? f->quantidade : max;
+    *total = 0;
+    for (size_t i = 0; i < n; i++) {
+        quadro_t *q = f->itens[(f->inicio + i) & (f->capacidade - 1)];
+        size_t pulo = (i == 0) ? f->enviados : 0;
+        iov[i].iov_base = q->dados + pulo;
+        iov[i].iov_len = q->tamanho - pulo;
+        *total += iov[i].iov_len;
+    }
+    return n;
+}
+
+/**
+ * Consome os quadros completos enviados e guarda o deslocamento do parcial
+ * (chamar com a fila travada)
+ */
+static void fila_consumir(fila_saida_t *f, size_t enviado) {
+    metricas_somar(METRICA_BYTES_ENVIADOS, enviado);
+    memoria_devolver(MEMORIA_FILAS, enviado);
+    f->bytes -= enviado;
+    size_t restante = enviado + f->enviados;
+    while (f->quantidade > 0) {
+        quadro_t *q = f->itens[f->inicio];
+        if (restante < q->tamanho) {
+            break;
+        }
+        restante -= q->tamanho;
+        quadro_unref(q);
+        f->inicio = (f->inicio + 1) & (f->capacidade - 1);
+        f->quantidade--;
+    }
+    f->enviados = restante;
+
+    if (f->lenta && f->bytes <= config_saida.marca_baixa) {
+        f->lenta = 0;
+    }
+}
+
+/**
+ * Põe a conexão na lista de pendentes do laço, descarregada no fim da iteração
+ */
+void conexao_escrita_pronta(conexao_t *c) {
+    pthread_mutex_lock(&c->saida.mutex);
+    if (!c->pendente && laco_atual != NULL && !c->saida.transferida) {
+        c->pendente = 1;
+        conexao_ref(c);
+        c->prox_pendente = laco_atual->pendentes;
+        laco_atual->pendentes = c;
+    }
+    pthread_mutex_unlock(&c->saida.mutex);
+}
+
+/**
+ * Envia o máximo possível da fila sem bloquear e ajusta o EPOLLOUT.
+ * Até SAIDA_MAX_IOV quadros saem em uma única chamada (sendmsg com iovec);
+ * um envio parcial indica socket cheio e encerra o ciclo.
+ */
+int conexao_descarregar(conexao_t *c) {
+    fila_saida_t *f = &c->saida;
+    int resultado = 0;
+
+    pthread_mutex_lock(&f->mutex);
+    c->pendente = 0;
+
+    while (f->quantidade > 0 && !f->transferida) {
+        struct iovec iov[SAIDA_MAX_IOV];
+        size_t total;
+        size_t n = fila_montar_iov(f, iov, SAIDA_MAX_IOV, &total);
+
+        ssize_t enviado;
+        RASTRO_INICIO(envio);
+        if (c->shm != NULL) {
+            enviado = local_shm_enviar(c, iov, n);
+        } else {
+            struct msghdr msg = {0};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = n;
+            enviado = sendmsg(c->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+        }
+        RASTRO_FIM(envio, "send", enviado);
+        if (enviado < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                resultado = -1;
+            }
+            break;
+        }
+
+        fila_consumir(f, (size_t)enviado);
+        if ((size_t)enviado < total) {
+            break;
+        }
+    }
+
+    if (c->shm != NULL) {
+        local_shm_notificar(c);
+    }
+
+    // Sobrou saída: espera o socket ficar gravável; fila vazia: desarma. No
+    // canal em memória compartilhada o espaço livre é avisado pelo eventfd
+    if (resultado == 0 && c->epfd >= 0 && !f->transferida) {
+        int armar = f->quantidade > 0 && c->shm == NULL;
+        if (armar != f->escrita_armada) {
+            armar_escrita(c, armar);
+        }
+    }
+    pthread_mutex_unlock(&f->mutex);
+    return resultado;
+}
+
+int conexao_ativar_shm(conexao_t *c, struct canal_local *shm, const struct msghdr *aviso) {
+    fila_saida_t *f = &c->saida;
+    size_t tamanho = 0;
+    for (size_t i = 0; i < (size_t)aviso->msg_iovlen; i++) {
+        tamanho += aviso->msg_iov[i].iov_len;
+    }
+
+    pthread_mutex_lock(&f->mutex);
+    if (f->enviados != 0 || f->transferida) {
+        pthread_mutex_unlock(&f->mutex);
+        errno = EBUSY;
+        return -1;
+    }
+    ssize_t enviado = sendmsg(c->fd, aviso, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (enviado == (ssize_t)tamanho) {
+        c->shm = shm;
+    }
+    pthread_mutex_unlock(&f->mutex);
+
+    if (enviado == (ssize_t)tamanho) {
+        return 0;
+    }
+    errno = (enviado < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) ? EBUSY : EPIPE;
+    return -1;
+}
+
+/**
+ * Envio assíncrono (io_uring): monta o iovec do próximo lote da fila sem
+ * consumi-lo; os quadros continuam referenciados até a confirmação
+ * @return número de entradas (0 = fila vazia)
+ */
+size_t conexao_preparar_envio(conexao_t *c, struct iovec *iov, size_t max) {
+    fila_saida_t *f = &c->saida;
+    size_t total;
+
+    pthread_mutex_lock(&f->mutex);
+    c->pendente = 0;
+    size_t n = f->transferida ? 0 : fila_montar_iov(f, iov, max, &total);
+    pthread_mutex_unlock(&f->mutex);
+    return n;
+}
+
+void conexao_confirmar_envio(conexao_t *c, size_t enviado) {
+    pthread_mutex_lock(&c->saida.mutex);
+    fila_consumir(&c->saida, enviado);
+    pthread_mutex_unlock(&c->saida.mutex);
+}
+
+void conexao_encerrar(conexao_t *c) {
+    atomic_store(&c->encerrada, 1);
+    shutdown(c->fd, SHUT_RDWR);
+}
+
+void conexao_transferir(conexao_t *c) {
+    pthread_mutex_lock(&c->saida.mutex);
+    c->saida.transferida = 1;
+    pthread_mutex_unlock(&c->saida.mutex);
+}
+
+/**
+ * Copia a saída pendente em ordem, pulando o que já foi enviado do primeiro
+ * quadro, e libera os quadros (não conta como enviado nas métricas)
+ */
+size_t conexao_extrair_saida(conexao_t *c, char **dados) {
+    fila_saida_t *f = &c->saida;
+    size_t total = 0;
+
+    pthread_mutex_lock(&f->mutex);
+    *dados = f->bytes > 0 ? malloc(f->bytes) : NULL;
+    for (size_t i = 0; i < f->quantidade; i++) {
+        quadro_t *q = f->itens[(f->inicio + i) & (f->capacidade - 1)];
+        size_t pulo = (i == 0) ? f->enviados : 0;
+        if (*dados != NULL) {
+            memcpy(*dados + total, q->dados + pulo, q->tamanho - pulo);
+            total += q->tamanho - pulo;
+        }
+        quadro_unref(q);
+    }
+    f->inicio = 0;
+    f->quantidade = 0;
+    f->enviados = 0;
+    memoria_devolver(MEMORIA_FILAS, f->bytes);
+    f->bytes = 0;
+    f->lenta = 0;
+    pthread_mutex_unlock(&f->mutex);
+    return total;
+}
+
+void laco_iniciar(laco_t *laco, int epfd) {
+    static atomic_uint_fast64_t proximo_laco = 1;
+    laco->id = atomic_fetch_add(&proximo_laco, 1);
+    laco->epfd = epfd;
+    laco->pendentes = NULL;
+    laco->adiados = NULL;
+    laco->prazo_ns = 0;
+    laco->suspensas = NULL;
+    laco->retomada_ns = 0;
+    laco->descarregar = NULL;
+}
+
+void laco_definir_atual(laco_t *laco) {
+    laco_atual = laco;
+}
+
+/**
+ * Decide se a saída da conexão espera mais: fila abaixo do limite e janela
+ * do quadro mais antigo ainda aberta. @return prazo em ns ou 0 para enviar
+ */
+static uint64_t prazo_coalescencia(conexao_t *c, uint64_t agora) {
+    fila_saida_t *f = &c->saida;
+    uint64_t prazo = 0;
+
+    pthread_mutex_lock(&f->mutex);
+    if (f->quantidade > 0 && f->enviados == 0 && f->bytes < config_saida.coalescer_bytes) {
+        prazo = f->desde_ns + (uint64_t)config_saida.coalescer_us * 1000;
+        if (prazo <= agora) {
+            prazo = 0;
+        }
+    }
+    pthread_mutex_unlock(&f->mutex);
+    return prazo;
+}
+
+/**
+ * Descarrega pendentes e adiados; com coalescer, quem ainda está dentro da
+ * janela volta para os adiados
+ */
+static void descarregar_lista(laco_t *laco, int coalescer) {
+    // Os adiados voltam a ser avaliados junto com os novos pendentes
+    while (laco->adiados) {
+        conexao_t *c = laco->adiados;
+        laco->adiados = c->prox_pendente;
+        c->prox_pendente = laco->pendentes;
+        laco->pendentes = c;
+    }
+    laco->prazo_ns = 0;
+    uint64_t agora = coalescer ? agora_ns() : 0;
+
+    while (laco->pendentes) {
+        conexao_t *c = laco->pendentes;
+        laco->pendentes = c->prox_pendente;
+        uint64_t prazo = coalescer ? prazo_coalescencia(c, agora) : 0;
+        if (prazo != 0) {
+            c->prox_pendente = laco->adiados;
+            laco->adiados = c;
+            if (laco->prazo_ns == 0 || prazo < laco->prazo_ns) {
+                laco->prazo_ns = prazo;
+            }
+            continue;
+        }
+        c->prox_pendente = NULL;
+        int resultado = laco->descarregar ? laco->descarregar(laco, c) : conexao_descarregar(c);
+        if (resultado < 0) {
+            mark_socket_for_removal(c);
+        }
+        conexao_unref(c);
+    }
+}
+
+void laco_descarregar(laco_t *laco) {
+    descarregar_lista(laco, config_saida.coalescer_us > 0 && !shutdown_requested);
+}
+
+void laco_finalizar(laco_t *laco) {
+    descarregar_lista(laco, 0);
+    for (conexao_t *c; (c = laco_retomar(laco, 1)) != NULL;) {
+        conexao_unref(c);
+    }
+}
+
+void conexao_suspender(conexao_t *c, uint64_t espera_ns) {
+    if (laco_atual == NULL) {
+        return;
+    }
+    uint64_t ate = agora_ns() + espera_ns;
+    if (c->retomar_ns == 0) {
+        conexao_ref(c);
+        c->prox_suspensa = laco_atual->suspensas;
+        laco_atual->suspensas = c;
+    }
+    c->retomar_ns = ate;
+    if (laco_atual->retomada_ns == 0 || ate < laco_atual->retomada_ns) {
+        laco_atual->retomada_ns = ate;
+    }
+}
+
+/**
+ * Percorre as suspensas (poucas: só as que passaram do limite); quando
+ * nenhuma venceu, recalcula a retomada mais próxima
+ */
+conexao_t *laco_retomar(laco_t *laco, int todas) {
+    if (laco->suspensas == NULL) {
+        return NULL;
+    }
+    uint64_t agora = todas ? 0 : agora_ns();
+    uint64_t proxima = 0;
+    for (conexao_t **p = &laco->suspensas; *p; p = &(*p)->prox_suspensa) {
+        conexao_t *c = *p;
+        if (todas || c->retomar_ns <= agora) {
+            *p = c->prox_suspensa;
+            c->prox_suspensa = NULL;
+            c->retomar_ns = 0;
+            return c;
+        }
+        if (proxima == 0 || c->retomar_ns < proxima) {
+            proxima = c->retomar_ns;
+        }
+    }
+    laco->retomada_ns = proxima;
+    return NULL;
+}
+
+uint64_t laco_proximo_prazo(const laco_t *laco) {
+    uint64_t prazo = laco->adiados ? laco->prazo_ns : 0;
+    if (laco->suspensas && (prazo == 0 || laco->retomada_ns < prazo)) {
+        prazo = laco->retomada_ns;
+    }
+    return prazo;
+}
+
+int laco_espera_ms(const laco_t *laco, int padrao) {
+    uint64_t prazo = laco_proximo_prazo(laco);
+    if (prazo == 0) {
+        return padrao;
+    }
+    uint64_t agora = agora_ns();
+    if (prazo <= agora) {
+        return 0;
+    }
+    uint64_t ms = (prazo - agora + 999999) / 1000000;
+    return ms < (uint64_t)padrao ? (int)ms : padrao;
+}
+
+void conexao_estatisticas(uint64_t *descartadas, uint64_t *despejadas) {
+    *descartadas = atomic_load(&total_descartadas);
+    *despejadas = atomic_load(&total_despejadas);
+}
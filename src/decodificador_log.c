@@ -0,0 +1,217 @@
+#define _GNU_SOURCE
+#include "../include/libtslog.h"
+#include "../include/eventos.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+// Filtros da linha de comando (0 = sem filtro)
+typedef struct {
+    uint64_t desde_ns;
+    uint64_t ate_ns;
+    uint64_t cliente_id;
+    unsigned int tipo;
+} filtro_t;
+
+/**
+ * Converte "AAAA-MM-DD HH:MM:SS" (hora local) ou segundos desde a época
+ * @return 0 com o instante em nanossegundos em *ns, -1 se inválido
+ */
+static int parse_instante(const char *texto, uint64_t *ns) {
+    struct tm t;
+    memset(&t, 0, sizeof(t));
+    const char *fim = strptime(texto, "%Y-%m-%d %H:%M:%S", &t);
+    if (fim != NULL && *fim == '\0') {
+        t.tm_isdst = -1;
+        time_t segundos = mktime(&t);
+        if (segundos == (time_t)-1) {
+            return -1;
+        }
+        *ns = (uint64_t)segundos * 1000000000ULL;
+        return 0;
+    }
+
+    char *resto;
+    unsigned long long segundos = strtoull(texto, &resto, 10);
+    if (resto == texto || *resto != '\0') {
+        return -1;
+    }
+    *ns = segundos * 1000000000ULL;
+    return 0;
+}
+
+/**
+ * Aceita o nome do evento (CONECTADO, MENSAGEM, ...) ou o número
+ */
+static unsigned int parse_tipo(const char *texto) {
+    for (unsigned int i = 1; i < EVENTO_QUANTIDADE; i++) {
+        if (strcasecmp(texto, evento_nome(i)) == 0) {
+            return i;
+        }
+    }
+    return (unsigned int)strtoul(texto, NULL, 10);
+}
+
+static int aceitar(const filtro_t *f, const log_registro_t *reg) {
+    if (f->desde_ns && reg->timestamp_ns < f->desde_ns) return 0;
+    if (f->ate_ns && reg->timestamp_ns > f->ate_ns) return 0;
+    if (f->cliente_id && reg->cliente_id != f->cliente_id) return 0;
+    if (f->tipo && reg->tipo != f->tipo) return 0;
+    return 1;
+}
+
+/**
+ * Imprime um registro no mesmo estilo de timestamp do log texto
+ */
+static void imprimir(const log_registro_t *reg, const unsigned char *payload) {
+    time_t segundos = (time_t)(reg->timestamp_ns / 1000000000ULL);
+    unsigned int ms = (unsigned int)(reg->timestamp_ns % 1000000000ULL / 1000000ULL);
+    struct tm t;
+    char timestamp[20];
+    localtime_r(&segundos, &t);
+    strftime(timestamp, sizeof(timestamp), "%d-%m-%Y %H:%M:%S", &t);
+
+    const char *nome = evento_nome(reg->tipo);
+    if (nome != NULL) {
+        printf("[%s.%03u] %-12s cliente=%llu", timestamp, ms, nome,
+               (unsigned long long)reg->cliente_id);
+    } else {
+        printf("[%s.%03u] TIPO_%-7u cliente=%llu", timestamp, ms, reg->tipo,
+               (unsigned long long)reg->cliente_id);
+    }
+
+    switch (reg->tipo) {
+    case EVENTO_CONECTADO:
+    case EVENTO_DESCONECTADO:
+        if (reg->tamanho >= sizeof(evento_endereco_t)) {
+            evento_endereco_t end;
+            memcpy(&end, payload, sizeof(end));
+            end.ip[sizeof(end.ip) - 1] = '\0';
+            printf(" %s:%u", end.ip, end.porta);
+        }
+        break;
+    case EVENTO_MENSAGEM:
+    case EVENTO_BROADCAST:
+    case EVENTO_SALA:
+        printf(" %.*s", (int)reg->tamanho, (const char *)payload);
+        break;
+    case EVENTO_DESPEJO:
+        if (reg->tamanho >= sizeof(uint64_t)) {
+            uint64_t pendentes;
+            memcpy(&pendentes, payload, sizeof(pendentes));
+            printf(" pendentes=%llu bytes", (unsigned long long)pendentes);
+        }
+        break;
+    default:
+        for (uint32_t i = 0; i < reg->tamanho; i++) {
+            printf("%s%02x", i ? "" : " ", payload[i]);
+        }
+        break;
+    }
+    putchar('\n');
+}
+
+static void uso(const char *prog) {
+    fprintf(stderr, "Uso: %s [--desde INSTANTE] [--ate INSTANTE] [--cliente ID] [--tipo EVENTO] ARQUIVO\n"
+                    "  INSTANTE: \"AAAA-MM-DD HH:MM:SS\" (hora local) ou segundos desde a época\n"
+                    "  EVENTO:   CONECTADO, DESCONECTADO, MENSAGEM, BROADCAST, DESPEJO, REJEITADO, SALA\n",
+            prog);
+}
+
+int main(int argc, char *argv[]) {
+    static const struct option opcoes[] = {
+        {"desde",   required_argument, NULL, 'd'},
+        {"ate",     required_argument, NULL, 'a'},
+        {"cliente", required_argument, NULL, 'c'},
+        {"tipo",    required_argument, NULL, 't'},
+        {"help",    no_argument,       NULL, 'h'},
+        {NULL,      0,                 NULL, 0}
+    };
+    filtro_t filtro = {0, 0, 0, 0};
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "d:a:c:t:h", opcoes, NULL)) != -1) {
+        switch (opt) {
+        case 'd':
+            if (parse_instante(optarg, &filtro.desde_ns) != 0) {
+                fprintf(stderr, "Instante inválido: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'a':
+            if (parse_instante(optarg, &filtro.ate_ns) != 0) {
+                fprintf(stderr, "Instante inválido: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'c':
+            filtro.cliente_id = strtoull(optarg, NULL, 10);
+            break;
+        case 't':
+            filtro.tipo = parse_tipo(optarg);
+            if (filtro.tipo == 0) {
+                fprintf(stderr, "Evento inválido: %s\n", optarg);
+                return 1;
+            }
+            break;
+        default:
+            uso(argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc - 1) {
+        uso(argv[0]);
+        return 1;
+    }
+
+    FILE *f = fopen(argv[optind], "rb");
+    if (f == NULL) {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    log_binario_cabecalho_t cab;
+    if (fread(&cab, sizeof(cab), 1, f) != 1 ||
+        memcmp(cab.magico, LOG_BINARIO_MAGICO, sizeof(cab.magico)) != 0) {
+        fprintf(stderr, "%s: não é um log binário\n", argv[optind]);
+        fclose(f);
+        return 1;
+    }
+    if (cab.versao != LOG_BINARIO_VERSAO || cab.tamanho_registro != sizeof(log_registro_t)) {
+        fprintf(stderr, "%s: versão %u não suportada\n", argv[optind], cab.versao);
+        fclose(f);
+        return 1;
+    }
+
+    unsigned char *payload = NULL;
+    size_t capacidade = 0;
+    log_registro_t reg;
+    unsigned long long total = 0;
+
+    while (fread(&reg, sizeof(reg), 1, f) == 1) {
+        if (reg.tamanho > capacidade) {
+            unsigned char *novo = realloc(payload, reg.tamanho);
+            if (novo == NULL) {
+                fprintf(stderr, "Sem memória para registro de %u bytes\n", reg.tamanho);
+                break;
+            }
+            payload = novo;
+            capacidade = reg.tamanho;
+        }
+        if (reg.tamanho > 0 && fread(payload, 1, reg.tamanho, f) != reg.tamanho) {
+            fprintf(stderr, "Registro truncado no fim do arquivo\n");
+            break;
+        }
+        if (aceitar(&filtro, &reg)) {
+            imprimir(&reg, payload);
+            total++;
+        }
+    }
+
+    fprintf(stderr, "%llu registro(s)\n", total);
+    free(payload);
+    fclose(f);
+    return 0;
+}
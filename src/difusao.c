@@ -0,0 +1,201 @@
+#include "../include/difusao.h"
+#include "../include/servidor.h"
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+// Broadcast dividido em andamento (na pilha do remetente)
+typedef struct trabalho {
+    struct trabalho *prox;
+    conexao_t *const *membros;
+    size_t n;
+    quadro_t *quadro;
+    const conexao_t *excluir;
+    int fatias;
+    int proxima;                // próxima fatia a pegar (protegida pelo mutex)
+    atomic_int restantes;       // fatias ainda não concluídas
+    atomic_int entregues;
+} trabalho_t;
+
+static config_difusao_t config = { 0, 1 };
+static pthread_t ajudantes[DIFUSAO_MAX_FATIAS];
+static atomic_int num_ajudantes = 0;  // 0 de novo no encerramento: fan-out serial
+static int ajudantes_criadas = 0;
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ha_trabalho = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t concluido = PTHREAD_COND_INITIALIZER;
+static trabalho_t *fila = NULL;     // trabalhos com fatias ainda livres
+static int encerrar = 0;
+
+static atomic_uint_fast64_t total_divididos = 0;
+static atomic_uint_fast64_t total_fatias_remetente = 0;
+static atomic_uint_fast64_t total_fatias_ajudantes = 0;
+
+static int entregar_faixa(conexao_t *const *membros, size_t inicio, size_t fim, quadro_t *q,
+                          const conexao_t *excluir) {
+    int entregues = 0;
+    for (size_t i = inicio; i < fim; i++) {
+        conexao_t *m = membros[i];
+        if (m == excluir) {
+            continue;
+        }
+        if (conexao_enfileirar(m, q) == 0) {
+            entregues++;
+        }
+    }
+    return entregues;
+}
+
+/**
+ * Pega a próxima fatia do trabalho; a última a ser pega tira o trabalho da
+ * fila (chamar com o mutex travado)
+ * @return índice da fatia, -1 se todas já foram pegas
+ */
+static int pegar_fatia(trabalho_t *t) {
+    if (t->proxima == t->fatias) {
+        return -1;
+    }
+    int i = t->proxima++;
+    if (t->proxima == t->fatias) {
+        trabalho_t **p = &fila;
+        while (*p != t) {
+            p = &(*p)->prox;
+        }
+        *p = t->prox;
+    }
+    return i;
+}
+
+/**
+ * Executa a fatia i (sem o mutex). Depois de concluir a última fatia o
+ * trabalho não pode mais ser tocado: o remetente pode já ter retornado
+ * @return 1 se esta era a última fatia pendente
+ */
+static int executar_fatia(trabalho_t *t, int i) {
+    size_t inicio = t->n * (size_t)i / (size_t)t->fatias;
+    size_t fim = t->n * (size_t)(i + 1) / (size_t)t->fatias;
+    RASTRO_INICIO(rastro);
+    atomic_fetch_add(&t->entregues, entregar_faixa(t->membros, inicio, fim, t->quadro, t->excluir));
+    RASTRO_FIM(rastro, "fatia", fim - inicio);
+    return atomic_fetch_sub(&t->restantes, 1) == 1;
+}
+
+static void *ajudante_loop(void *arg) {
+    (void)arg;
+    RASTRO_NOMEAR("difusao");
+    pthread_mutex_lock(&mutex);
+    while (1) {
+        while (fila == NULL && !encerrar) {
+            pthread_cond_wait(&ha_trabalho, &mutex);
+        }
+        if (fila == NULL) {
+            break;
+        }
+        // pegar_fatia pode tirar o trabalho da fila: guardar o ponteiro antes
+        trabalho_t *t = fila;
+        int i = pegar_fatia(t);
+        pthread_mutex_unlock(&mutex);
+        atomic_fetch_add(&total_fatias_ajudantes, 1);
+        int ultima = executar_fatia(t, i);
+        pthread_mutex_lock(&mutex);
+        if (ultima) {
+            pthread_cond_broadcast(&concluido);
+        }
+    }
+    pthread_mutex_unlock(&mutex);
+    return NULL;
+}
+
+int difusao_iniciar(const config_difusao_t *cfg) {
+    config = *cfg;
+    if (config.fatias <= 0) {
+        long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        config.fatias = ncpus > 0 ? (int)ncpus : 1;
+    }
+    if (config.fatias > DIFUSAO_MAX_FATIAS) {
+        config.fatias = DIFUSAO_MAX_FATIAS;
+    }
+    if (config.limiar == 0 || config.fatias < 2) {
+        return 0;
+    }
+
+    encerrar = 0;
+    for (int i = 0; i < config.fatias - 1; i++) {
+        int err = pthread_create(&ajudantes[i], NULL, ajudante_loop, NULL);
+        if (err != 0) {
+            errno = err;
+            return -1;  // as já criadas seguem ajudando
+        }
+        atomic_fetch_add(&num_ajudantes, 1);
+        ajudantes_criadas++;
+    }
+    return 0;
+}
+
+int difusao_entregar(conexao_t *const *membros, size_t n, quadro_t *q, const conexao_t *excluir) {
+    int ajudando = atomic_load(&num_ajudantes);
+    if (ajudando == 0 || n < config.limiar) {
+        return entregar_faixa(membros, 0, n, q, excluir);
+    }
+
+    trabalho_t t;
+    t.prox = NULL;
+    t.membros = membros;
+    t.n = n;
+    t.quadro = q;
+    t.excluir = excluir;
+    t.fatias = ajudando + 1;
+    t.proxima = 0;
+    atomic_init(&t.restantes, t.fatias);
+    atomic_init(&t.entregues, 0);
+    atomic_fetch_add(&total_divididos, 1);
+
+    pthread_mutex_lock(&mutex);
+    trabalho_t **fim = &fila;
+    while (*fim != NULL) {
+        fim = &(*fim)->prox;
+    }
+    *fim = &t;
+    pthread_cond_broadcast(&ha_trabalho);
+
+    // O remetente também trabalha: o broadcast avança mesmo com as
+    // ajudantes ocupadas em outras salas
+    int proprias = 0;
+    int i;
+    while ((i = pegar_fatia(&t)) >= 0) {
+        pthread_mutex_unlock(&mutex);
+        executar_fatia(&t, i);
+        proprias++;
+        pthread_mutex_lock(&mutex);
+    }
+    while (atomic_load(&t.restantes) > 0) {
+        pthread_cond_wait(&concluido, &mutex);
+    }
+    pthread_mutex_unlock(&mutex);
+
+    atomic_fetch_add(&total_fatias_remetente, (uint_fast64_t)proprias);
+    return atomic_load(&t.entregues);
+}
+
+void difusao_estatisticas(difusao_info_t *info) {
+    info->divididos = atomic_load(&total_divididos);
+    info->fatias_remetente = atomic_load(&total_fatias_remetente);
+    info->fatias_ajudantes = atomic_load(&total_fatias_ajudantes);
+    info->ajudantes = ajudantes_criadas;
+}
+
+void difusao_encerrar(void) {
+    // Um broadcast já publicado termina mesmo sem ajudantes: o remetente
+    // pega as fatias que sobrarem
+    int criadas = atomic_exchange(&num_ajudantes, 0);
+    pthread_mutex_lock(&mutex);
+    encerrar = 1;
+    pthread_cond_broadcast(&ha_trabalho);
+    pthread_mutex_unlock(&mutex);
+    for (int i = 0; i < criadas; i++) {
+        pthread_join(ajudantes[i], NULL);
+    }
+}
@@ -0,0 +1,706 @@
+#define _GNU_SOURCE
+#include "../include/federacao.h"
+#include "../include/servidor.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <endian.h>
+#include <netdb.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define FEDERACAO_EVENTOS 64
+#define FEDERACAO_VERSAO 1
+
+// Payload dos quadros trocados entre nós (mesmo enquadramento dos clientes)
+enum {
+    QUADRO_APRESENTACAO = 'H',   // tipo, versão, id do nó (primeiro quadro de cada lado)
+    QUADRO_MENSAGEM = 'M'        // tipo, saltos, tamanho da sala, origem, sequência, sala, texto
+};
+#define APRESENTACAO_BYTES (1 + 1 + 8)
+#define MENSAGEM_CABECALHO (1 + 1 + 1 + 8 + 8)
+
+// Identificadores em data.u64 do epoll além dos índices dos enlaces
+#define ID_ESCUTA FEDERACAO_MAX_ENLACES
+#define ID_EVENTFD (FEDERACAO_MAX_ENLACES + 1)
+
+typedef struct {
+    pthread_mutex_t mutex;       // protege fd/pronto para quem publica e o lote
+    int fd;                      // -1 = desconectado
+    int pronto;                  // conectado: aceita mensagens no lote
+    int par;                     // par configurado (reconecta quando cai)
+    struct sockaddr_in endereco;
+    char nome[64];               // HOST:PORTA do par ou endereço de quem conectou
+    int conectando;              // connect não bloqueante em andamento
+    int escrita_armada;          // EPOLLOUT registrado
+    uint64_t no_id;              // nó do outro lado (0 = apresentação pendente)
+    uint64_t reconectar_ns;      // próxima tentativa (par desconectado)
+    int espera_ms;
+    proto_ring_t ring;
+    char *lote;                  // quadros codificados ainda não enviados
+    size_t lote_cap;
+    size_t lote_inicio;          // bytes do lote já enviados
+    size_t lote_fim;
+} enlace_t;
+
+static enlace_t enlaces[FEDERACAO_MAX_ENLACES];
+static int num_pares = 0;
+static int escuta_fd = -1;
+static int epfd = -1;
+static int evfd = -1;
+static pthread_t federacao_tid;
+static int ativa = 0;
+static uint64_t no_id;
+static atomic_uint_fast64_t sequencia = 0;
+static atomic_uint_fast64_t enviadas = 0;
+static atomic_uint_fast64_t recebidas = 0;
+static atomic_uint_fast64_t duplicadas = 0;
+static atomic_uint_fast64_t descartadas = 0;
+static atomic_int conectados = 0;
+
+// Mensagens já vistas, em tabela de mapeamento direto (só a thread da federação)
+static struct {
+    uint64_t origem;
+    uint64_t seq;
+} vistos[FEDERACAO_VISTOS];
+
+static uint64_t agora_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Finalizador do splitmix64
+static uint64_t misturar(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static void escrever_u64(char *p, uint64_t v) {
+    v = htobe64(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+static uint64_t ler_u64(const char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return be64toh(v);
+}
+
+/**
+ * Marca (origem, seq) como vista. Uma entrada antiga pode ser sobrescrita:
+ * a duplicata que escapar ainda é limitada pelos saltos.
+ * @return 1 se a mensagem já tinha sido vista
+ */
+static int ja_visto(uint64_t origem, uint64_t seq) {
+    size_t i = misturar(origem ^ (seq * 0x9e3779b97f4a7c15ULL)) & (FEDERACAO_VISTOS - 1);
+    if (vistos[i].origem == origem && vistos[i].seq == seq) {
+        return 1;
+    }
+    vistos[i].origem = origem;
+    vistos[i].seq = seq;
+    return 0;
+}
+
+/**
+ * Codifica um quadro de mensagem completo (cabeçalho do protocolo incluso)
+ * em buf, com PROTO_CABECALHO + PROTO_MAX_PAYLOAD bytes
+ * @return tamanho do quadro
+ */
+static size_t codificar_mensagem(char *buf, uint8_t saltos, const char *sala, uint64_t origem,
+                                 uint64_t seq, const char *msg, size_t tamanho) {
+    size_t sala_len = strlen(sala);
+    size_t max = PROTO_MAX_PAYLOAD - MENSAGEM_CABECALHO - sala_len;
+    if (tamanho > max) {
+        tamanho = max;
+    }
+    char *p = buf + PROTO_CABECALHO;
+    p[0] = QUADRO_MENSAGEM;
+    p[1] = (char)saltos;
+    p[2] = (char)sala_len;
+    escrever_u64(p + 3, origem);
+    escrever_u64(p + 11, seq);
+    memcpy(p + MENSAGEM_CABECALHO, sala, sala_len);
+    memcpy(p + MENSAGEM_CABECALHO + sala_len, msg, tamanho);
+
+    size_t payload = MENSAGEM_CABECALHO + sala_len + tamanho;
+    uint32_t cabecalho = htonl((uint32_t)payload);
+    memcpy(buf, &cabecalho, PROTO_CABECALHO);
+    return PROTO_CABECALHO + payload;
+}
+
+/**
+ * Acrescenta bytes ao lote do enlace (mutex travado)
+ * @return 1 se o lote estava vazio, 0 se não, -1 se passaria de FEDERACAO_LOTE_MAX
+ */
+static int lote_anexar(enlace_t *e, const char *dados, size_t n) {
+    size_t pendentes = e->lote_fim - e->lote_inicio;
+    if (pendentes + n > FEDERACAO_LOTE_MAX) {
+        return -1;
+    }
+    if (e->lote_fim + n > e->lote_cap) {
+        // Reaproveita o início já enviado antes de crescer
+        if (pendentes > 0) {
+            memmove(e->lote, e->lote + e->lote_inicio, pendentes);
+        }
+        e->lote_inicio = 0;
+        e->lote_fim = pendentes;
+        if (pendentes + n > e->lote_cap) {
+            size_t cap = e->lote_cap ? e->lote_cap : 4096;
+            while (cap < pendentes + n) {
+                cap *= 2;
+            }
+            char *novo = realloc(e->lote, cap);
+            if (novo == NULL) {
+                return -1;
+            }
+            e->lote = novo;
+            e->lote_cap = cap;
+        }
+    }
+    memcpy(e->lote + e->lote_fim, dados, n);
+    e->lote_fim += n;
+    return pendentes == 0;
+}
+
+static void armar_escrita(enlace_t *e, int armar) {
+    if (e->escrita_armada == armar) {
+        return;
+    }
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP | (armar ? EPOLLOUT : 0) };
+    ev.data.u64 = (uint64_t)(e - enlaces);
+    epoll_ctl(epfd, EPOLL_CTL_MOD, e->fd, &ev);
+    e->escrita_armada = armar;
+}
+
+/**
+ * Derruba o enlace; um par configurado volta a ser tentado depois da espera
+ */
+static void enlace_fechar(enlace_t *e, const char *motivo) {
+    char log_msg[160];
+    snprintf(log_msg, sizeof(log_msg), "Federação: enlace com %s caiu (%s)", e->nome, motivo);
+    tsqueue_push(&msg_queue, log_msg);
+
+    pthread_mutex_lock(&e->mutex);
+    epoll_ctl(epfd, EPOLL_CTL_DEL, e->fd, NULL);
+    close(e->fd);
+    e->fd = -1;
+    e->pronto = 0;
+    e->lote_inicio = 0;
+    e->lote_fim = 0;
+    pthread_mutex_unlock(&e->mutex);
+
+    if (e->no_id != 0) {
+        atomic_fetch_sub(&conectados, 1);
+    }
+    e->no_id = 0;
+    e->conectando = 0;
+    e->escrita_armada = 0;
+    e->ring.inicio = 0;
+    e->ring.fim = 0;
+    if (e->par) {
+        e->reconectar_ns = agora_ns() + (uint64_t)e->espera_ms * 1000000ULL;
+        e->espera_ms = e->espera_ms * 2 > FEDERACAO_RECONEXAO_MAX_MS ? FEDERACAO_RECONEXAO_MAX_MS
+                                                                     : e->espera_ms * 2;
+    }
+}
+
+/**
+ * Envia o que couber do lote sem bloquear; o resto espera EPOLLOUT
+ */
+static void enlace_descarregar(enlace_t *e) {
+    int erro = 0;
+
+    pthread_mutex_lock(&e->mutex);
+    while (e->lote_inicio < e->lote_fim) {
+        ssize_t n = send(e->fd, e->lote + e->lote_inicio, e->lote_fim - e->lote_inicio,
+                         MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n > 0) {
+            e->lote_inicio += (size_t)n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        erro = !(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+        break;
+    }
+    int vazio = e->lote_inicio == e->lote_fim;
+    if (vazio) {
+        e->lote_inicio = 0;
+        e->lote_fim = 0;
+    }
+    pthread_mutex_unlock(&e->mutex);
+
+    if (erro) {
+        enlace_fechar(e, "erro de envio");
+        return;
+    }
+    armar_escrita(e, !vazio);
+}
+
+/**
+ * Associa um socket ao enlace com a apresentação deste nó no lote
+ */
+static int enlace_abrir(enlace_t *e, int fd, int conectando) {
+    if (e->ring.dados == NULL && proto_ring_init(&e->ring, PROTO_RING_CAPACIDADE) != 0) {
+        return -1;
+    }
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP | (conectando ? EPOLLOUT : 0) };
+    ev.data.u64 = (uint64_t)(e - enlaces);
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        return -1;
+    }
+    int opt = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));  // o lote já agrupa
+
+    char apresentacao[PROTO_CABECALHO + APRESENTACAO_BYTES];
+    char payload[APRESENTACAO_BYTES];
+    payload[0] = QUADRO_APRESENTACAO;
+    payload[1] = FEDERACAO_VERSAO;
+    escrever_u64(payload + 2, no_id);
+    proto_codificar(apresentacao, payload, sizeof(payload));
+
+    pthread_mutex_lock(&e->mutex);
+    e->fd = fd;
+    e->pronto = !conectando;
+    lote_anexar(e, apresentacao, sizeof(apresentacao));
+    pthread_mutex_unlock(&e->mutex);
+    e->conectando = conectando;
+    e->escrita_armada = conectando;
+    return 0;
+}
+
+/**
+ * Inicia o connect não bloqueante para um par configurado
+ */
+static void enlace_conectar(enlace_t *e) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        e->reconectar_ns = agora_ns() + (uint64_t)e->espera_ms * 1000000ULL;
+        return;
+    }
+    if ((connect(fd, (struct sockaddr *)&e->endereco, sizeof(e->endereco)) < 0 &&
+         errno != EINPROGRESS) || enlace_abrir(e, fd, 1) < 0) {
+        close(fd);
+        e->reconectar_ns = agora_ns() + (uint64_t)e->espera_ms * 1000000ULL;
+        return;
+    }
+    e->reconectar_ns = 0;
+}
+
+/**
+ * Aceita as conexões de pares em enlaces livres (depois dos configurados)
+ */
+static void aceitar_pares(void) {
+    while (1) {
+        struct sockaddr_in addr;
+        socklen_t addr_len = sizeof(addr);
+        int fd = accept4(escuta_fd, (struct sockaddr *)&addr, &addr_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        enlace_t *e = NULL;
+        for (int i = num_pares; i < FEDERACAO_MAX_ENLACES && e == NULL; i++) {
+            if (enlaces[i].fd < 0) {
+                e = &enlaces[i];
+            }
+        }
+        if (e == NULL || enlace_abrir(e, fd, 0) < 0) {
+            tsqueue_push(&msg_queue, "Federação: par recusado (sem enlaces livres)");
+            close(fd);
+            continue;
+        }
+        char ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+        snprintf(e->nome, sizeof(e->nome), "%s:%d", ip, ntohs(addr.sin_port));
+    }
+}
+
+/**
+ * Coloca o quadro no lote de cada enlace conectado, exceto excluir
+ * @return 1 se algum lote deixou de estar vazio
+ */
+static int distribuir(const char *quadro, size_t n, const enlace_t *excluir) {
+    int acordar = 0;
+    for (int i = 0; i < FEDERACAO_MAX_ENLACES; i++) {
+        enlace_t *e = &enlaces[i];
+        if (e == excluir) {
+            continue;
+        }
+        pthread_mutex_lock(&e->mutex);
+        if (e->fd >= 0 && e->pronto) {
+            int r = lote_anexar(e, quadro, n);
+            if (r < 0) {
+                atomic_fetch_add_explicit(&descartadas, 1, memory_order_relaxed);
+            } else {
+                atomic_fetch_add_explicit(&enviadas, 1, memory_order_relaxed);
+                acordar |= r;
+            }
+        }
+        pthread_mutex_unlock(&e->mutex);
+    }
+    return acordar;
+}
+
+void federacao_publicar(const char *sala, const char *msg, size_t tamanho) {
+    if (!ativa) {
+        return;
+    }
+    char quadro[PROTO_CABECALHO + PROTO_MAX_PAYLOAD];
+    uint64_t seq = atomic_fetch_add_explicit(&sequencia, 1, memory_order_relaxed);
+    size_t n = codificar_mensagem(quadro, 0, sala, no_id, seq, msg, tamanho);
+
+    // Só quem encontra um lote vazio acorda a thread: os seguintes vão no mesmo envio
+    if (distribuir(quadro, n, NULL)) {
+        uint64_t um = 1;
+        if (write(evfd, &um, sizeof(um)) < 0 && errno != EAGAIN) {
+            log_server_error("write eventfd da federação", errno);
+        }
+    }
+}
+
+/**
+ * Trata um quadro recebido de um par
+ * @return 0 se o enlace continua, -1 se deve ser derrubado
+ */
+static int processar_quadro(enlace_t *e, const char *p, size_t len) {
+    char log_msg[160];
+
+    if (e->no_id == 0) {
+        if (len != APRESENTACAO_BYTES || p[0] != QUADRO_APRESENTACAO || p[1] != FEDERACAO_VERSAO) {
+            return -1;
+        }
+        uint64_t id = ler_u64(p + 2);
+        if (id == no_id || id == 0) {
+            return -1;  // conectou em si mesmo
+        }
+        e->no_id = id;
+        e->espera_ms = FEDERACAO_RECONEXAO_MS;
+        atomic_fetch_add(&conectados, 1);
+        snprintf(log_msg, sizeof(log_msg), "Federação: enlace com %s (nó %016llx) estabelecido",
+                 e->nome, (unsigned long long)id);
+        tsqueue_push(&msg_queue, log_msg);
+        return 0;
+    }
+    if (len < MENSAGEM_CABECALHO || p[0] != QUADRO_MENSAGEM) {
+        return -1;
+    }
+    uint8_t saltos = (uint8_t)p[1];
+    size_t sala_len = (uint8_t)p[2];
+    uint64_t origem = ler_u64(p + 3);
+    uint64_t seq = ler_u64(p + 11);
+    if (len < MENSAGEM_CABECALHO + sala_len || !sala_nome_valido(p + MENSAGEM_CABECALHO, sala_len)) {
+        return -1;
+    }
+    if (origem == no_id || ja_visto(origem, seq)) {
+        atomic_fetch_add_explicit(&duplicadas, 1, memory_order_relaxed);
+        return 0;
+    }
+    atomic_fetch_add_explicit(&recebidas, 1, memory_order_relaxed);
+
+    char sala[SALA_NOME_MAX];
+    memcpy(sala, p + MENSAGEM_CABECALHO, sala_len);
+    sala[sala_len] = '\0';
+    const char *texto = p + MENSAGEM_CABECALHO + sala_len;
+    size_t texto_len = len - MENSAGEM_CABECALHO - sala_len;
+    sala_difundir(sala, texto, texto_len);
+
+    // Reencaminha aos demais enlaces (o lote sai no fim da iteração)
+    if (saltos + 1 < FEDERACAO_SALTOS_MAX) {
+        char quadro[PROTO_CABECALHO + PROTO_MAX_PAYLOAD];
+        size_t n = codificar_mensagem(quadro, (uint8_t)(saltos + 1), sala, origem, seq, texto, texto_len);
+        distribuir(quadro, n, e);
+    }
+    return 0;
+}
+
+/**
+ * Lê do par até EAGAIN, tratando cada quadro completo
+ */
+static void enlace_ler(enlace_t *e) {
+    while (1) {
+        ssize_t n = proto_ring_ler(&e->ring, e->fd);
+        if (n > 0) {
+            const char *payload;
+            size_t len;
+            int status;
+            while ((status = proto_proximo_quadro(&e->ring, &payload, &len)) == 1) {
+                if (processar_quadro(e, payload, len) < 0) {
+                    enlace_fechar(e, "quadro inválido");
+                    return;
+                }
+            }
+            if (status < 0) {
+                enlace_fechar(e, "quadro inválido");
+                return;
+            }
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        enlace_fechar(e, n == 0 ? "fechado pelo par" : "erro de leitura");
+        return;
+    }
+}
+
+static void tratar_evento(enlace_t *e, uint32_t events) {
+    if (e->conectando) {
+        int erro = 0;
+        socklen_t erro_len = sizeof(erro);
+        if (!(events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+            return;
+        }
+        if (getsockopt(e->fd, SOL_SOCKET, SO_ERROR, &erro, &erro_len) < 0 || erro != 0) {
+            enlace_fechar(e, "conexão recusada");
+            return;
+        }
+        e->conectando = 0;
+        pthread_mutex_lock(&e->mutex);
+        e->pronto = 1;
+        pthread_mutex_unlock(&e->mutex);
+        enlace_descarregar(e);
+        return;
+    }
+    if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+        enlace_ler(e);
+    }
+    if (e->fd >= 0 && (events & EPOLLOUT)) {
+        enlace_descarregar(e);
+    }
+}
+
+/**
+ * Thread da federação: aceita pares, reconecta os configurados, lê as
+ * mensagens deles e envia os lotes acumulados ao fim de cada iteração
+ */
+static void *federacao_loop(void *arg) {
+    (void)arg;
+    struct epoll_event eventos[FEDERACAO_EVENTOS];
+
+    while (!shutdown_requested) {
+        uint64_t agora = agora_ns();
+        int espera = 1000;
+        for (int i = 0; i < num_pares; i++) {
+            enlace_t *e = &enlaces[i];
+            if (e->fd >= 0) {
+                continue;
+            }
+            if (e->reconectar_ns <= agora) {
+                enlace_conectar(e);
+            }
+            if (e->fd < 0 && e->reconectar_ns > agora) {
+                uint64_t ms = (e->reconectar_ns - agora) / 1000000ULL + 1;
+                espera = ms < (uint64_t)espera ? (int)ms : espera;
+            }
+        }
+
+        int n = epoll_wait(epfd, eventos, FEDERACAO_EVENTOS, espera);
+        if (n < 0 && errno != EINTR) {
+            log_server_error("epoll_wait da federação", errno);
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            if (eventos[i].data.u64 == ID_ESCUTA) {
+                aceitar_pares();
+            } else if (eventos[i].data.u64 == ID_EVENTFD) {
+                uint64_t valor;
+                if (read(evfd, &valor, sizeof(valor)) < 0 && errno != EAGAIN) {
+                    log_server_error("read eventfd da federação", errno);
+                }
+            } else {
+                enlace_t *e = &enlaces[eventos[i].data.u64];
+                if (e->fd >= 0) {
+                    tratar_evento(e, eventos[i].events);
+                }
+            }
+        }
+
+        // Um envio por enlace com tudo que foi publicado desde o anterior
+        for (int i = 0; i < FEDERACAO_MAX_ENLACES; i++) {
+            enlace_t *e = &enlaces[i];
+            if (e->fd >= 0 && !e->conectando && !e->escrita_armada) {
+                enlace_descarregar(e);
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Resolve HOST:PORTA (IPv4) no endereço do par
+ */
+static int resolver_par(const char *par, struct sockaddr_in *endereco) {
+    char host[64];
+    const char *dois_pontos = strrchr(par, ':');
+    if (dois_pontos == NULL || dois_pontos == par || (size_t)(dois_pontos - par) >= sizeof(host)) {
+        errno = EINVAL;
+        return -1;
+    }
+    memcpy(host, par, (size_t)(dois_pontos - par));
+    host[dois_pontos - par] = '\0';
+
+    struct addrinfo dicas, *resultado;
+    memset(&dicas, 0, sizeof(dicas));
+    dicas.ai_family = AF_INET;
+    dicas.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, dois_pontos + 1, &dicas, &resultado) != 0) {
+        errno = EHOSTUNREACH;
+        return -1;
+    }
+    memcpy(endereco, resultado->ai_addr, sizeof(*endereco));
+    freeaddrinfo(resultado);
+    return 0;
+}
+
+static int criar_escuta(int porta) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons((uint16_t)porta);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 16) < 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    return fd;
+}
+
+int federacao_iniciar(const config_federacao_t *cfg) {
+    if (cfg->porta == 0 && cfg->num_pares == 0) {
+        return 0;
+    }
+    no_id = misturar(agora_ns() ^ ((uint64_t)getpid() << 32)) | 1;
+
+    for (int i = 0; i < FEDERACAO_MAX_ENLACES; i++) {
+        pthread_mutex_init(&enlaces[i].mutex, NULL);
+        enlaces[i].fd = -1;
+        enlaces[i].espera_ms = FEDERACAO_RECONEXAO_MS;
+    }
+    num_pares = cfg->num_pares;
+    for (int i = 0; i < num_pares; i++) {
+        if (resolver_par(cfg->pares[i], &enlaces[i].endereco) < 0) {
+            return -1;
+        }
+        enlaces[i].par = 1;
+        snprintf(enlaces[i].nome, sizeof(enlaces[i].nome), "%s", cfg->pares[i]);
+    }
+
+    struct epoll_event ev = { .events = EPOLLIN };
+    int err;
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epfd < 0 || evfd < 0) {
+        goto erro;
+    }
+    ev.data.u64 = ID_EVENTFD;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, evfd, &ev) < 0) {
+        goto erro;
+    }
+    if (cfg->porta != 0) {
+        escuta_fd = criar_escuta(cfg->porta);
+        if (escuta_fd < 0) {
+            goto erro;
+        }
+        ev.data.u64 = ID_ESCUTA;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, escuta_fd, &ev) < 0) {
+            goto erro;
+        }
+    }
+
+    ativa = 1;
+    err = pthread_create(&federacao_tid, NULL, federacao_loop, NULL);
+    if (err != 0) {
+        ativa = 0;
+        errno = err;
+        goto erro;
+    }
+
+    char log_msg[120];
+    snprintf(log_msg, sizeof(log_msg), "Federação: nó %016llx, porta %d, %d par(es) configurado(s)",
+             (unsigned long long)no_id, cfg->porta, num_pares);
+    tsqueue_push(&msg_queue, log_msg);
+    return 0;
+
+erro:
+    err = errno;
+    if (escuta_fd >= 0) {
+        close(escuta_fd);
+        escuta_fd = -1;
+    }
+    if (evfd >= 0) {
+        close(evfd);
+        evfd = -1;
+    }
+    if (epfd >= 0) {
+        close(epfd);
+        epfd = -1;
+    }
+    errno = err;
+    return -1;
+}
+
+void federacao_estatisticas(federacao_info_t *info) {
+    info->enviadas = atomic_load(&enviadas);
+    info->recebidas = atomic_load(&recebidas);
+    info->duplicadas = atomic_load(&duplicadas);
+    info->descartadas = atomic_load(&descartadas);
+    info->enlaces = atomic_load(&conectados);
+}
+
+void federacao_encerrar(void) {
+    if (!ativa) {
+        return;
+    }
+    // Quem ainda publica (threads por cliente terminando) encontra os enlaces fechados
+    uint64_t um = 1;
+    if (write(evfd, &um, sizeof(um)) < 0 && errno != EAGAIN) {
+        log_server_error("write eventfd da federação", errno);
+    }
+    pthread_join(federacao_tid, NULL);
+
+    for (int i = 0; i < FEDERACAO_MAX_ENLACES; i++) {
+        enlace_t *e = &enlaces[i];
+        pthread_mutex_lock(&e->mutex);
+        if (e->fd >= 0) {
+            close(e->fd);
+            e->fd = -1;
+        }
+        e->pronto = 0;
+        pthread_mutex_unlock(&e->mutex);
+    }
+    if (escuta_fd >= 0) {
+        close(escuta_fd);
+        escuta_fd = -1;
+    }
+    close(evfd);
+    close(epfd);
+    evfd = -1;
+    epfd = -1;
+    ativa = 0;
+}
@@ -1,34 +1,83 @@
+#define _GNU_SOURCE
 #include "../include/fila_threadsafe.h"
+#include "../include/rastro.h"
 #include <string.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+// Cabeçalho do registro: bit de publicado, bit de preenchimento e tamanho total
+#define REG_PRONTO 0x80000000u
+#define REG_PULO   0x40000000u
+#define REG_TAMANHO(h) ((h) & 0x3fffffffu)
+#define REG_CABECALHO 4
+#define REG_ALINHAMENTO 8
+#define REG_MAXIMO (((REG_CABECALHO + MSG_SIZE) + REG_ALINHAMENTO - 1) & ~(size_t)(REG_ALINHAMENTO - 1))
+
+static void futex_esperar(atomic_uint *palavra, unsigned int valor) {
+    syscall(SYS_futex, (unsigned int *)palavra, FUTEX_WAIT_PRIVATE, valor, NULL, NULL, 0);
+}
+
+static void futex_acordar(atomic_uint *palavra, int quantos) {
+    syscall(SYS_futex, (unsigned int *)palavra, FUTEX_WAKE_PRIVATE, quantos, NULL, NULL, 0);
+}
+
+static inline atomic_uint *cabecalho(ThreadSafeQueue *q, size_t pos) {
+    return (atomic_uint *)(q->dados + (pos & (q->capacidade - 1)));
+}
 
 /**
  * Inicializa a fila thread-safe
  * @param q Ponteiro para a fila a ser inicializada
+ * @param capacidade Bytes do anel (arredondado para potência de 2)
+ * @return 0 em sucesso, -1 sem memória
  */
-void tsqueue_init(ThreadSafeQueue *q) {
-    // Inicializa índices e tamanho
-    q->head = 0;
-    q->tail = 0;
-    q->size = 0;
-    
-    // Inicializa mutex para exclusão mútua
-    pthread_mutex_init(&q->mutex, NULL);
-    
-    // Inicializa condition variables para sincronização
-    pthread_cond_init(&q->not_empty, NULL);  // Sinaliza quando a fila não está vazia
-    pthread_cond_init(&q->not_full, NULL);   // Sinaliza quando a fila não está cheia
+int tsqueue_init(ThreadSafeQueue *q, size_t capacidade) {
+    // O anel precisa comportar ao menos duas mensagens máximas (uma pode virar preenchimento)
+    size_t cap = REG_ALINHAMENTO;
+    while (cap < capacidade || cap < 2 * REG_MAXIMO) {
+        cap *= 2;
+    }
+
+    // Cabeçalhos zerados: nenhum registro publicado
+    q->dados = aligned_alloc(CACHE_LINE, cap);
+    if (q->dados == NULL) {
+        return -1;
+    }
+    memset(q->dados, 0, cap);
+    q->capacidade = cap;
+    atomic_init(&q->tail, 0);
+    atomic_init(&q->head, 0);
+    atomic_init(&q->consumidor_dormindo, 0);
+    atomic_init(&q->espaco, 0);
+    atomic_init(&q->produtores_esperando, 0);
+    return 0;
 }
 
 /**
- * Destroi a fila thread-safe e libera recursos
+ * Destroi a fila thread-safe e libera o anel
  * @param q Ponteiro para a fila a ser destruída
  */
 void tsqueue_destroy(ThreadSafeQueue *q) {
-    // Destroi mutex e condition variables
-    pthread_mutex_destroy(&q->mutex);
-    pthread_cond_destroy(&q->not_empty);
-    pthread_cond_destroy(&q->not_full);
+    free(q->dados);
+    q->dados = NULL;
+}
+
+/**
+ * Bloqueia o produtor até o consumidor liberar bytes suficientes
+ */
+static void esperar_espaco(ThreadSafeQueue *q, size_t tail, size_t total) {
+    atomic_fetch_add(&q->produtores_esperando, 1);
+    unsigned int valor = atomic_load(&q->espaco);
+    // Reconfere depois de se anunciar: o consumidor pode ter liberado espaço
+    if (tail + total - atomic_load(&q->head) > q->capacidade) {
+        futex_esperar(&q->espaco, valor);
+    }
+    atomic_fetch_sub(&q->produtores_esperando, 1);
 }
 
 /**
@@ -37,28 +86,78 @@ void tsqueue_destroy(ThreadSafeQueue *q) {
  * @param msg Mensagem a ser inserida (string)
  */
 void tsqueue_push(ThreadSafeQueue *q, const char *msg) {
-    // Bloqueia o mutex para acesso exclusivo à fila
-    pthread_mutex_lock(&q->mutex);
-    
-    // Espera enquanto a fila estiver cheia 
-    while (q->size == QUEUE_CAPACITY) {
-        // Libera temporariamente o mutex e espera pelo sinal de não-cheia
-        pthread_cond_wait(&q->not_full, &q->mutex);
+    RASTRO_INICIO(rastro);
+    size_t len = strnlen(msg, MSG_SIZE - 1);
+    size_t tamanho = (REG_CABECALHO + len + 1 + REG_ALINHAMENTO - 1) & ~(size_t)(REG_ALINHAMENTO - 1);
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    size_t pulo;
+
+    // Reserva os bytes; um registro nunca dá a volta no fim do anel, o
+    // restante da volta vira um registro de preenchimento
+    while (1) {
+        size_t offset = tail & (q->capacidade - 1);
+        pulo = (offset + tamanho > q->capacidade) ? q->capacidade - offset : 0;
+        size_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+        if (tail + pulo + tamanho - head > q->capacidade) {
+            // Fila cheia
+            esperar_espaco(q, tail, pulo + tamanho);
+            tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+            continue;
+        }
+        if (atomic_compare_exchange_weak_explicit(&q->tail, &tail, tail + pulo + tamanho,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    if (pulo) {
+        atomic_store_explicit(cabecalho(q, tail), REG_PRONTO | REG_PULO | (unsigned int)pulo,
+                              memory_order_release);
+        tail += pulo;
+    }
+
+    // Copia só o tamanho real da mensagem e publica
+    char *texto = (char *)cabecalho(q, tail) + REG_CABECALHO;
+    memcpy(texto, msg, len);
+    texto[len] = '\0';
+    atomic_store_explicit(cabecalho(q, tail), REG_PRONTO | (unsigned int)tamanho,
+                          memory_order_release);
+
+    // Acorda o consumidor apenas se ele estiver dormindo
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&q->consumidor_dormindo, memory_order_relaxed) &&
+        atomic_exchange(&q->consumidor_dormindo, 0)) {
+        futex_acordar(&q->consumidor_dormindo, 1);
+    }
+    RASTRO_FIM(rastro, "tsqueue_push", len);
+}
+
+/**
+ * Espera (consumidor) até o registro na cabeça ser publicado
+ */
+static void esperar_mensagem(ThreadSafeQueue *q, size_t pos) {
+    atomic_uint *h = cabecalho(q, pos);
+    while (!(atomic_load_explicit(h, memory_order_acquire) & REG_PRONTO)) {
+        atomic_store(&q->consumidor_dormindo, 1);
+        // Reconfere depois de se anunciar para não perder o wake do produtor
+        if (atomic_load(h) & REG_PRONTO) {
+            atomic_store(&q->consumidor_dormindo, 0);
+            break;
+        }
+        futex_esperar(&q->consumidor_dormindo, 1);
     }
+}
 
-    // Copia a mensagem para o buffer na posição tail
-    strncpy(q->buffer[q->tail], msg, MSG_SIZE - 1);
-    q->buffer[q->tail][MSG_SIZE - 1] = '\0'; // Garante null terminator para segurança
-    
-    // Atualiza cauda (fila circular)
-    q->tail = (q->tail + 1) % QUEUE_CAPACITY;
-    q->size++; // Incrementa contador de elementos
-
-    // Sinaliza que a fila não está mais vazia (pode haver threads esperando)
-    pthread_cond_signal(&q->not_empty);
-    
-    // Libera o mutex
-    pthread_mutex_unlock(&q->mutex);
+/**
+ * Acorda produtores bloqueados por fila cheia (após liberar bytes)
+ */
+static void liberar_espaco(ThreadSafeQueue *q) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&q->produtores_esperando, memory_order_relaxed)) {
+        atomic_fetch_add(&q->espaco, 1);
+        futex_acordar(&q->espaco, INT_MAX);
+    }
 }
 
 /**
@@ -67,25 +166,48 @@ void tsqueue_push(ThreadSafeQueue *q, const char *msg) {
  * @param out Buffer onde a mensagem removida será copiada
  */
 void tsqueue_pop(ThreadSafeQueue *q, char *out) {
-    // Bloqueia o mutex para acesso exclusivo à fila
-    pthread_mutex_lock(&q->mutex);
-    
-    // Espera enquanto a fila estiver vazia 
-    while (q->size == 0) {
-        // Libera temporariamente o mutex e espera pelo sinal de não-vazia
-        pthread_cond_wait(&q->not_empty, &q->mutex);
+    tsqueue_pop_many(q, (char (*)[MSG_SIZE])out, 1);
+}
+
+/**
+ * Remove em lote tudo o que já está publicado (até max mensagens)
+ * @param q Ponteiro para a fila
+ * @param out Vetor de buffers de saída
+ * @param max Capacidade de out
+ * @return quantidade de mensagens removidas (ao menos uma)
+ */
+size_t tsqueue_pop_many(ThreadSafeQueue *q, char (*out)[MSG_SIZE], size_t max) {
+    size_t n = 0;
+    size_t pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+    if (max == 0) {
+        return 0;
     }
 
-    // Copia a mensagem da posição head para o buffer de saída
-    strncpy(out, q->buffer[q->head], MSG_SIZE);
-    
-    // Atualiza cabeca (fila circular)
-    q->head = (q->head + 1) % QUEUE_CAPACITY;
-    q->size--; // Decrementa contador de elementos
-
-    // Sinaliza que a fila não está mais cheia (pode haver threads esperando)
-    pthread_cond_signal(&q->not_full);
-    
-    // Libera o mutex
-    pthread_mutex_unlock(&q->mutex);
-}
\ No newline at end of file
+    while (n < max) {
+        if (n == 0) {
+            esperar_mensagem(q, pos);
+        }
+        atomic_uint *h = cabecalho(q, pos);
+        unsigned int valor = atomic_load_explicit(h, memory_order_acquire);
+        if (!(valor & REG_PRONTO)) {
+            break;
+        }
+        size_t tamanho = REG_TAMANHO(valor);
+        if (!(valor & REG_PULO)) {
+            strcpy(out[n++], (char *)h + REG_CABECALHO);
+        }
+        // Zera o registro inteiro: qualquer offset dele pode ser cabeçalho na próxima volta
+        memset(h, 0, tamanho);
+        pos += tamanho;
+    }
+
+    atomic_store_explicit(&q->head, pos, memory_order_release);
+    liberar_espaco(q);
+    return n;
+}
+
+size_t tsqueue_bytes_pendentes(ThreadSafeQueue *q) {
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    return tail > head ? tail - head : 0;
+}
@@ -3,6 +3,8 @@
 #include <time.h>
 #include <errno.h>
 
+#define TIMESTAMP_SIZE 20
+
 static logger_t* log_global = NULL;
 
 logger_t* log_init(const char *nomeArquivo) {
@@ -10,7 +12,7 @@ logger_t* log_init(const char *nomeArquivo) {
         return log_global;
     }
 
-    logger_t *log = (logger_t*)malloc(sizeof(logger_t));
+    logger_t *log = (logger_t*)calloc(1, sizeof(logger_t));
     if (log == NULL) {
         return NULL;
     }
@@ -27,6 +29,7 @@ logger_t* log_init(const char *nomeArquivo) {
     }
 
     log->verbose = 0;  // Padrão: não exibe no terminal
+    log->assincrono = 0;
     log_global = log;
     return log_global;
 }
@@ -37,30 +40,184 @@ void log_set_verbose(logger_t *log, int verbose) {
     }
 }
 
+/**
+ * Timestamp formatado da thread atual; strftime só roda quando o segundo muda
+ */
+static const char *timestamp_atual(void) {
+    static _Thread_local time_t ultimo = (time_t)-1;
+    static _Thread_local char cache[TIMESTAMP_SIZE];
+
+    time_t now = time(NULL);
+    if (now != ultimo) {
+        struct tm t;
+        localtime_r(&now, &t);
+        strftime(cache, sizeof(cache), "%d-%m-%Y %H:%M:%S", &t);
+        ultimo = now;
+    }
+    return cache;
+}
+
+/**
+ * Destrutor da chave: a thread terminou, o escritor herda o buffer
+ */
+static void buffer_abandonar(void *ptr) {
+    log_buffer_thread_t *b = ptr;
+    pthread_mutex_lock(&b->mutex);
+    b->orfao = 1;
+    pthread_mutex_unlock(&b->mutex);
+}
+
+static void buffer_liberar(log_buffer_thread_t *b) {
+    pthread_mutex_destroy(&b->mutex);
+    free(b->arquivo.dados);
+    free(b->terminal.dados);
+    free(b->binario.dados);
+    free(b);
+}
+
+/**
+ * Buffer da thread atual (criado e registrado no primeiro uso)
+ */
+static log_buffer_thread_t *buffer_da_thread(logger_t *log) {
+    log_buffer_thread_t *b = pthread_getspecific(log->chave);
+    if (b != NULL) {
+        return b;
+    }
+
+    // As áreas são alocadas no primeiro uso de cada destino: uma thread que
+    // só escreve no arquivo não paga pelo terminal nem pelo log binário
+    b = calloc(1, sizeof(log_buffer_thread_t));
+    if (b == NULL) {
+        return NULL;
+    }
+    pthread_mutex_init(&b->mutex, NULL);
+
+    pthread_mutex_lock(&log->lista_mutex);
+    b->prox = log->buffers;
+    log->buffers = b;
+    pthread_mutex_unlock(&log->lista_mutex);
+
+    pthread_setspecific(log->chave, b);
+    return b;
+}
+
+/**
+ * Grava uma área no destino (chamar com log->mutex travado) e a esvazia
+ */
+static void gravar_area(log_area_t *area, FILE *destino) {
+    if (area->usado > 0) {
+        fwrite(area->dados, 1, area->usado, destino);
+        area->usado = 0;
+    }
+}
+
+/**
+ * Reserva tamanho bytes contíguos na área (alocada no primeiro uso); se não
+ * couberem, a própria thread grava o que já acumulou (sem esperar o escritor)
+ * @return início da reserva, NULL se o bloco sozinho não cabe ou falta
+ * memória: o chamador grava direto com log->mutex
+ */
+static char *reservar(logger_t *log, log_area_t *area, FILE *destino, size_t tamanho) {
+    if (tamanho > LOG_BUFFER_THREAD) {
+        pthread_mutex_lock(&log->mutex);
+        gravar_area(area, destino);
+        pthread_mutex_unlock(&log->mutex);
+        return NULL;
+    }
+    if (area->dados == NULL && (area->dados = malloc(LOG_BUFFER_THREAD)) == NULL) {
+        return NULL;
+    }
+    if (area->usado + tamanho > LOG_BUFFER_THREAD) {
+        pthread_mutex_lock(&log->mutex);
+        gravar_area(area, destino);
+        pthread_mutex_unlock(&log->mutex);
+    }
+    char *p = area->dados + area->usado;
+    area->usado += tamanho;
+    return p;
+}
+
+/**
+ * Acrescenta a linha à área ou, se ela não couber, grava a linha direto
+ */
+static void acrescentar(logger_t *log, log_area_t *area, FILE *destino,
+                        const char *linha, size_t tamanho) {
+    char *p = reservar(log, area, destino, tamanho);
+    if (p == NULL) {
+        pthread_mutex_lock(&log->mutex);
+        fwrite(linha, 1, tamanho, destino);
+        pthread_mutex_unlock(&log->mutex);
+        return;
+    }
+    memcpy(p, linha, tamanho);
+}
+
+/**
+ * Caminho comum das escritas: síncrono (grava e descarrega na hora) ou
+ * assíncrono (acumula no buffer da thread)
+ */
+static void emitir(logger_t *log, const char *mensagem, int terminal) {
+    const char *timestamp = timestamp_atual();
+
+    if (!log->assincrono) {
+        pthread_mutex_lock(&log->mutex);
+        fprintf(log->arquivo, "[%s] %s\n", timestamp, mensagem);
+        fflush(log->arquivo);
+        if (terminal) {
+            printf("[%s] %s\n", timestamp, mensagem);
+            fflush(stdout);
+        }
+        pthread_mutex_unlock(&log->mutex);
+        return;
+    }
+
+    log_buffer_thread_t *b = buffer_da_thread(log);
+    if (b == NULL) {
+        return;
+    }
+
+    // Linha montada sem fprintf: "[timestamp] mensagem\n"
+    size_t len = strlen(mensagem);
+    size_t tamanho = TIMESTAMP_SIZE - 1 + len + 4;
+    char pequena[512];
+    char *linha = tamanho <= sizeof(pequena) ? pequena : malloc(tamanho);
+    if (linha == NULL) {
+        return;
+    }
+    linha[0] = '[';
+    memcpy(linha + 1, timestamp, TIMESTAMP_SIZE - 1);
+    linha[TIMESTAMP_SIZE] = ']';
+    linha[TIMESTAMP_SIZE + 1] = ' ';
+    memcpy(linha + TIMESTAMP_SIZE + 2, mensagem, len);
+    linha[tamanho - 1] = '\n';
+
+    pthread_mutex_lock(&b->mutex);
+    acrescentar(log, &b->arquivo, log->arquivo, linha, tamanho);
+    if (terminal) {
+        acrescentar(log, &b->terminal, stdout, linha, tamanho);
+    }
+    int lote_cheio = b->arquivo.usado >= log->lote_bytes;
+    pthread_mutex_unlock(&b->mutex);
+
+    if (linha != pequena) {
+        free(linha);
+    }
+
+    // Só o primeiro produtor a encher o lote acorda o escritor
+    if (lote_cheio && !atomic_exchange(&log->sinalizado, 1)) {
+        pthread_mutex_lock(&log->controle);
+        pthread_cond_signal(&log->acordar);
+        pthread_mutex_unlock(&log->controle);
+    }
+}
+
 void log_escrever(logger_t *log, const char *mensagem) {
     if (log == NULL || mensagem == NULL) {
         return;
     }
 
-    pthread_mutex_lock(&log->mutex);
-    
-    // Obter timestamp
-    time_t now = time(NULL);
-    struct tm *t = localtime(&now);
-    char timestamp[20];
-    strftime(timestamp, sizeof(timestamp), "%d-%m-%Y %H:%M:%S", t);
-    
-    // Escrever no arquivo
-    fprintf(log->arquivo, "[%s] %s\n", timestamp, mensagem);
-    fflush(log->arquivo);
-    
     // Exibir no terminal se verbose estiver ativado
-    if (log->verbose) {
-        printf("[%s] %s\n", timestamp, mensagem);
-        fflush(stdout);
-    }
-    
-    pthread_mutex_unlock(&log->mutex);
+    emitir(log, mensagem, log->verbose);
 }
 
 void log_escrever_verbose(logger_t *log, const char *mensagem) {
@@ -68,22 +225,8 @@ void log_escrever_verbose(logger_t *log, const char *mensagem) {
         return;
     }
 
-    pthread_mutex_lock(&log->mutex);
-    
-    // Obter timestamp
-    time_t now = time(NULL);
-    struct tm *t = localtime(&now);
-    char timestamp[20];
-    strftime(timestamp, sizeof(timestamp), "%d-%m-%Y %H:%M:%S", t);
-    
-    // Sempre escrever no arquivo
-    fprintf(log->arquivo, "[%s] %s\n", timestamp, mensagem);
-    fflush(log->arquivo);
-    
-    printf("[%s] %s\n", timestamp, mensagem);
-    fflush(stdout);
-    
-    pthread_mutex_unlock(&log->mutex);
+    // Sempre escrever no arquivo e no terminal
+    emitir(log, mensagem, 1);
 }
 
 /**
@@ -94,39 +237,312 @@ void log_erro(logger_t *log, const char *operacao, int error_code) {
         return;
     }
 
-    pthread_mutex_lock(&log->mutex);
-    
-    // Obter timestamp
-    time_t now = time(NULL);
-    struct tm *t = localtime(&now);
-    char timestamp[20];
-    strftime(timestamp, sizeof(timestamp), "%d-%m-%Y %H:%M:%S", t);
-    
     char error_msg[256];
     if (error_code != 0) {
-        sprintf(error_msg, "ERRO em %s: %s (code %d)", operacao, strerror(error_code), error_code);
+        snprintf(error_msg, sizeof(error_msg), "ERRO em %s: %s (code %d)",
+                 operacao, strerror(error_code), error_code);
     } else {
-        sprintf(error_msg, "ERRO em %s", operacao);
+        snprintf(error_msg, sizeof(error_msg), "ERRO em %s", operacao);
     }
-    
-    // Escrever no arquivo
-    fprintf(log->arquivo, "[%s] %s\n", timestamp, error_msg);
-    fflush(log->arquivo);
-    
+
     // Sempre exibir erros no terminal
-    printf("[%s] %s\n", timestamp, error_msg);
-    fflush(stdout);
-    
+    emitir(log, error_msg, 1);
+}
+
+int log_abrir_binario(logger_t *log, const char *nomeArquivo) {
+    if (log == NULL || log->binario != NULL) {
+        return -1;
+    }
+
+    FILE *f = fopen(nomeArquivo, "ab");
+    if (f == NULL) {
+        return -1;
+    }
+    if (ftell(f) == 0) {
+        log_binario_cabecalho_t cab;
+        memcpy(cab.magico, LOG_BINARIO_MAGICO, sizeof(cab.magico));
+        cab.versao = LOG_BINARIO_VERSAO;
+        cab.tamanho_registro = sizeof(log_registro_t);
+        fwrite(&cab, sizeof(cab), 1, f);
+        fflush(f);
+    }
+
+    pthread_mutex_lock(&log->mutex);
+    log->binario = f;
+    pthread_mutex_unlock(&log->mutex);
+    return 0;
+}
+
+int log_binario_ativo(const logger_t *log) {
+    return log != NULL && log->binario != NULL;
+}
+
+void log_evento(logger_t *log, uint16_t tipo, uint64_t cliente_id,
+                const void *payload, size_t tamanho) {
+    if (log == NULL || log->binario == NULL) {
+        return;
+    }
+
+    struct timespec agora;
+    clock_gettime(CLOCK_REALTIME, &agora);
+    log_registro_t reg;
+    reg.timestamp_ns = (uint64_t)agora.tv_sec * 1000000000ULL + (uint64_t)agora.tv_nsec;
+    reg.cliente_id = cliente_id;
+    reg.tamanho = (uint32_t)tamanho;
+    reg.tipo = tipo;
+    reg.reservado = 0;
+
+    if (!log->assincrono) {
+        pthread_mutex_lock(&log->mutex);
+        fwrite(&reg, sizeof(reg), 1, log->binario);
+        if (tamanho > 0) {
+            fwrite(payload, 1, tamanho, log->binario);
+        }
+        fflush(log->binario);
+        pthread_mutex_unlock(&log->mutex);
+        return;
+    }
+
+    log_buffer_thread_t *b = buffer_da_thread(log);
+    if (b == NULL) {
+        return;
+    }
+
+    // Cabeçalho e payload reservados juntos: um flush entre os dois deixaria
+    // registros de outras threads no meio do registro
+    pthread_mutex_lock(&b->mutex);
+    char *p = reservar(log, &b->binario, log->binario, sizeof(reg) + tamanho);
+    if (p == NULL) {
+        pthread_mutex_lock(&log->mutex);
+        fwrite(&reg, sizeof(reg), 1, log->binario);
+        fwrite(payload, 1, tamanho, log->binario);
+        pthread_mutex_unlock(&log->mutex);
+    } else {
+        memcpy(p, &reg, sizeof(reg));
+        if (tamanho > 0) {
+            memcpy(p + sizeof(reg), payload, tamanho);
+        }
+    }
+    int lote_cheio = b->binario.usado >= log->lote_bytes;
+    pthread_mutex_unlock(&b->mutex);
+
+    if (lote_cheio && !atomic_exchange(&log->sinalizado, 1)) {
+        pthread_mutex_lock(&log->controle);
+        pthread_cond_signal(&log->acordar);
+        pthread_mutex_unlock(&log->controle);
+    }
+}
+
+/**
+ * Tira a área com dados do produtor e põe a reserva no lugar (chamar com a
+ * trava do produtor); áreas vazias, inclusive as nunca alocadas, ficam
+ * @return área cheia ({NULL, 0} se não havia dados)
+ */
+static log_area_t retirar_area(log_area_t *area, log_area_t *reserva) {
+    log_area_t cheia = { NULL, 0 };
+    if (area->usado > 0) {
+        cheia = *area;
+        *area = *reserva;
+        reserva->dados = NULL;
+    }
+    return cheia;
+}
+
+/**
+ * Grava a área retirada e a devolve como reserva (chamar com log->mutex)
+ */
+static void devolver_area(log_area_t *cheia, log_area_t *reserva, FILE *destino) {
+    if (cheia->dados != NULL) {
+        gravar_area(cheia, destino);
+        *reserva = *cheia;
+    }
+}
+
+/**
+ * Um lote do escritor: troca as áreas com dados de cada thread pelas
+ * reservas (a trava do produtor dura só a troca), grava tudo e descarrega
+ * uma vez
+ */
+static void descarregar_buffers(logger_t *log) {
+    int terminal = 0;
+
+    pthread_mutex_lock(&log->lista_mutex);
+    log_buffer_thread_t **pp = &log->buffers;
+    while (*pp) {
+        log_buffer_thread_t *b = *pp;
+
+        pthread_mutex_lock(&b->mutex);
+        log_area_t arquivo = retirar_area(&b->arquivo, &log->reserva_arquivo);
+        log_area_t term = retirar_area(&b->terminal, &log->reserva_terminal);
+        log_area_t bin = retirar_area(&b->binario, &log->reserva_binario);
+        int orfao = b->orfao;
+        pthread_mutex_unlock(&b->mutex);
+
+        pthread_mutex_lock(&log->mutex);
+        terminal |= term.usado > 0;
+        devolver_area(&arquivo, &log->reserva_arquivo, log->arquivo);
+        devolver_area(&term, &log->reserva_terminal, stdout);
+        if (log->binario != NULL) {
+            devolver_area(&bin, &log->reserva_binario, log->binario);
+        }
+        pthread_mutex_unlock(&log->mutex);
+
+        if (orfao) {
+            *pp = b->prox;
+            buffer_liberar(b);
+        } else {
+            pp = &b->prox;
+        }
+    }
+    pthread_mutex_unlock(&log->lista_mutex);
+
+    pthread_mutex_lock(&log->mutex);
+    fflush(log->arquivo);
+    if (log->binario != NULL) {
+        fflush(log->binario);
+    }
+    if (terminal) {
+        fflush(stdout);
+    }
     pthread_mutex_unlock(&log->mutex);
 }
 
+/**
+ * Thread escritora do modo assíncrono (group commit por tamanho ou tempo)
+ */
+static void *escritor_thread(void *arg) {
+    logger_t *log = (logger_t*)arg;
+
+    pthread_mutex_lock(&log->controle);
+    while (1) {
+        if (!log->parar && log->flush_pedidos == log->flush_concluidos &&
+            !atomic_load(&log->sinalizado)) {
+            struct timespec limite;
+            clock_gettime(CLOCK_REALTIME, &limite);
+            limite.tv_nsec += (long)log->intervalo_ms * 1000000L;
+            limite.tv_sec += limite.tv_nsec / 1000000000L;
+            limite.tv_nsec %= 1000000000L;
+            pthread_cond_timedwait(&log->acordar, &log->controle, &limite);
+        }
+        uint64_t alvo = log->flush_pedidos;
+        int parar = log->parar;
+        atomic_store(&log->sinalizado, 0);
+        pthread_mutex_unlock(&log->controle);
+
+        descarregar_buffers(log);
+
+        pthread_mutex_lock(&log->controle);
+        log->flush_concluidos = alvo;
+        pthread_cond_broadcast(&log->descarregado);
+        if (parar) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&log->controle);
+    return NULL;
+}
+
+int log_set_assincrono(logger_t *log, size_t lote_bytes, int intervalo_ms) {
+    if (log == NULL || log->assincrono || intervalo_ms <= 0) {
+        return -1;
+    }
+
+    log->lote_bytes = lote_bytes;
+    log->intervalo_ms = intervalo_ms;
+    log->buffers = NULL;
+    log->flush_pedidos = 0;
+    log->flush_concluidos = 0;
+    log->parar = 0;
+    atomic_init(&log->sinalizado, 0);
+    log->reserva_arquivo.dados = malloc(LOG_BUFFER_THREAD);
+    log->reserva_arquivo.usado = 0;
+    log->reserva_terminal.dados = malloc(LOG_BUFFER_THREAD);
+    log->reserva_terminal.usado = 0;
+    log->reserva_binario.dados = malloc(LOG_BUFFER_THREAD);
+    log->reserva_binario.usado = 0;
+    if (log->reserva_arquivo.dados == NULL || log->reserva_terminal.dados == NULL ||
+        log->reserva_binario.dados == NULL) {
+        free(log->reserva_arquivo.dados);
+        free(log->reserva_terminal.dados);
+        free(log->reserva_binario.dados);
+        return -1;
+    }
+
+    pthread_key_create(&log->chave, buffer_abandonar);
+    pthread_mutex_init(&log->lista_mutex, NULL);
+    pthread_mutex_init(&log->controle, NULL);
+    pthread_cond_init(&log->acordar, NULL);
+    pthread_cond_init(&log->descarregado, NULL);
+
+    if (pthread_create(&log->escritor, NULL, escritor_thread, log) != 0) {
+        pthread_key_delete(log->chave);
+        free(log->reserva_arquivo.dados);
+        free(log->reserva_terminal.dados);
+        free(log->reserva_binario.dados);
+        return -1;
+    }
+    log->assincrono = 1;
+    return 0;
+}
+
+void log_flush(logger_t *log) {
+    if (log == NULL) {
+        return;
+    }
+
+    if (!log->assincrono) {
+        pthread_mutex_lock(&log->mutex);
+        fflush(log->arquivo);
+        if (log->binario != NULL) {
+            fflush(log->binario);
+        }
+        fflush(stdout);
+        pthread_mutex_unlock(&log->mutex);
+        return;
+    }
+
+    pthread_mutex_lock(&log->controle);
+    uint64_t meu = ++log->flush_pedidos;
+    pthread_cond_signal(&log->acordar);
+    while (log->flush_concluidos < meu) {
+        pthread_cond_wait(&log->descarregado, &log->controle);
+    }
+    pthread_mutex_unlock(&log->controle);
+}
+
 void log_destruir(logger_t *log) {
     if (log == NULL) {
         return;
     }
 
+    if (log->assincrono) {
+        // Último lote e fim do escritor
+        pthread_mutex_lock(&log->controle);
+        log->parar = 1;
+        pthread_cond_signal(&log->acordar);
+        pthread_mutex_unlock(&log->controle);
+        pthread_join(log->escritor, NULL);
+
+        pthread_key_delete(log->chave);
+        while (log->buffers) {
+            log_buffer_thread_t *b = log->buffers;
+            log->buffers = b->prox;
+            buffer_liberar(b);
+        }
+        free(log->reserva_arquivo.dados);
+        free(log->reserva_terminal.dados);
+        free(log->reserva_binario.dados);
+        pthread_mutex_destroy(&log->lista_mutex);
+        pthread_mutex_destroy(&log->controle);
+        pthread_cond_destroy(&log->acordar);
+        pthread_cond_destroy(&log->descarregado);
+    }
+
     pthread_mutex_destroy(&log->mutex);
     fclose(log->arquivo);
+    if (log->binario != NULL) {
+        fclose(log->binario);
+    }
     free(log);
     log_global = NULL;
-}
\ No newline at end of file
+}
@@ -0,0 +1,152 @@
+#include "../include/limites.h"
+#include <stdatomic.h>
+#include <time.h>
+
+static config_limites_t config = { 0, 0, 0, 0, LIMITES_RAJADA_MS_PADRAO, LIMITE_ATRASAR };
+static uint64_t rajada_ns = (uint64_t)LIMITES_RAJADA_MS_PADRAO * 1000000ULL;
+static int ativos = 0;
+
+static atomic_uint_fast64_t global_mensagens_ns = 0;
+static atomic_uint_fast64_t global_bytes_ns = 0;
+static atomic_uint_fast64_t acionamentos[LIMITE_QUANTIDADE];
+
+void limites_configurar(const config_limites_t *cfg) {
+    config = *cfg;
+    rajada_ns = (uint64_t)(cfg->rajada_ms > 0 ? cfg->rajada_ms : 0) * 1000000ULL;
+    ativos = cfg->mensagens || cfg->bytes || cfg->global_mensagens || cfg->global_bytes;
+}
+
+int limites_ativos(void) {
+    return ativos;
+}
+
+limite_acao_t limites_acao(void) {
+    return config.acao;
+}
+
+const char *limites_nome_acao(limite_acao_t acao) {
+    switch (acao) {
+    case LIMITE_ATRASAR:
+        return "atrasar";
+    case LIMITE_DESCARTAR:
+        return "descartar";
+    case LIMITE_DESCONECTAR:
+        return "desconectar";
+    }
+    return "?";
+}
+
+static uint64_t agora_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Tempo de taxa consumido por unidades (taxa > 0)
+static uint64_t custo_ns(uint64_t unidades, uint64_t taxa) {
+    return unidades * 1000000000ULL / taxa;
+}
+
+/**
+ * Avalia a cobrança de custo em um balde com instante teórico tat. Um balde
+ * cheio (tat <= agora) sempre aceita o quadro, mesmo maior que a rajada.
+ * @return ns acima da rajada depois da cobrança (0 = dentro); *novo recebe
+ *         o instante teórico já cobrado e *disparou se o balde excedeu
+ */
+static uint64_t avaliar(uint64_t tat, uint64_t custo, uint64_t agora, int recusar,
+                        uint64_t *novo, int *disparou) {
+    *novo = (tat > agora ? tat : agora) + custo;
+    uint64_t excesso = *novo > agora + rajada_ns ? *novo - (agora + rajada_ns) : 0;
+    *disparou = excesso > 0 && (!recusar || tat > agora);
+    return excesso;
+}
+
+/**
+ * Cobra em um balde global; com recusar, um quadro que excede não é cobrado
+ */
+static uint64_t cobrar_global(atomic_uint_fast64_t *tat, uint64_t custo, uint64_t agora,
+                              int recusar, int *disparou) {
+    uint64_t atual = atomic_load_explicit(tat, memory_order_relaxed);
+    uint64_t novo, excesso;
+    do {
+        excesso = avaliar(atual, custo, agora, recusar, &novo, disparou);
+        if (recusar && *disparou) {
+            return excesso;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(tat, &atual, novo, memory_order_relaxed,
+                                                    memory_order_relaxed));
+    return excesso;
+}
+
+static void acionar(limite_balde_t balde) {
+    atomic_fetch_add_explicit(&acionamentos[balde], 1, memory_order_relaxed);
+}
+
+uint64_t limites_cobrar(limite_conexao_t *l, size_t bytes) {
+    uint64_t agora = agora_ns();
+    int recusar = config.acao != LIMITE_ATRASAR;
+    uint64_t espera = 0, excesso;
+    uint64_t mensagens_ns = l->mensagens_ns, bytes_ns = l->bytes_ns;
+    int disparou, recusado = 0;
+
+    // Baldes da conexão: avaliados primeiro e só gravados no fim, para que
+    // uma recusa global não cobre nada da conexão
+    if (config.mensagens) {
+        excesso = avaliar(l->mensagens_ns, custo_ns(1, config.mensagens), agora, recusar,
+                          &mensagens_ns, &disparou);
+        if (disparou) {
+            acionar(LIMITE_CONEXAO_MENSAGENS);
+            espera = excesso > espera ? excesso : espera;
+            recusado |= recusar;
+        }
+    }
+    if (config.bytes) {
+        excesso = avaliar(l->bytes_ns, custo_ns(bytes, config.bytes), agora, recusar,
+                          &bytes_ns, &disparou);
+        if (disparou) {
+            acionar(LIMITE_CONEXAO_BYTES);
+            espera = excesso > espera ? excesso : espera;
+            recusado |= recusar;
+        }
+    }
+    if (recusado) {
+        return espera;
+    }
+
+    if (config.global_mensagens) {
+        excesso = cobrar_global(&global_mensagens_ns, custo_ns(1, config.global_mensagens),
+                                agora, recusar, &disparou);
+        if (disparou) {
+            acionar(LIMITE_GLOBAL_MENSAGENS);
+            espera = excesso > espera ? excesso : espera;
+            recusado |= recusar;
+        }
+    }
+    if (config.global_bytes && !recusado) {
+        excesso = cobrar_global(&global_bytes_ns, custo_ns(bytes, config.global_bytes),
+                                agora, recusar, &disparou);
+        if (disparou) {
+            acionar(LIMITE_GLOBAL_BYTES);
+            espera = excesso > espera ? excesso : espera;
+            recusado |= recusar;
+            if (config.global_mensagens) {
+                // Devolve a mensagem já cobrada no balde global de mensagens
+                atomic_fetch_sub_explicit(&global_mensagens_ns, custo_ns(1, config.global_mensagens),
+                                          memory_order_relaxed);
+            }
+        }
+    }
+    if (recusado) {
+        return espera;
+    }
+
+    l->mensagens_ns = mensagens_ns;
+    l->bytes_ns = bytes_ns;
+    return recusar ? 0 : espera;
+}
+
+void limites_estatisticas(uint64_t valores[LIMITE_QUANTIDADE]) {
+    for (int i = 0; i < LIMITE_QUANTIDADE; i++) {
+        valores[i] = atomic_load(&acionamentos[i]);
+    }
+}
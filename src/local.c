@@ -0,0 +1,318 @@
+#define _GNU_SOURCE
+#include "../include/local.h"
+#include "../include/servidor.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Canal de memória compartilhada de uma conexão (em c->shm)
+struct canal_local {
+    canal_shm_t *canal;
+    int evfd_servidor;          // acorda o laço dono: dados na entrada ou espaço na saída
+    int evfd_cliente;           // acorda o cliente: dados na saída ou espaço na entrada
+};
+
+static config_local_t config;
+static int escuta_fd = -1;
+
+static atomic_uint_fast64_t total_aceitas = 0;
+static atomic_uint_fast64_t total_canais = 0;
+static atomic_uint_fast64_t total_recusas = 0;
+static atomic_uint_fast64_t total_sinais = 0;
+
+int local_iniciar(const config_local_t *cfg) {
+    config = *cfg;
+    if (config.caminho == NULL) {
+        return 0;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(config.caminho) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(addr.sun_path, config.caminho);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    // Um arquivo deixado por uma execução anterior (ou pelo processo antigo
+    // no hot upgrade) impediria o bind
+    unlink(config.caminho);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        int erro = errno;
+        close(fd);
+        errno = erro;
+        return -1;
+    }
+    escuta_fd = fd;
+    return 0;
+}
+
+int local_escuta(void) {
+    return escuta_fd;
+}
+
+void local_aceita(void) {
+    atomic_fetch_add(&total_aceitas, 1);
+}
+
+static void sinalizar(int evfd) {
+    uint64_t um = 1;
+    if (write(evfd, &um, sizeof(um)) < 0 && errno != EAGAIN) {
+        log_server_error("write eventfd (shm)", errno);
+    }
+}
+
+static void recusar(conexao_t *c, const char *motivo) {
+    char resposta[100];
+    int len = snprintf(resposta, sizeof(resposta), ANEL_SHM_RECUSA ": %s", motivo);
+    conexao_enviar(c, resposta, (size_t)len);
+    atomic_fetch_add(&total_recusas, 1);
+}
+
+static void canal_liberar(struct canal_local *cl) {
+    if (cl->canal != NULL) {
+        munmap(cl->canal, sizeof(canal_shm_t));
+    }
+    if (cl->evfd_servidor >= 0) {
+        close(cl->evfd_servidor);
+    }
+    if (cl->evfd_cliente >= 0) {
+        close(cl->evfd_cliente);
+    }
+    free(cl);
+}
+
+/**
+ * Cria o memfd com os dois anéis e os eventfds
+ * @param memfd recebe o descritor do memfd (o mapeamento fica no canal)
+ * @return canal ou NULL em erro
+ */
+static struct canal_local *canal_criar(int *memfd) {
+    struct canal_local *cl = calloc(1, sizeof(*cl));
+    if (cl == NULL) {
+        return NULL;
+    }
+    cl->evfd_servidor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    cl->evfd_cliente = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    *memfd = memfd_create("chat-shm", MFD_CLOEXEC);
+    if (cl->evfd_servidor < 0 || cl->evfd_cliente < 0 || *memfd < 0 ||
+        ftruncate(*memfd, sizeof(canal_shm_t)) < 0) {
+        goto erro;
+    }
+    void *mapa = mmap(NULL, sizeof(canal_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, *memfd, 0);
+    if (mapa == MAP_FAILED) {
+        goto erro;
+    }
+    cl->canal = mapa;
+    anel_shm_iniciar(cl->canal);
+    return cl;
+
+erro:
+    if (*memfd >= 0) {
+        close(*memfd);
+    }
+    canal_liberar(cl);
+    return NULL;
+}
+
+/**
+ * Ativa o canal: a resposta de aceite sai pelo socket com o memfd e os dois
+ * eventfds, e a partir dela a fila de saída passa a ser descarregada no anel
+ */
+int local_ativar_shm(conexao_t *c) {
+    if (!c->local) {
+        recusar(c, "conexão não é local");
+        return 0;
+    }
+    if (!config.shm) {
+        recusar(c, "desativado no servidor (--shm)");
+        return 0;
+    }
+    if (c->shm != NULL) {
+        recusar(c, "canal já ativo");
+        return 0;
+    }
+    if (c->epfd < 0) {
+        recusar(c, "indisponível neste modo");
+        return 0;
+    }
+
+    int memfd;
+    struct canal_local *cl = canal_criar(&memfd);
+    if (cl == NULL) {
+        log_server_error("criação do canal shm", errno);
+        recusar(c, "sem recursos");
+        return 0;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = c;
+    if (epoll_ctl(c->epfd, EPOLL_CTL_ADD, cl->evfd_servidor, &ev) < 0) {
+        log_server_error("epoll_ctl ADD (shm)", errno);
+        close(memfd);
+        canal_liberar(cl);
+        recusar(c, "sem recursos");
+        return 0;
+    }
+
+    char quadro[PROTO_CABECALHO + sizeof(ANEL_SHM_ACEITE) - 1];
+    size_t tamanho = proto_codificar(quadro, ANEL_SHM_ACEITE, sizeof(ANEL_SHM_ACEITE) - 1);
+    struct iovec iov = { quadro, tamanho };
+    int fds[3] = { memfd, cl->evfd_servidor, cl->evfd_cliente };
+    union {
+        char buf[CMSG_SPACE(sizeof(fds))];
+        struct cmsghdr alinhamento;
+    } controle;
+    memset(&controle, 0, sizeof(controle));
+
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = controle.buf;
+    msg.msg_controllen = sizeof(controle.buf);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    int resultado = conexao_ativar_shm(c, cl, &msg);
+    close(memfd);
+    if (resultado != 0) {
+        int erro = errno;
+        epoll_ctl(c->epfd, EPOLL_CTL_DEL, cl->evfd_servidor, NULL);
+        canal_liberar(cl);
+        if (erro == EPIPE) {
+            return -1;  // aceite pela metade no socket: o fluxo se perdeu
+        }
+        recusar(c, "saída pendente no socket, tente de novo");
+        return 0;
+    }
+    atomic_fetch_add(&total_canais, 1);
+
+    // O que já estava na fila segue agora pelo anel
+    conexao_escrita_pronta(c);
+    return 0;
+}
+
+int local_shm_receber(conexao_t *c) {
+    struct canal_local *cl = c->shm;
+    anel_shm_t *a = &cl->canal->entrada;
+
+    // O mesmo eventfd avisa de espaço livre na saída
+    uint64_t valor;
+    if (read(cl->evfd_servidor, &valor, sizeof(valor)) > 0) {
+        conexao_escrita_pronta(c);
+    }
+
+    // Suspensa pelo limite de taxa: os dados esperam no anel até a retomada
+    while (c->retomar_ns == 0) {
+        const char *dados;
+        size_t n = anel_shm_trecho(a, &dados);
+        if (n == 0) {
+            if (anel_shm_adormecer(a)) {
+                return 0;
+            }
+            continue;
+        }
+        size_t copiados = proto_ring_escrever(&c->ring, dados, n);
+        anel_shm_consumir(a, copiados);
+        metricas_somar(METRICA_BYTES_RECEBIDOS, (uint64_t)copiados);
+        if (anel_shm_liberado(a)) {
+            sinalizar(cl->evfd_cliente);
+            atomic_fetch_add(&total_sinais, 1);
+        }
+        if (process_client_frames(c) < 0) {
+            return -1;
+        }
+        if (copiados == 0) {
+            return 0;  // anel de recepção cheio (só com a conexão suspensa)
+        }
+    }
+    return 0;
+}
+
+/**
+ * Copia até o anel encher; só desiste depois de marcar a espera por espaço,
+ * então uma cópia parcial sempre terá um aviso do cliente
+ */
+ssize_t local_shm_enviar(conexao_t *c, struct iovec *iov, size_t n) {
+    anel_shm_t *a = &c->shm->canal->saida;
+    size_t total = 0;
+
+    while (n > 0) {
+        size_t escrito = anel_shm_escrever(a, iov, n);
+        total += escrito;
+        while (n > 0 && escrito >= iov->iov_len) {
+            escrito -= iov->iov_len;
+            iov++;
+            n--;
+        }
+        if (n == 0) {
+            break;
+        }
+        iov->iov_base = (char *)iov->iov_base + escrito;
+        iov->iov_len -= escrito;
+        if (anel_shm_aguardar_espaco(a)) {
+            break;
+        }
+    }
+    if (total == 0 && n > 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+    return (ssize_t)total;
+}
+
+void local_shm_notificar(conexao_t *c) {
+    if (anel_shm_publicado(&c->shm->canal->saida)) {
+        sinalizar(c->shm->evfd_cliente);
+        atomic_fetch_add(&total_sinais, 1);
+    }
+}
+
+void local_fechar(conexao_t *c) {
+    if (c->shm != NULL && c->epfd >= 0) {
+        epoll_ctl(c->epfd, EPOLL_CTL_DEL, c->shm->evfd_servidor, NULL);
+    }
+}
+
+void local_liberar(conexao_t *c) {
+    if (c->shm != NULL) {
+        canal_liberar(c->shm);
+        c->shm = NULL;
+    }
+}
+
+void local_estatisticas(local_info_t *info) {
+    info->aceitas = atomic_load(&total_aceitas);
+    info->canais = atomic_load(&total_canais);
+    info->recusas = atomic_load(&total_recusas);
+    info->sinais = atomic_load(&total_sinais);
+}
+
+void local_encerrar(void) {
+    if (escuta_fd < 0) {
+        return;
+    }
+    close(escuta_fd);
+    escuta_fd = -1;
+    if (!transferencia_ativa()) {
+        unlink(config.caminho);
+    }
+}
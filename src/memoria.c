@@ -0,0 +1,148 @@
+#include "../include/memoria.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define SLAB_ALINHAMENTO 64     // uma linha de cache: conexões vizinhas não se disputam
+
+struct slab {
+    const char *nome;
+    size_t objeto;
+    size_t por_bloco;
+    int por_conexao;
+    pthread_mutex_t mutex;
+    void *livres;               // lista livre encadeada pela primeira palavra do objeto
+    uint64_t em_uso;            // protegidos pelo mutex
+    uint64_t capacidade;
+};
+
+static config_memoria_t config = { 0, 0 };
+static slab_t slabs[MEMORIA_MAX_SLABS];
+static atomic_int num_slabs = 0;
+static atomic_size_t custo_slabs = 0;
+
+static atomic_size_t total = 0;         // soma dos usos, comparada ao limite
+static atomic_uint_fast64_t uso[MEMORIA_USOS];
+static atomic_uint_fast64_t recusas[MEMORIA_USOS];
+static atomic_uint_fast64_t mapeados = 0;
+
+void memoria_configurar(const config_memoria_t *cfg) {
+    config = *cfg;
+}
+
+slab_t *slab_criar(const char *nome, size_t tamanho, int por_conexao) {
+    int i = atomic_fetch_add(&num_slabs, 1);
+    if (i >= MEMORIA_MAX_SLABS) {
+        atomic_fetch_sub(&num_slabs, 1);
+        return NULL;
+    }
+    slab_t *s = &slabs[i];
+    s->nome = nome;
+    s->objeto = (tamanho + SLAB_ALINHAMENTO - 1) & ~(size_t)(SLAB_ALINHAMENTO - 1);
+    size_t bloco = s->objeto * 8 > SLAB_BLOCO_MIN ? s->objeto * 8 : SLAB_BLOCO_MIN;
+    s->por_bloco = bloco / s->objeto;
+    s->por_conexao = por_conexao;
+    pthread_mutex_init(&s->mutex, NULL);
+    s->livres = NULL;
+    s->em_uso = 0;
+    s->capacidade = 0;
+    if (por_conexao) {
+        atomic_fetch_add(&custo_slabs, s->objeto);
+    }
+    return s;
+}
+
+/**
+ * Mapeia um bloco e encadeia os objetos na lista livre (chamar com o mutex
+ * travado)
+ */
+static int slab_crescer(slab_t *s) {
+    size_t tamanho = s->objeto * s->por_bloco;
+    char *bloco = mmap(NULL, tamanho, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (bloco == MAP_FAILED) {
+        return -1;
+    }
+    for (size_t i = s->por_bloco; i > 0; i--) {
+        void *obj = bloco + (i - 1) * s->objeto;
+        *(void **)obj = s->livres;
+        s->livres = obj;
+    }
+    s->capacidade += s->por_bloco;
+    atomic_fetch_add(&mapeados, tamanho);
+    return 0;
+}
+
+void *slab_alocar(slab_t *s) {
+    pthread_mutex_lock(&s->mutex);
+    if (s->livres == NULL && slab_crescer(s) != 0) {
+        pthread_mutex_unlock(&s->mutex);
+        return NULL;
+    }
+    void *obj = s->livres;
+    s->livres = *(void **)obj;
+    s->em_uso++;
+    pthread_mutex_unlock(&s->mutex);
+    return obj;
+}
+
+void slab_liberar(slab_t *s, void *obj) {
+    if (obj == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&s->mutex);
+    *(void **)obj = s->livres;
+    s->livres = obj;
+    s->em_uso--;
+    pthread_mutex_unlock(&s->mutex);
+}
+
+size_t memoria_custo_conexao(void) {
+    return atomic_load(&custo_slabs) + config.pilha;
+}
+
+int memoria_reservar(memoria_uso_t u, size_t bytes) {
+    if (config.limite == 0) {
+        atomic_fetch_add(&total, bytes);
+    } else {
+        size_t atual = atomic_load_explicit(&total, memory_order_relaxed);
+        do {
+            if (atual + bytes > config.limite) {
+                atomic_fetch_add(&recusas[u], 1);
+                return -1;
+            }
+        } while (!atomic_compare_exchange_weak_explicit(&total, &atual, atual + bytes,
+                                                        memory_order_relaxed,
+                                                        memory_order_relaxed));
+    }
+    atomic_fetch_add_explicit(&uso[u], bytes, memory_order_relaxed);
+    return 0;
+}
+
+void memoria_devolver(memoria_uso_t u, size_t bytes) {
+    atomic_fetch_sub_explicit(&total, bytes, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&uso[u], bytes, memory_order_relaxed);
+}
+
+void memoria_estatisticas(memoria_info_t *info) {
+    memset(info, 0, sizeof(*info));
+    info->limite = config.limite;
+    info->por_conexao = memoria_custo_conexao();
+    info->pilha = config.pilha;
+    for (int u = 0; u < MEMORIA_USOS; u++) {
+        info->uso[u] = atomic_load(&uso[u]);
+        info->recusas[u] = atomic_load(&recusas[u]);
+    }
+    info->mapeados = atomic_load(&mapeados);
+    int n = atomic_load(&num_slabs);
+    info->num_slabs = n < MEMORIA_MAX_SLABS ? n : MEMORIA_MAX_SLABS;
+    for (int i = 0; i < info->num_slabs; i++) {
+        slab_t *s = &slabs[i];
+        pthread_mutex_lock(&s->mutex);
+        info->slabs[i].nome = s->nome;
+        info->slabs[i].objeto = s->objeto;
+        info->slabs[i].em_uso = s->em_uso;
+        info->slabs[i].capacidade = s->capacidade;
+        pthread_mutex_unlock(&s->mutex);
+    }
+}
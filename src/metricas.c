@@ -0,0 +1,463 @@
+#include "../include/metricas.h"
+#include "../include/servidor.h"
+#include <stdio.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// Histograma log-linear compacto: 16 sub-faixas por potência de 2 (~6% de
+// erro) até 2^36 ns (~69 s), para caber barato em cada thread de cliente
+#define FANOUT_SUB_BITS 4
+#define FANOUT_SUB (1 << FANOUT_SUB_BITS)
+#define FANOUT_MAX_BITS 36
+#define FANOUT_FAIXAS ((FANOUT_MAX_BITS - FANOUT_SUB_BITS + 1) * FANOUT_SUB)
+
+typedef struct metricas_thread {
+    struct metricas_thread *prox;
+    atomic_uint_fast64_t contadores[METRICA_QUANTIDADE];
+    atomic_uint_fast64_t fanout_faixas[FANOUT_FAIXAS];
+    atomic_uint_fast64_t fanout_soma_ns;
+    atomic_uint_fast64_t fanout_contagem;
+} metricas_thread_t;
+
+static pthread_mutex_t blocos_mutex = PTHREAD_MUTEX_INITIALIZER;
+static metricas_thread_t *blocos = NULL;
+static metricas_thread_t aposentadas;       // somas das threads que já terminaram
+static pthread_key_t chave;
+static pthread_once_t chave_once = PTHREAD_ONCE_INIT;
+static _Thread_local metricas_thread_t *bloco_atual = NULL;
+
+static int admin_fd = -1;
+static pthread_t admin_tid;
+
+static const char *const nomes[METRICA_QUANTIDADE][2] = {
+    { "chat_conexoes_aceitas_total",   "Conexoes aceitas e registradas" },
+    { "chat_conexoes_rejeitadas_total", "Conexoes recusadas por limite de clientes ou de memoria" },
+    { "chat_bytes_recebidos_total",    "Bytes lidos dos sockets de clientes" },
+    { "chat_bytes_enviados_total",     "Bytes escritos nos sockets de clientes" },
+    { "chat_mensagens_total",          "Quadros de clientes processados" },
+    { "chat_broadcasts_total",         "Broadcasts distribuidos" },
+    { "chat_entregas_total",           "Quadros enfileirados para destinatarios (fan-out)" },
+    { "chat_falhas_envio_total",       "Conexoes interrompidas por erro de envio" },
+};
+
+static void somar_relaxado(atomic_uint_fast64_t *destino, uint64_t valor) {
+    atomic_store_explicit(destino, atomic_load_explicit(destino, memory_order_relaxed) + valor,
+                          memory_order_relaxed);
+}
+
+/**
+ * Destrutor da thread: acumula o bloco nas aposentadas e o libera
+ */
+static void aposentar(void *arg) {
+    metricas_thread_t *b = arg;
+
+    pthread_mutex_lock(&blocos_mutex);
+    for (metricas_thread_t **p = &blocos; *p; p = &(*p)->prox) {
+        if (*p == b) {
+            *p = b->prox;
+            break;
+        }
+    }
+    for (int i = 0; i < METRICA_QUANTIDADE; i++) {
+        somar_relaxado(&aposentadas.contadores[i], atomic_load(&b->contadores[i]));
+    }
+    for (int i = 0; i < FANOUT_FAIXAS; i++) {
+        somar_relaxado(&aposentadas.fanout_faixas[i], atomic_load(&b->fanout_faixas[i]));
+    }
+    somar_relaxado(&aposentadas.fanout_soma_ns, atomic_load(&b->fanout_soma_ns));
+    somar_relaxado(&aposentadas.fanout_contagem, atomic_load(&b->fanout_contagem));
+    pthread_mutex_unlock(&blocos_mutex);
+    free(b);
+}
+
+static void criar_chave(void) {
+    pthread_key_create(&chave, aposentar);
+}
+
+/**
+ * Bloco da thread atual, criado no primeiro uso (só aqui o mutex é tocado)
+ */
+static metricas_thread_t *bloco(void) {
+    if (bloco_atual != NULL) {
+        return bloco_atual;
+    }
+    pthread_once(&chave_once, criar_chave);
+    metricas_thread_t *b = calloc(1, sizeof(metricas_thread_t));
+    if (b == NULL) {
+        return &aposentadas;  // sem memória: contagem aproximada no bloco comum
+    }
+    pthread_mutex_lock(&blocos_mutex);
+    b->prox = blocos;
+    blocos = b;
+    pthread_mutex_unlock(&blocos_mutex);
+    pthread_setspecific(chave, b);
+    bloco_atual = b;
+    return b;
+}
+
+void metricas_somar(metrica_t m, uint64_t valor) {
+    somar_relaxado(&bloco()->contadores[m], valor);
+}
+
+static int fanout_indice(uint64_t v) {
+    if (v < FANOUT_SUB) {
+        return (int)v;
+    }
+    int e = 63 - __builtin_clzll(v);
+    if (e >= FANOUT_MAX_BITS) {
+        return FANOUT_FAIXAS - 1;
+    }
+    return (e - FANOUT_SUB_BITS + 1) * FANOUT_SUB + (int)((v >> (e - FANOUT_SUB_BITS)) - FANOUT_SUB);
+}
+
+// Limite superior da faixa (valores da faixa são < que ele)
+static uint64_t fanout_limite(int indice) {
+    if (indice < FANOUT_SUB) {
+        return (uint64_t)indice + 1;
+    }
+    int e = indice / FANOUT_SUB + FANOUT_SUB_BITS - 1;
+    uint64_t m = (uint64_t)(indice % FANOUT_SUB + FANOUT_SUB) + 1;
+    return m << (e - FANOUT_SUB_BITS);
+}
+
+void metricas_registrar_fanout(uint64_t ns) {
+    metricas_thread_t *b = bloco();
+    somar_relaxado(&b->fanout_faixas[fanout_indice(ns)], 1);
+    somar_relaxado(&b->fanout_soma_ns, ns);
+    somar_relaxado(&b->fanout_contagem, 1);
+}
+
+uint64_t metricas_agora_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Soma os blocos de todas as threads (vivas e aposentadas) em um instantâneo
+ */
+static void coletar(metricas_thread_t *total) {
+    memset(total, 0, sizeof(*total));
+    pthread_mutex_lock(&blocos_mutex);
+    for (metricas_thread_t *b = blocos; ; b = b->prox) {
+        metricas_thread_t *origem = b ? b : &aposentadas;
+        for (int i = 0; i < METRICA_QUANTIDADE; i++) {
+            somar_relaxado(&total->contadores[i], atomic_load_explicit(&origem->contadores[i], memory_order_relaxed));
+        }
+        for (int i = 0; i < FANOUT_FAIXAS; i++) {
+            somar_relaxado(&total->fanout_faixas[i], atomic_load_explicit(&origem->fanout_faixas[i], memory_order_relaxed));
+        }
+        somar_relaxado(&total->fanout_soma_ns, atomic_load_explicit(&origem->fanout_soma_ns, memory_order_relaxed));
+        somar_relaxado(&total->fanout_contagem, atomic_load_explicit(&origem->fanout_contagem, memory_order_relaxed));
+        if (b == NULL) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&blocos_mutex);
+}
+
+static uint64_t fanout_percentil(const metricas_thread_t *t, double p) {
+    uint64_t contagem = atomic_load(&t->fanout_contagem);
+    if (contagem == 0) {
+        return 0;
+    }
+    uint64_t alvo = (uint64_t)(p * (double)contagem);
+    if (alvo >= contagem) {
+        alvo = contagem - 1;
+    }
+    uint64_t acumulado = 0;
+    for (int i = 0; i < FANOUT_FAIXAS; i++) {
+        acumulado += atomic_load(&t->fanout_faixas[i]);
+        if (acumulado > alvo) {
+            return fanout_limite(i);
+        }
+    }
+    return fanout_limite(FANOUT_FAIXAS - 1);
+}
+
+/**
+ * Formata as métricas; a taxa de mensagens é calculada entre duas leituras
+ */
+size_t metricas_formatar(char *buf, size_t max) {
+    static uint64_t ultima_contagem = 0;
+    static uint64_t ultimo_instante = 0;
+
+    metricas_thread_t *t = malloc(sizeof(metricas_thread_t));
+    if (t == NULL) {
+        return 0;
+    }
+    coletar(t);
+
+    size_t n = 0;
+#define EMITIR(...) \
+    do { \
+        if (n < max) { \
+            int r = snprintf(buf + n, max - n, __VA_ARGS__); \
+            n += r > 0 ? (size_t)r : 0; \
+        } \
+    } while (0)
+
+    for (int i = 0; i < METRICA_QUANTIDADE; i++) {
+        EMITIR("# HELP %s %s\n# TYPE %s counter\n%s %llu\n", nomes[i][0], nomes[i][1],
+               nomes[i][0], nomes[i][0], (unsigned long long)atomic_load(&t->contadores[i]));
+    }
+
+    uint64_t descartadas, despejadas;
+    conexao_estatisticas(&descartadas, &despejadas);
+    EMITIR("# HELP chat_mensagens_descartadas_total Quadros descartados acima da marca alta\n"
+           "# TYPE chat_mensagens_descartadas_total counter\nchat_mensagens_descartadas_total %llu\n",
+           (unsigned long long)descartadas);
+    EMITIR("# HELP chat_clientes_despejados_total Clientes lentos desconectados\n"
+           "# TYPE chat_clientes_despejados_total counter\nchat_clientes_despejados_total %llu\n",
+           (unsigned long long)despejadas);
+
+    static const char *const baldes[LIMITE_QUANTIDADE][2] = {
+        { "conexao", "mensagens" }, { "conexao", "bytes" },
+        { "global", "mensagens" }, { "global", "bytes" },
+    };
+    uint64_t acionamentos[LIMITE_QUANTIDADE];
+    limites_estatisticas(acionamentos);
+    EMITIR("# HELP chat_limite_acionamentos_total Quadros acima de um limite de taxa de entrada\n"
+           "# TYPE chat_limite_acionamentos_total counter\n");
+    for (int i = 0; i < LIMITE_QUANTIDADE; i++) {
+        EMITIR("chat_limite_acionamentos_total{escopo=\"%s\",recurso=\"%s\",acao=\"%s\"} %llu\n",
+               baldes[i][0], baldes[i][1], limites_nome_acao(limites_acao()),
+               (unsigned long long)acionamentos[i]);
+    }
+
+    federacao_info_t fed;
+    federacao_estatisticas(&fed);
+    EMITIR("# HELP chat_federacao_mensagens_total Mensagens trocadas com outros nos da federacao\n"
+           "# TYPE chat_federacao_mensagens_total counter\n"
+           "chat_federacao_mensagens_total{sentido=\"enviadas\"} %llu\n"
+           "chat_federacao_mensagens_total{sentido=\"recebidas\"} %llu\n"
+           "chat_federacao_mensagens_total{sentido=\"duplicadas\"} %llu\n"
+           "chat_federacao_mensagens_total{sentido=\"descartadas\"} %llu\n",
+           (unsigned long long)fed.enviadas, (unsigned long long)fed.recebidas,
+           (unsigned long long)fed.duplicadas, (unsigned long long)fed.descartadas);
+    EMITIR("# HELP chat_federacao_enlaces Enlaces com outros nos conectados\n"
+           "# TYPE chat_federacao_enlaces gauge\nchat_federacao_enlaces %d\n", fed.enlaces);
+
+    local_info_t loc;
+    local_estatisticas(&loc);
+    EMITIR("# HELP chat_local_conexoes_total Conexoes recebidas pelo socket Unix\n"
+           "# TYPE chat_local_conexoes_total counter\nchat_local_conexoes_total %llu\n"
+           "# HELP chat_shm_canais_total Pedidos de canal em memoria compartilhada\n"
+           "# TYPE chat_shm_canais_total counter\n"
+           "chat_shm_canais_total{resultado=\"ativado\"} %llu\n"
+           "chat_shm_canais_total{resultado=\"recusado\"} %llu\n"
+           "# HELP chat_shm_sinais_total Eventfds escritos para acordar clientes do canal\n"
+           "# TYPE chat_shm_sinais_total counter\nchat_shm_sinais_total %llu\n",
+           (unsigned long long)loc.aceitas, (unsigned long long)loc.canais,
+           (unsigned long long)loc.recusas, (unsigned long long)loc.sinais);
+
+    difusao_info_t dif;
+    difusao_estatisticas(&dif);
+    EMITIR("# HELP chat_difusao_divididos_total Broadcasts acima do limiar divididos em fatias\n"
+           "# TYPE chat_difusao_divididos_total counter\nchat_difusao_divididos_total %llu\n"
+           "# HELP chat_difusao_fatias_total Fatias de broadcasts divididos por executor\n"
+           "# TYPE chat_difusao_fatias_total counter\n"
+           "chat_difusao_fatias_total{executor=\"remetente\"} %llu\n"
+           "chat_difusao_fatias_total{executor=\"ajudante\"} %llu\n",
+           (unsigned long long)dif.divididos, (unsigned long long)dif.fatias_remetente,
+           (unsigned long long)dif.fatias_ajudantes);
+
+    static const char *const usos[MEMORIA_USOS] = { "conexoes", "filas" };
+    memoria_info_t mem;
+    memoria_estatisticas(&mem);
+    EMITIR("# HELP chat_memoria_bytes Bytes cobrados do orcamento de memoria por uso\n"
+           "# TYPE chat_memoria_bytes gauge\n");
+    for (int i = 0; i < MEMORIA_USOS; i++) {
+        EMITIR("chat_memoria_bytes{uso=\"%s\"} %llu\n", usos[i], (unsigned long long)mem.uso[i]);
+    }
+    EMITIR("# HELP chat_memoria_recusas_total Conexoes e quadros recusados pelo orcamento de memoria\n"
+           "# TYPE chat_memoria_recusas_total counter\n");
+    for (int i = 0; i < MEMORIA_USOS; i++) {
+        EMITIR("chat_memoria_recusas_total{uso=\"%s\"} %llu\n", usos[i],
+               (unsigned long long)mem.recusas[i]);
+    }
+    EMITIR("# HELP chat_memoria_limite_bytes Orcamento global de memoria (0 = sem limite)\n"
+           "# TYPE chat_memoria_limite_bytes gauge\nchat_memoria_limite_bytes %zu\n"
+           "# HELP chat_memoria_bytes_por_conexao Custo fixo de cada conexao (slabs e pilha)\n"
+           "# TYPE chat_memoria_bytes_por_conexao gauge\nchat_memoria_bytes_por_conexao %zu\n"
+           "# HELP chat_memoria_mapeada_bytes Bytes mapeados pelos slabs\n"
+           "# TYPE chat_memoria_mapeada_bytes gauge\nchat_memoria_mapeada_bytes %llu\n",
+           mem.limite, mem.por_conexao, (unsigned long long)mem.mapeados);
+    EMITIR("# HELP chat_slab_objetos Objetos por slab (em uso e capacidade mapeada)\n"
+           "# TYPE chat_slab_objetos gauge\n");
+    for (int i = 0; i < mem.num_slabs; i++) {
+        EMITIR("chat_slab_objetos{slab=\"%s\",bytes=\"%zu\",estado=\"em_uso\"} %llu\n"
+               "chat_slab_objetos{slab=\"%s\",bytes=\"%zu\",estado=\"capacidade\"} %llu\n",
+               mem.slabs[i].nome, mem.slabs[i].objeto, (unsigned long long)mem.slabs[i].em_uso,
+               mem.slabs[i].nome, mem.slabs[i].objeto, (unsigned long long)mem.slabs[i].capacidade);
+    }
+
+    uint64_t agora = metricas_agora_ns();
+    uint64_t mensagens = atomic_load(&t->contadores[METRICA_MENSAGENS]);
+    double taxa = 0.0;
+    if (ultimo_instante != 0 && agora > ultimo_instante) {
+        taxa = (double)(mensagens - ultima_contagem) * 1e9 / (double)(agora - ultimo_instante);
+    }
+    ultima_contagem = mensagens;
+    ultimo_instante = agora;
+    EMITIR("# HELP chat_mensagens_por_segundo Mensagens por segundo desde a leitura anterior\n"
+           "# TYPE chat_mensagens_por_segundo gauge\nchat_mensagens_por_segundo %.3f\n", taxa);
+
+    EMITIR("# HELP chat_clientes_conectados Conexoes no registro\n"
+           "# TYPE chat_clientes_conectados gauge\nchat_clientes_conectados %zu\n", registro_contar());
+    EMITIR("# HELP chat_fila_log_bytes Bytes ocupados na fila de mensagens de log\n"
+           "# TYPE chat_fila_log_bytes gauge\nchat_fila_log_bytes %zu\n",
+           tsqueue_bytes_pendentes(&msg_queue));
+    EMITIR("# HELP chat_fila_log_capacidade_bytes Capacidade da fila de mensagens de log\n"
+           "# TYPE chat_fila_log_capacidade_bytes gauge\nchat_fila_log_capacidade_bytes %zu\n",
+           msg_queue.capacidade);
+
+    static const double quantis[] = { 0.5, 0.9, 0.99, 0.999 };
+    EMITIR("# HELP chat_broadcast_fanout_segundos Tempo para enfileirar um broadcast a todos os destinatarios\n"
+           "# TYPE chat_broadcast_fanout_segundos summary\n");
+    for (size_t i = 0; i < sizeof(quantis) / sizeof(quantis[0]); i++) {
+        EMITIR("chat_broadcast_fanout_segundos{quantile=\"%g\"} %.9f\n", quantis[i],
+               fanout_percentil(t, quantis[i]) / 1e9);
+    }
+    EMITIR("chat_broadcast_fanout_segundos_sum %.9f\nchat_broadcast_fanout_segundos_count %llu\n",
+           atomic_load(&t->fanout_soma_ns) / 1e9, (unsigned long long)atomic_load(&t->fanout_contagem));
+#undef EMITIR
+
+    free(t);
+    return n < max ? n : max - 1;
+}
+
+/**
+ * GET /trace: intervalos do rastro em JSON Chrome trace (404 sem RASTRO)
+ */
+static void atender_rastro(int fd) {
+    static const char desativado[] = "Rastro desativado: compile com make RASTRO=1\n";
+    char *corpo = NULL;
+    size_t tamanho = 0;
+    FILE *f = open_memstream(&corpo, &tamanho);
+    long n = f ? rastro_exportar(f) : -1;
+    if (f != NULL) {
+        fclose(f);
+    }
+
+    const char *dados = n >= 0 ? corpo : desativado;
+    size_t len = n >= 0 ? tamanho : sizeof(desativado) - 1;
+    char cabecalho[256];
+    int h = snprintf(cabecalho, sizeof(cabecalho),
+                     "HTTP/1.0 %s\r\nContent-Type: %s\r\n"
+                     "Content-Length: %zu\r\nConnection: close\r\n\r\n",
+                     n >= 0 ? "200 OK" : "404 Not Found",
+                     n >= 0 ? "application/json" : "text/plain", len);
+    send(fd, cabecalho, (size_t)h, MSG_NOSIGNAL);
+    send(fd, dados, len, MSG_NOSIGNAL);
+    free(corpo);
+}
+
+/**
+ * Atende uma requisição HTTP: GET /metrics devolve o texto, GET /trace o
+ * rastro, o resto é 404
+ */
+static void atender(int fd) {
+    struct timeval limite = { 1, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &limite, sizeof(limite));
+
+    char pedido[1024];
+    ssize_t lidos = recv(fd, pedido, sizeof(pedido) - 1, 0);
+    if (lidos <= 0) {
+        return;
+    }
+    pedido[lidos] = '\0';
+    if (strncmp(pedido, "GET /trace ", 11) == 0) {
+        atender_rastro(fd);
+        return;
+    }
+
+    char *corpo = malloc(METRICAS_RESPOSTA_MAX);
+    if (corpo == NULL) {
+        return;
+    }
+    char cabecalho[256];
+    size_t tamanho = 0;
+    int ok = strncmp(pedido, "GET /metrics ", 13) == 0 || strncmp(pedido, "GET / ", 6) == 0;
+    if (ok) {
+        tamanho = metricas_formatar(corpo, METRICAS_RESPOSTA_MAX);
+    }
+    int n = snprintf(cabecalho, sizeof(cabecalho),
+                     "HTTP/1.0 %s\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                     "Content-Length: %zu\r\nConnection: close\r\n\r\n",
+                     ok ? "200 OK" : "404 Not Found", tamanho);
+    send(fd, cabecalho, (size_t)n, MSG_NOSIGNAL);
+    if (tamanho > 0) {
+        send(fd, corpo, tamanho, MSG_NOSIGNAL);
+    }
+    free(corpo);
+}
+
+/**
+ * Thread do listener de administração (uma requisição por vez, fora do chat)
+ */
+static void *admin_loop(void *arg) {
+    (void)arg;
+    while (!shutdown_requested) {
+        fd_set leitura;
+        FD_ZERO(&leitura);
+        FD_SET(admin_fd, &leitura);
+        struct timeval timeout = { 1, 0 };
+        int atividade = select(admin_fd + 1, &leitura, NULL, NULL, &timeout);
+        if (atividade <= 0) {
+            continue;
+        }
+        int fd = accept(admin_fd, NULL, NULL);
+        if (fd < 0) {
+            continue;
+        }
+        atender(fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+int metricas_iniciar(int porta) {
+    if (porta == 0) {
+        return 0;
+    }
+    admin_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (admin_fd < 0) {
+        return -1;
+    }
+    int opt = 1;
+    setsockopt(admin_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((uint16_t)porta);
+    if (bind(admin_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(admin_fd, 16) < 0 ||
+        pthread_create(&admin_tid, NULL, admin_loop, NULL) != 0) {
+        int err = errno;
+        close(admin_fd);
+        admin_fd = -1;
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+void metricas_encerrar(void) {
+    if (admin_fd < 0) {
+        return;
+    }
+    shutdown(admin_fd, SHUT_RDWR);  // acorda o select da thread
+    pthread_join(admin_tid, NULL);
+    close(admin_fd);
+    admin_fd = -1;
+}
@@ -0,0 +1,634 @@
+#define _GNU_SOURCE
+#include "../include/pool.h"
+#include "../include/servidor.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#define POOL_MAX_EVENTOS 256
+#define POOL_TIMEOUT_MS 1000
+#define POOL_PILHA_KB_MIN 64
+#define AGENDADA (1u << 31)     // em eventos: tarefa na deque ou em execução
+
+// Estado da conexão no pool (em c->transporte)
+typedef struct pool_conexao {
+    conexao_t *c;
+    atomic_uint eventos;         // eventos epoll ainda não tratados | AGENDADA
+    atomic_int refs;             // registro no epoll + tarefa agendada
+    atomic_int worker;           // último worker que a atendeu (afinidade)
+    int iniciada;                // já passou pelo add_client e pelo anúncio
+    int fechada;
+    struct pool_conexao *ant;    // lista de todas (só a thread de despacho)
+    struct pool_conexao *prox;
+    struct pool_conexao *prox_fechada;
+} pool_conexao_t;
+
+// Deque de tarefas de um worker: o dono consome pela frente (ordem de
+// chegada, justa entre conexões) e os ladrões levam do fim
+typedef struct {
+    pthread_mutex_t mutex;
+    pool_conexao_t **itens;
+    size_t capacidade;           // potência de 2
+    size_t inicio;
+    size_t quantidade;
+} deque_t;
+
+typedef struct {
+    pthread_t tid;
+    int indice;
+    deque_t deque;
+    laco_t laco;
+    uint64_t executadas;
+    uint64_t roubadas;
+} worker_t;
+
+typedef struct {
+    int epfd;
+    int listen_fd;
+    laco_t laco;                 // dono das conexões entre uma tarefa e outra
+    worker_t *workers;
+    int num_workers;
+    unsigned proximo;            // worker inicial das novas conexões (rodízio)
+
+    pthread_mutex_t ocioso_mutex;
+    pthread_cond_t ocioso_cond;
+    int ociosos;
+    atomic_size_t pendentes;     // tarefas nas deques
+
+    pthread_mutex_t fechadas_mutex;
+    pool_conexao_t *fechadas;    // já fora do epoll, liberadas na próxima volta do despacho
+    pool_conexao_t *todas;
+    slab_t *slab;                // estado das conexões (fixo por conexão)
+} pool_t;
+
+static pool_t pool;
+
+// Sentinela em data.ptr para o socket Unix (data.ptr == NULL é o socket TCP)
+static conexao_t sentinela_local;
+
+static int deque_iniciar(deque_t *d) {
+    pthread_mutex_init(&d->mutex, NULL);
+    d->itens = malloc(POOL_DEQUE_INICIAL * sizeof(pool_conexao_t *));
+    if (d->itens == NULL) {
+        return -1;
+    }
+    d->capacidade = POOL_DEQUE_INICIAL;
+    d->inicio = 0;
+    d->quantidade = 0;
+    return 0;
+}
+
+static void deque_liberar(deque_t *d) {
+    pthread_mutex_destroy(&d->mutex);
+    free(d->itens);
+}
+
+static int deque_empurrar(deque_t *d, pool_conexao_t *pc) {
+    pthread_mutex_lock(&d->mutex);
+    if (d->quantidade == d->capacidade) {
+        size_t nova = d->capacidade * 2;
+        pool_conexao_t **itens = malloc(nova * sizeof(pool_conexao_t *));
+        if (itens == NULL) {
+            pthread_mutex_unlock(&d->mutex);
+            return -1;
+        }
+        for (size_t i = 0; i < d->quantidade; i++) {
+            itens[i] = d->itens[(d->inicio + i) & (d->capacidade - 1)];
+        }
+        free(d->itens);
+        d->itens = itens;
+        d->capacidade = nova;
+        d->inicio = 0;
+    }
+    d->itens[(d->inicio + d->quantidade) & (d->capacidade - 1)] = pc;
+    d->quantidade++;
+    pthread_mutex_unlock(&d->mutex);
+    return 0;
+}
+
+// Retira pela frente (dono) ou pelo fim (roubo); NULL se vazia
+static pool_conexao_t *deque_retirar(deque_t *d, int roubo) {
+    pool_conexao_t *pc = NULL;
+    pthread_mutex_lock(&d->mutex);
+    if (d->quantidade > 0) {
+        d->quantidade--;
+        if (roubo) {
+            pc = d->itens[(d->inicio + d->quantidade) & (d->capacidade - 1)];
+        } else {
+            pc = d->itens[d->inicio];
+            d->inicio = (d->inicio + 1) & (d->capacidade - 1);
+        }
+    }
+    pthread_mutex_unlock(&d->mutex);
+    return pc;
+}
+
+static void pc_unref(pool_conexao_t *pc) {
+    if (atomic_fetch_sub(&pc->refs, 1) == 1) {
+        pc->c->transporte = NULL;
+        conexao_unref(pc->c);
+        slab_liberar(pool.slab, pc);
+    }
+}
+
+/**
+ * Coloca a tarefa na deque do último worker da conexão e acorda um ocioso
+ * (a referência da tarefa já foi tomada pelo chamador)
+ */
+static void enfileirar_tarefa(pool_conexao_t *pc) {
+    int w = atomic_load_explicit(&pc->worker, memory_order_relaxed);
+    if (deque_empurrar(&pool.workers[w].deque, pc) != 0) {
+        log_server_error("deque de tarefas do pool", errno);
+        conexao_encerrar(pc->c);
+        pc_unref(pc);
+        return;
+    }
+    atomic_fetch_add(&pool.pendentes, 1);
+
+    pthread_mutex_lock(&pool.ocioso_mutex);
+    if (pool.ociosos > 0) {
+        pthread_cond_signal(&pool.ocioso_cond);
+    }
+    pthread_mutex_unlock(&pool.ocioso_mutex);
+}
+
+/**
+ * Acumula os eventos; só quem liga AGENDADA cria a tarefa, então a conexão
+ * tem no máximo uma tarefa na fila ou em execução
+ */
+static void despachar(pool_conexao_t *pc, uint32_t eventos) {
+    uint32_t antes = atomic_fetch_or(&pc->eventos, eventos | AGENDADA);
+    if (!(antes & AGENDADA)) {
+        atomic_fetch_add(&pc->refs, 1);
+        enfileirar_tarefa(pc);
+    }
+}
+
+/**
+ * Encerra a conexão no worker; a estrutura do pool só é liberada pela
+ * thread de despacho, depois de um epoll_wait que já não pode devolvê-la
+ */
+static void fechar(pool_conexao_t *pc, int registrada) {
+    conexao_t *c = pc->c;
+    pc->fechada = 1;
+    if (registrada) {
+        close_client(c);
+    } else {
+        epoll_ctl(c->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+        conexao_encerrar(c);
+        conexao_unref(c);
+    }
+
+    pthread_mutex_lock(&pool.fechadas_mutex);
+    pc->prox_fechada = pool.fechadas;
+    pool.fechadas = pc;
+    pthread_mutex_unlock(&pool.fechadas_mutex);
+}
+
+static void atender(pool_conexao_t *pc, uint32_t eventos) {
+    conexao_t *c = pc->c;
+
+    // Primeira tarefa: entrada no registro e anúncio
+    if (!pc->iniciada) {
+        pc->iniciada = 1;
+        if (add_client(c) != 0) {
+            reject_client(c->fd);
+            fechar(pc, 0);
+            return;
+        }
+        if (announce_client_join(c) != 0) {
+            fechar(pc, 1);
+            return;
+        }
+        printf("👥 Clientes conectados: %d/%zu (pool)\n", count_connected_clients(), registro_limite());
+    }
+    if (eventos != 0 && handle_client_event(c, eventos) < 0) {
+        fechar(pc, 1);
+    }
+}
+
+/**
+ * Executa uma rodada da conexão com o worker como laço dono. Se chegaram
+ * eventos durante a rodada, a conexão volta para o fim da deque em vez de
+ * prender o worker (as demais conexões não esperam por uma muito ativa).
+ */
+static void executar(worker_t *w, pool_conexao_t *pc) {
+    conexao_t *c = pc->c;
+    atomic_store_explicit(&pc->worker, w->indice, memory_order_relaxed);
+
+    uint32_t eventos = atomic_exchange(&pc->eventos, AGENDADA) & ~AGENDADA;
+    if (!pc->fechada) {
+        conexao_definir_laco(c, &w->laco);
+        atender(pc, eventos);
+        laco_descarregar(&w->laco);
+        conexao_definir_laco(c, &pool.laco);
+    }
+    w->executadas++;
+
+    // Suspensa pelo limite de taxa: a tarefa fica estacionada nas suspensas
+    // do worker (AGENDADA continua ligada, então nenhum evento cria outra)
+    if (!pc->fechada && c->retomar_ns != 0) {
+        return;
+    }
+
+    uint32_t esperado = AGENDADA;
+    if (!atomic_compare_exchange_strong(&pc->eventos, &esperado, 0)) {
+        enfileirar_tarefa(pc);  // a referência da tarefa segue com ela
+        return;
+    }
+    pc_unref(pc);
+}
+
+/**
+ * Devolve à deque as tarefas estacionadas cuja suspensão terminou (todas =
+ * shutdown: só solta as referências)
+ */
+static void retomar_estacionadas(worker_t *w, int todas) {
+    for (conexao_t *c; (c = laco_retomar(&w->laco, todas)) != NULL;) {
+        pool_conexao_t *pc = c->transporte;
+        conexao_unref(c);
+        if (todas) {
+            pc_unref(pc);
+            continue;
+        }
+        atomic_fetch_or(&pc->eventos, EPOLLIN);
+        enfileirar_tarefa(pc);  // a referência da tarefa segue com ela
+    }
+}
+
+static pool_conexao_t *roubar(worker_t *w) {
+    for (int i = 1; i < pool.num_workers; i++) {
+        worker_t *vitima = &pool.workers[(w->indice + i) % pool.num_workers];
+        pool_conexao_t *pc = deque_retirar(&vitima->deque, 1);
+        if (pc != NULL) {
+            w->roubadas++;
+            return pc;
+        }
+    }
+    return NULL;
+}
+
+static void *worker_loop(void *arg) {
+    worker_t *w = arg;
+    laco_definir_atual(&w->laco);
+    RASTRO_NOMEAR("worker");
+
+    while (1) {
+        retomar_estacionadas(w, 0);
+        pool_conexao_t *pc = deque_retirar(&w->deque, 0);
+        if (pc == NULL) {
+            pc = roubar(w);
+        }
+        if (pc != NULL) {
+            atomic_fetch_sub(&pool.pendentes, 1);
+            executar(w, pc);
+            continue;
+        }
+        if (shutdown_requested) {
+            break;
+        }
+
+        // Sem tarefas: dorme até um despacho ou o prazo de um adiado
+        pthread_mutex_lock(&pool.ocioso_mutex);
+        if (atomic_load(&pool.pendentes) == 0 && !shutdown_requested) {
+            int espera = laco_espera_ms(&w->laco, POOL_TIMEOUT_MS);
+            struct timespec limite;
+            clock_gettime(CLOCK_REALTIME, &limite);
+            limite.tv_sec += espera / 1000;
+            limite.tv_nsec += (long)(espera % 1000) * 1000000L;
+            if (limite.tv_nsec >= 1000000000L) {
+                limite.tv_sec++;
+                limite.tv_nsec -= 1000000000L;
+            }
+            pool.ociosos++;
+            pthread_cond_timedwait(&pool.ocioso_cond, &pool.ocioso_mutex, &limite);
+            pool.ociosos--;
+        }
+        pthread_mutex_unlock(&pool.ocioso_mutex);
+        laco_descarregar(&w->laco);
+    }
+
+    retomar_estacionadas(w, 1);
+    laco_finalizar(&w->laco);
+    laco_definir_atual(NULL);
+    return NULL;
+}
+
+static void aceitar(int listen_fd) {
+    while (1) {
+        struct sockaddr_storage addr;
+        socklen_t addr_len = sizeof(addr);
+        int client_fd = accept4(listen_fd, (struct sockaddr *)&addr, &addr_len,
+                                SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                log_server_error("accept", errno);
+            }
+            return;
+        }
+
+        if (registro_contar() >= registro_limite()) {
+            reject_client(client_fd);
+            close(client_fd);
+            continue;
+        }
+
+        // Socket Unix: sem endereço (conexao_criar usa o id no lugar)
+        conexao_t *c = conexao_criar(client_fd, addr.ss_family == AF_INET ?
+                                     (const struct sockaddr_in *)&addr : NULL);
+        if (c == NULL) {
+            log_server_error("alocação da conexão", errno);
+            close(client_fd);
+            continue;
+        }
+        pool_conexao_t *pc = slab_alocar(pool.slab);
+        if (pc == NULL) {
+            log_server_error("alocação da conexão", errno);
+            conexao_unref(c);
+            continue;
+        }
+        memset(pc, 0, sizeof(*pc));
+
+        // A referência de criação sai no close_client; o pool guarda a sua
+        conexao_ref(c);
+        pc->c = c;
+        c->transporte = pc;
+        atomic_init(&pc->eventos, AGENDADA);
+        atomic_init(&pc->refs, 2);  // epoll + primeira tarefa
+        atomic_init(&pc->worker, (int)(pool.proximo++ % (unsigned)pool.num_workers));
+        if (conexao_registrar(c, &pool.laco) < 0) {
+            log_server_error("epoll_ctl ADD", errno);
+            c->transporte = NULL;
+            slab_liberar(pool.slab, pc);
+            conexao_unref(c);
+            conexao_unref(c);
+            continue;
+        }
+
+        pc->prox = pool.todas;
+        if (pool.todas) {
+            pool.todas->ant = pc;
+        }
+        pool.todas = pc;
+
+        // A primeira tarefa registra e anuncia o cliente; eventos que chegarem
+        // antes dela ficam acumulados
+        enfileirar_tarefa(pc);
+    }
+}
+
+/**
+ * Adota uma conexão herdada no hot upgrade: já entra iniciada, sem tarefa de
+ * anúncio; a saída herdada arma EPOLLOUT e o despacho cria a primeira tarefa
+ */
+static void adotar(herdada_t *h) {
+    conexao_t *c = h->c;
+    pool_conexao_t *pc = slab_alocar(pool.slab);
+    if (pc == NULL) {
+        log_server_error("alocação da conexão", errno);
+        transferencia_descartar(h);
+        return;
+    }
+    memset(pc, 0, sizeof(*pc));
+
+    conexao_ref(c);
+    pc->c = c;
+    c->transporte = pc;
+    pc->iniciada = 1;
+    atomic_init(&pc->eventos, 0);
+    atomic_init(&pc->refs, 1);  // epoll
+    atomic_init(&pc->worker, (int)(pool.proximo++ % (unsigned)pool.num_workers));
+    if (transferencia_adotar(h, &pool.laco) == NULL) {
+        c->transporte = NULL;
+        slab_liberar(pool.slab, pc);
+        conexao_unref(c);
+        return;
+    }
+
+    pc->prox = pool.todas;
+    if (pool.todas) {
+        pool.todas->ant = pc;
+    }
+    pool.todas = pc;
+}
+
+/**
+ * Libera a referência do epoll das conexões fechadas até agora (chamar
+ * antes do epoll_wait: nenhum evento pendente pode mais apontar para elas)
+ */
+static void coletar_fechadas(void) {
+    pthread_mutex_lock(&pool.fechadas_mutex);
+    pool_conexao_t *pc = pool.fechadas;
+    pool.fechadas = NULL;
+    pthread_mutex_unlock(&pool.fechadas_mutex);
+
+    while (pc) {
+        pool_conexao_t *prox = pc->prox_fechada;
+        if (pc->ant) {
+            pc->ant->prox = pc->prox;
+        } else {
+            pool.todas = pc->prox;
+        }
+        if (pc->prox) {
+            pc->prox->ant = pc->ant;
+        }
+        pc_unref(pc);
+        pc = prox;
+    }
+}
+
+static int pool_iniciar(int listen_fd, int workers, size_t pilha) {
+    memset(&pool, 0, sizeof(pool));
+    pool.listen_fd = listen_fd;
+    pool.num_workers = workers;
+    pool.slab = slab_criar("pool", sizeof(pool_conexao_t), 1);
+    if (pool.slab == NULL) {
+        log_server_error("slab das conexões do pool", ENOMEM);
+        return -1;
+    }
+
+    int flags = fcntl(listen_fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(listen_fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        log_server_error("fcntl O_NONBLOCK", errno);
+        return -1;
+    }
+
+    pool.epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (pool.epfd < 0) {
+        log_server_error("epoll_create1", errno);
+        return -1;
+    }
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(pool.epfd, EPOLL_CTL_ADD, listen_fd, &ev) < 0) {
+        log_server_error("epoll_ctl ADD (escuta)", errno);
+        close(pool.epfd);
+        return -1;
+    }
+    int local_fd = local_escuta();
+    if (local_fd >= 0) {
+        flags = fcntl(local_fd, F_GETFL, 0);
+        ev.data.ptr = &sentinela_local;
+        if (flags < 0 || fcntl(local_fd, F_SETFL, flags | O_NONBLOCK) < 0 ||
+            epoll_ctl(pool.epfd, EPOLL_CTL_ADD, local_fd, &ev) < 0) {
+            log_server_error("epoll_ctl ADD (socket Unix)", errno);
+        }
+    }
+    laco_iniciar(&pool.laco, pool.epfd);
+
+    pthread_mutex_init(&pool.ocioso_mutex, NULL);
+    pthread_cond_init(&pool.ocioso_cond, NULL);
+    pthread_mutex_init(&pool.fechadas_mutex, NULL);
+    atomic_init(&pool.pendentes, 0);
+
+    pool.workers = calloc((size_t)workers, sizeof(worker_t));
+    if (pool.workers == NULL) {
+        log_server_error("alocação dos workers", errno);
+        close(pool.epfd);
+        return -1;
+    }
+    for (int i = 0; i < workers; i++) {
+        pool.workers[i].indice = i;
+        laco_iniciar(&pool.workers[i].laco, pool.epfd);
+        if (deque_iniciar(&pool.workers[i].deque) != 0) {
+            // Nenhum worker foi criado: desfaz aqui, antes do pool_liberar
+            log_server_error("alocação das deques", errno);
+            for (int j = 0; j <= i; j++) {
+                deque_liberar(&pool.workers[j].deque);
+            }
+            free(pool.workers);
+            pool.workers = NULL;
+            pool.num_workers = 0;
+            close(pool.epfd);
+            return -1;
+        }
+    }
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (pthread_attr_setstacksize(&attr, pilha) != 0) {
+        log_server_error("tamanho de pilha dos workers", EINVAL);
+    }
+    for (int i = 0; i < workers; i++) {
+        int err = pthread_create(&pool.workers[i].tid, &attr, worker_loop, &pool.workers[i]);
+        if (err != 0) {
+            log_server_error("criação dos workers", err);
+            shutdown_requested = 1;
+            pool.num_workers = i;
+            break;
+        }
+    }
+    pthread_attr_destroy(&attr);
+    return pool.num_workers == workers ? 0 : -1;
+}
+
+/**
+ * Shutdown: acorda e espera os workers, descarta as tarefas que sobraram e
+ * encerra as conexões ainda abertas
+ */
+static void pool_liberar(int workers) {
+    pthread_mutex_lock(&pool.ocioso_mutex);
+    pthread_cond_broadcast(&pool.ocioso_cond);
+    pthread_mutex_unlock(&pool.ocioso_mutex);
+
+    uint64_t executadas = 0, roubadas = 0;
+    for (int i = 0; i < pool.num_workers; i++) {
+        pthread_join(pool.workers[i].tid, NULL);
+        executadas += pool.workers[i].executadas;
+        roubadas += pool.workers[i].roubadas;
+    }
+    for (int i = 0; i < workers; i++) {
+        pool_conexao_t *pc;
+        while ((pc = deque_retirar(&pool.workers[i].deque, 0)) != NULL) {
+            pc_unref(pc);
+        }
+    }
+
+    // No hot upgrade até as que não chegaram à primeira tarefa passam adiante
+    laco_definir_atual(&pool.laco);
+    for (pool_conexao_t *pc = pool.todas; pc; pc = pc->prox) {
+        if (!pc->fechada) {
+            fechar(pc, pc->iniciada || transferencia_ativa());
+        }
+    }
+    laco_finalizar(&pool.laco);
+    laco_definir_atual(NULL);
+    coletar_fechadas();
+
+    char stats_msg[150];
+    snprintf(stats_msg, sizeof(stats_msg), "Pool: %llu tarefas em %d workers (%llu roubadas)",
+             (unsigned long long)executadas, pool.num_workers, (unsigned long long)roubadas);
+    tsqueue_push(&msg_queue, stats_msg);
+
+    for (int i = 0; i < workers; i++) {
+        deque_liberar(&pool.workers[i].deque);
+    }
+    free(pool.workers);
+    pthread_mutex_destroy(&pool.ocioso_mutex);
+    pthread_cond_destroy(&pool.ocioso_cond);
+    pthread_mutex_destroy(&pool.fechadas_mutex);
+    close(pool.epfd);
+}
+
+int pool_executar(int listen_fd, int workers, size_t pilha) {
+    if (workers <= 0) {
+        long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = ncpus > 0 ? (int)ncpus : 1;
+    }
+    if (pilha < POOL_PILHA_KB_MIN * 1024) {
+        pilha = POOL_PILHA_KB_MIN * 1024;
+    }
+
+    int resultado = pool_iniciar(listen_fd, workers, pilha);
+    if (pool.workers == NULL) {
+        return -1;
+    }
+
+    // Conexões herdadas de um hot upgrade
+    for (herdada_t *h; resultado == 0 && (h = transferencia_proxima()) != NULL;) {
+        adotar(h);
+    }
+
+    struct epoll_event eventos[POOL_MAX_EVENTOS];
+    while (resultado == 0 && !shutdown_requested) {
+        coletar_fechadas();
+
+        // Conexões removidas cujo período de graça já terminou
+        registro_coletar();
+
+        int n = epoll_wait(pool.epfd, eventos, POOL_MAX_EVENTOS, POOL_TIMEOUT_MS);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            log_server_error("epoll_wait", errno);
+            resultado = -1;
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            conexao_t *c = eventos[i].data.ptr;
+            if (c == NULL) {
+                aceitar(pool.listen_fd);
+            } else if (c == &sentinela_local) {
+                aceitar(local_escuta());
+            } else if (c->transporte != NULL) {
+                despachar(c->transporte, eventos[i].events);
+            }
+        }
+    }
+
+    pool_liberar(workers);
+    return resultado;
+}
@@ -0,0 +1,202 @@
+#include "../include/protocolo.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+
+/**
+ * Inicializa o buffer circular de recepção
+ * @return 0 em sucesso, -1 em erro
+ */
+int proto_ring_init(proto_ring_t *r, size_t capacidade) {
+    if ((capacidade & (capacidade - 1)) != 0 || capacidade < PROTO_CABECALHO + PROTO_MAX_PAYLOAD) {
+        errno = EINVAL;
+        return -1;
+    }
+    r->dados = malloc(capacidade);
+    r->quadro = malloc(PROTO_MAX_PAYLOAD);
+    if (r->dados == NULL || r->quadro == NULL) {
+        free(r->dados);
+        free(r->quadro);
+        return -1;
+    }
+    r->capacidade = capacidade;
+    r->inicio = 0;
+    r->fim = 0;
+    return 0;
+}
+
+/**
+ * Inicializa o anel sem alocar (conexões vindas do slab)
+ * @return 0 em sucesso, -1 se a capacidade é inválida
+ */
+int proto_ring_usar(proto_ring_t *r, size_t capacidade, char *dados, char *quadro) {
+    if ((capacidade & (capacidade - 1)) != 0 || capacidade < PROTO_CABECALHO + PROTO_MAX_PAYLOAD) {
+        errno = EINVAL;
+        return -1;
+    }
+    r->dados = dados;
+    r->quadro = quadro;
+    r->capacidade = capacidade;
+    r->inicio = 0;
+    r->fim = 0;
+    return 0;
+}
+
+void proto_ring_destroy(proto_ring_t *r) {
+    free(r->dados);
+    free(r->quadro);
+    r->dados = NULL;
+    r->quadro = NULL;
+}
+
+/**
+ * Lê do socket diretamente para o espaço livre do anel (até dois segmentos)
+ */
+ssize_t proto_ring_ler(proto_ring_t *r, int fd) {
+    size_t livre = r->capacidade - (r->fim - r->inicio);
+    if (livre == 0) {
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    size_t pos = r->fim & (r->capacidade - 1);
+    size_t ate_fim = r->capacidade - pos;
+    struct iovec iov[2];
+    int iovcnt = 1;
+
+    iov[0].iov_base = r->dados + pos;
+    iov[0].iov_len = livre < ate_fim ? livre : ate_fim;
+    if (livre > ate_fim) {
+        iov[1].iov_base = r->dados;
+        iov[1].iov_len = livre - ate_fim;
+        iovcnt = 2;
+    }
+
+    ssize_t n = readv(fd, iov, iovcnt);
+    if (n > 0) {
+        r->fim += (size_t)n;
+    }
+    return n;
+}
+
+/**
+ * Copia para o espaço livre do anel (até dois segmentos)
+ */
+size_t proto_ring_escrever(proto_ring_t *r, const char *dados, size_t n) {
+    size_t livre = r->capacidade - (r->fim - r->inicio);
+    if (n > livre) {
+        n = livre;
+    }
+
+    size_t pos = r->fim & (r->capacidade - 1);
+    size_t ate_fim = r->capacidade - pos;
+    if (n <= ate_fim) {
+        memcpy(r->dados + pos, dados, n);
+    } else {
+        memcpy(r->dados + pos, dados, ate_fim);
+        memcpy(r->dados, dados + ate_fim, n - ate_fim);
+    }
+    r->fim += n;
+    return n;
+}
+
+/**
+ * Copia len bytes a partir do índice lógico idx, tratando a volta do anel
+ */
+static void copiar_do_anel(const proto_ring_t *r, size_t idx, char *dst, size_t len) {
+    size_t pos = idx & (r->capacidade - 1);
+    size_t ate_fim = r->capacidade - pos;
+    if (len <= ate_fim) {
+        memcpy(dst, r->dados + pos, len);
+    } else {
+        memcpy(dst, r->dados + pos, ate_fim);
+        memcpy(dst + ate_fim, r->dados, len - ate_fim);
+    }
+}
+
+/**
+ * Extrai o próximo quadro do anel. Quadros contíguos são devolvidos sem cópia;
+ * apenas quadros que cruzam o fim do anel são copiados para r->quadro.
+ */
+int proto_proximo_quadro(proto_ring_t *r, const char **payload, size_t *tamanho) {
+    size_t disponivel = r->fim - r->inicio;
+    if (disponivel < PROTO_CABECALHO) {
+        return 0;
+    }
+
+    uint32_t cabecalho;
+    copiar_do_anel(r, r->inicio, (char *)&cabecalho, PROTO_CABECALHO);
+    size_t len = ntohl(cabecalho);
+    if (len > PROTO_MAX_PAYLOAD) {
+        return -1;
+    }
+    if (disponivel < PROTO_CABECALHO + len) {
+        return 0;
+    }
+
+    size_t idx = r->inicio + PROTO_CABECALHO;
+    size_t pos = idx & (r->capacidade - 1);
+    if (pos + len <= r->capacidade) {
+        *payload = r->dados + pos;
+    } else {
+        copiar_do_anel(r, idx, r->quadro, len);
+        *payload = r->quadro;
+    }
+    *tamanho = len;
+    r->inicio += PROTO_CABECALHO + len;
+
+    // Anel vazio: volta ao início para manter os próximos quadros contíguos
+    if (r->inicio == r->fim) {
+        r->inicio = 0;
+        r->fim = 0;
+    }
+    return 1;
+}
+
+size_t proto_codificar(char *dst, const char *payload, size_t tamanho) {
+    uint32_t cabecalho = htonl((uint32_t)tamanho);
+    memcpy(dst, &cabecalho, PROTO_CABECALHO);
+    memcpy(dst + PROTO_CABECALHO, payload, tamanho);
+    return PROTO_CABECALHO + tamanho;
+}
+
+/**
+ * Envia cabeçalho e payload com writev, repetindo em escritas parciais
+ */
+int proto_enviar(int fd, const char *payload, size_t tamanho) {
+    uint32_t cabecalho = htonl((uint32_t)tamanho);
+    struct iovec iov[2];
+    iov[0].iov_base = &cabecalho;
+    iov[0].iov_len = PROTO_CABECALHO;
+    iov[1].iov_base = (void *)payload;
+    iov[1].iov_len = tamanho;
+
+    struct iovec *atual = iov;
+    int iovcnt = 2;
+    while (iovcnt > 0) {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = atual;
+        msg.msg_iovlen = iovcnt;
+        ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        while (iovcnt > 0 && (size_t)n >= atual->iov_len) {
+            n -= atual->iov_len;
+            atual++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            atual->iov_base = (char *)atual->iov_base + n;
+            atual->iov_len -= n;
+        }
+    }
+    return 0;
+}
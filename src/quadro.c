@@ -0,0 +1,38 @@
+#include "../include/quadro.h"
+#include "../include/protocolo.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Aloca e codifica um quadro (payload truncado em PROTO_MAX_PAYLOAD)
+ * @return quadro com uma referência ou NULL sem memória
+ */
+quadro_t *quadro_criar(const char *payload, size_t tamanho) {
+    if (tamanho > PROTO_MAX_PAYLOAD) {
+        tamanho = PROTO_MAX_PAYLOAD;
+    }
+    quadro_t *q = malloc(sizeof(quadro_t) + PROTO_CABECALHO + tamanho);
+    if (q == NULL) {
+        return NULL;
+    }
+    atomic_init(&q->refs, 1);
+    q->tamanho = proto_codificar(q->dados, payload, tamanho);
+    return q;
+}
+
+quadro_t *quadro_copiar(const char *dados, size_t tamanho) {
+    quadro_t *q = malloc(sizeof(quadro_t) + tamanho);
+    if (q == NULL) {
+        return NULL;
+    }
+    atomic_init(&q->refs, 1);
+    q->tamanho = tamanho;
+    memcpy(q->dados, dados, tamanho);
+    return q;
+}
+
+void quadro_unref(quadro_t *q) {
+    if (atomic_fetch_sub_explicit(&q->refs, 1, memory_order_acq_rel) == 1) {
+        free(q);
+    }
+}
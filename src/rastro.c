@@ -0,0 +1,241 @@
+#define _GNU_SOURCE
+#include "../include/rastro.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#ifdef RASTRO
+
+#include <sys/syscall.h>
+
+_Thread_local rastro_anel_t *rastro_anel_atual = NULL;
+
+static _Atomic(rastro_anel_t *) aneis = NULL;
+static pthread_key_t chave;
+static pthread_once_t chave_criada = PTHREAD_ONCE_INIT;
+
+// Conversão de ticks para ns (rdtsc calibrado contra CLOCK_MONOTONIC)
+static double ns_por_tick = 1.0;
+static uint64_t tick_base = 0;
+static uint64_t ns_base = 0;
+
+static int gatilho[2] = { -1, -1 };     // self-pipe: handler de sinal -> gravador
+static pthread_t gravador_tid;
+static void (*avisar_gravacao)(const char *msg) = NULL;
+
+static uint64_t agora_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Thread terminou: o anel (com os intervalos dela) passa para a próxima
+static void anel_liberar(void *arg) {
+    rastro_anel_t *a = arg;
+    atomic_store(&a->livre, 1);
+}
+
+static void criar_chave(void) {
+    pthread_key_create(&chave, anel_liberar);
+}
+
+rastro_anel_t *rastro_anel_obter(void) {
+    pthread_once(&chave_criada, criar_chave);
+
+    rastro_anel_t *a = NULL;
+    for (rastro_anel_t *p = atomic_load(&aneis); p != NULL; p = p->prox) {
+        int livre = 1;
+        if (atomic_compare_exchange_strong(&p->livre, &livre, 0)) {
+            a = p;
+            break;
+        }
+    }
+    if (a == NULL) {
+        a = calloc(1, sizeof(*a));
+        if (a == NULL) {
+            return NULL;
+        }
+        a->prox = atomic_load(&aneis);
+        while (!atomic_compare_exchange_weak(&aneis, &a->prox, a)) {
+        }
+    }
+    a->tid = (uint32_t)syscall(SYS_gettid);
+    a->nome[0] = '\0';
+    rastro_anel_atual = a;
+    pthread_setspecific(chave, a);
+    return a;
+}
+
+void rastro_nomear(const char *nome) {
+    rastro_anel_t *a = rastro_anel_atual ? rastro_anel_atual : rastro_anel_obter();
+    if (a != NULL) {
+        snprintf(a->nome, sizeof(a->nome), "%s", nome);
+    }
+}
+
+static void calibrar(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    uint64_t ns0 = agora_ns();
+    uint64_t t0 = __rdtsc();
+    struct timespec espera = { 0, 20 * 1000000L };
+    nanosleep(&espera, NULL);
+    uint64_t ns1 = agora_ns();
+    uint64_t t1 = __rdtsc();
+    if (t1 > t0) {
+        ns_por_tick = (double)(ns1 - ns0) / (double)(t1 - t0);
+    }
+    tick_base = t1;
+    ns_base = ns1;
+#endif
+}
+
+static double tick_para_us(uint64_t tick) {
+    return ((double)ns_base + (double)(int64_t)(tick - tick_base) * ns_por_tick) / 1000.0;
+}
+
+long rastro_exportar(FILE *saida) {
+    rastro_span_t *copia = malloc(sizeof(rastro_span_t) * RASTRO_SPANS);
+    if (copia == NULL) {
+        return -1;
+    }
+    int pid = (int)getpid();
+    long total = 0;
+    const char *sep = "";
+
+    fprintf(saida, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    for (rastro_anel_t *a = atomic_load(&aneis); a != NULL; a = a->prox) {
+        if (a->nome[0] != '\0' && !atomic_load(&a->livre)) {
+            fprintf(saida, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,"
+                           "\"args\":{\"name\":\"%s\"}}",
+                    sep, pid, a->tid, a->nome);
+            sep = ",";
+        }
+
+        // Copia sem parar a dona; o que ela pode ter sobrescrito durante a
+        // cópia (cabeça final - capacidade) é descartado
+        uint64_t cabeca = atomic_load_explicit(&a->cabeca, memory_order_acquire);
+        uint64_t inicio = cabeca > RASTRO_SPANS ? cabeca - RASTRO_SPANS : 0;
+        for (uint64_t i = inicio; i < cabeca; i++) {
+            copia[i - inicio] = a->spans[i & (RASTRO_SPANS - 1)];
+        }
+        atomic_thread_fence(memory_order_acquire);
+        uint64_t depois = atomic_load_explicit(&a->cabeca, memory_order_relaxed);
+
+        for (uint64_t i = inicio; i < cabeca; i++) {
+            if (i + RASTRO_SPANS <= depois) {
+                continue;
+            }
+            const rastro_span_t *s = &copia[i - inicio];
+            fprintf(saida, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,"
+                           "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"n\":%llu}}",
+                    sep, s->nome, pid, s->tid, tick_para_us(s->inicio),
+                    (double)s->duracao * ns_por_tick / 1000.0, (unsigned long long)s->arg);
+            sep = ",";
+            total++;
+        }
+    }
+    fprintf(saida, "\n]}\n");
+    free(copia);
+    return total;
+}
+
+static void gravar(int numero) {
+    char arquivo[64];
+    char aviso[160];
+    snprintf(arquivo, sizeof(arquivo), "rastro-%d-%d.json", (int)getpid(), numero);
+
+    FILE *f = fopen(arquivo, "w");
+    long n = f ? rastro_exportar(f) : -1;
+    if (f != NULL && fclose(f) != 0) {
+        n = -1;
+    }
+    if (n < 0) {
+        snprintf(aviso, sizeof(aviso), "Rastro: falha ao gravar %s (%s)", arquivo, strerror(errno));
+    } else {
+        snprintf(aviso, sizeof(aviso), "Rastro: %ld intervalos gravados em %s", n, arquivo);
+    }
+    if (avisar_gravacao != NULL) {
+        avisar_gravacao(aviso);
+    }
+}
+
+static void *gravador_loop(void *arg) {
+    (void)arg;
+    int numero = 0;
+    while (1) {
+        char comando;
+        ssize_t n = read(gatilho[0], &comando, 1);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0 || comando == 'F') {
+            break;
+        }
+        gravar(++numero);
+    }
+    return NULL;
+}
+
+int rastro_iniciar(void (*avisar)(const char *msg)) {
+    avisar_gravacao = avisar;
+    calibrar();
+    if (pipe2(gatilho, O_CLOEXEC) != 0) {
+        return -1;
+    }
+    int err = pthread_create(&gravador_tid, NULL, gravador_loop, NULL);
+    if (err != 0) {
+        close(gatilho[0]);
+        close(gatilho[1]);
+        gatilho[0] = gatilho[1] = -1;
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+void rastro_sinal(void) {
+    if (gatilho[1] >= 0) {
+        char comando = 'G';
+        ssize_t escrito = write(gatilho[1], &comando, 1);
+        (void)escrito;
+    }
+}
+
+void rastro_encerrar(void) {
+    int escrita = gatilho[1];
+    if (escrita < 0) {
+        return;
+    }
+    gatilho[1] = -1;  // sinais daqui em diante são ignorados
+    char comando = 'F';
+    if (write(escrita, &comando, 1) == 1) {
+        pthread_join(gravador_tid, NULL);
+    }
+    close(gatilho[0]);
+    close(escrita);
+    gatilho[0] = -1;
+}
+
+#else
+
+int rastro_iniciar(void (*avisar)(const char *msg)) {
+    (void)avisar;
+    return 0;
+}
+
+void rastro_sinal(void) {
+}
+
+long rastro_exportar(FILE *saida) {
+    (void)saida;
+    errno = ENOTSUP;
+    return -1;
+}
+
+void rastro_encerrar(void) {
+}
+
+#endif
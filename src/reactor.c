@@ -0,0 +1,324 @@
+#define _GNU_SOURCE
+#include "../include/reactor.h"
+#include "../include/servidor.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define MAX_EVENTOS 256
+#define EPOLL_TIMEOUT_MS 1000
+
+typedef struct {
+    int id;
+    laco_t laco;          // epoll do reactor e conexões com saída pendente
+    int epfd;
+    int listen_fd;
+    int cpu;              // CPU fixada (-1 = sem afinidade)
+    pthread_t tid;
+    conexao_t *conexoes;  // lista duplamente encadeada das conexões deste reactor
+} reactor_t;
+
+static reactor_t *reactors = NULL;
+
+// Sentinela em data.ptr para o socket Unix do reactor 0 (data.ptr == NULL é
+// o socket de escuta TCP)
+static conexao_t sentinela_local;
+
+/**
+ * Coloca o descritor em modo não-bloqueante
+ */
+static int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) {
+        return -1;
+    }
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+/**
+ * Encerra uma conexão: tira da lista do reactor e libera a referência do dono
+ */
+static void fechar_conexao(reactor_t *r, conexao_t *c) {
+    if (c->ant) {
+        c->ant->prox = c->prox;
+    } else {
+        r->conexoes = c->prox;
+    }
+    if (c->prox) {
+        c->prox->ant = c->ant;
+    }
+    c->ant = NULL;
+    c->prox = NULL;
+
+    close_client(c);
+}
+
+/**
+ * Aceita todas as conexões pendentes (necessário com edge-triggered)
+ */
+static void aceitar_conexoes(reactor_t *r, int listen_fd) {
+    while (1) {
+        struct sockaddr_in addr;
+        socklen_t addr_len = sizeof(addr);
+        int client_fd = accept4(listen_fd, (struct sockaddr *)&addr, &addr_len,
+                                SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                log_server_error("accept", errno);
+            }
+            return;
+        }
+
+        // Verificar se há slots disponíveis
+        if (registro_contar() >= registro_limite()) {
+            reject_client(client_fd);
+            close(client_fd);
+            continue;
+        }
+
+        conexao_t *c = conexao_criar(client_fd, &addr);
+        if (c == NULL) {
+            log_server_error("alocação da conexão", errno);
+            close(client_fd);
+            continue;
+        }
+        // Registrar no epoll antes de entrar na lista (ver handle_client)
+        if (conexao_registrar(c, &r->laco) < 0) {
+            log_server_error("epoll_ctl ADD", errno);
+            conexao_unref(c);
+            continue;
+        }
+        if (add_client(c) != 0) {
+            reject_client(c->fd);
+            conexao_encerrar(c);
+            conexao_unref(c);
+            continue;
+        }
+
+        c->prox = r->conexoes;
+        if (r->conexoes) {
+            r->conexoes->ant = c;
+        }
+        r->conexoes = c;
+
+        if (announce_client_join(c) != 0) {
+            fechar_conexao(r, c);
+            continue;
+        }
+        printf("👥 Clientes conectados: %d/%zu (reactor %d)\n",
+               count_connected_clients(), registro_limite(), r->id);
+    }
+}
+
+/**
+ * Adota uma conexão herdada no hot upgrade (antes de o reactor rodar)
+ */
+static void adotar_conexao(reactor_t *r, herdada_t *h) {
+    conexao_t *c = transferencia_adotar(h, &r->laco);
+    if (c == NULL) {
+        return;
+    }
+    c->prox = r->conexoes;
+    if (r->conexoes) {
+        r->conexoes->ant = c;
+    }
+    r->conexoes = c;
+}
+
+/**
+ * Prepara epoll e socket de escuta de um reactor
+ * @return 0 em sucesso, -1 em erro
+ */
+static int reactor_preparar(reactor_t *r) {
+    r->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (r->epfd < 0) {
+        log_server_error("epoll_create1", errno);
+        return -1;
+    }
+
+    if (set_nonblocking(r->listen_fd) < 0) {
+        log_server_error("fcntl O_NONBLOCK", errno);
+        close(r->epfd);
+        return -1;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(r->epfd, EPOLL_CTL_ADD, r->listen_fd, &ev) < 0) {
+        log_server_error("epoll_ctl ADD (escuta)", errno);
+        close(r->epfd);
+        return -1;
+    }
+
+    // O socket Unix não tem SO_REUSEPORT: só o primeiro reactor aceita nele
+    int local_fd = local_escuta();
+    if (r->id == 0 && local_fd >= 0) {
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.ptr = &sentinela_local;
+        if (set_nonblocking(local_fd) < 0 || epoll_ctl(r->epfd, EPOLL_CTL_ADD, local_fd, &ev) < 0) {
+            log_server_error("epoll_ctl ADD (socket Unix)", errno);
+        }
+    }
+
+    laco_iniciar(&r->laco, r->epfd);
+    return 0;
+}
+
+/**
+ * Libera os recursos de um reactor após o término do seu loop
+ */
+static void reactor_liberar(reactor_t *r) {
+    // Conexões ainda abertas no shutdown saem da lista e têm o socket fechado
+    laco_definir_atual(&r->laco);
+    while (r->conexoes) {
+        fechar_conexao(r, r->conexoes);
+    }
+    laco_finalizar(&r->laco);
+    laco_definir_atual(NULL);
+    close(r->epfd);
+}
+
+/**
+ * Event loop de um reactor: atende o próprio socket de escuta e as próprias
+ * conexões com recv/send não-bloqueantes.
+ */
+static void *reactor_loop(void *arg) {
+    reactor_t *r = arg;
+    laco_definir_atual(&r->laco);
+    RASTRO_NOMEAR("reactor");
+
+    if (r->cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(r->cpu, &cpus);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (err != 0) {
+            log_server_error("pthread_setaffinity_np", err);
+        }
+    }
+
+    struct epoll_event eventos[MAX_EVENTOS];
+    while (!shutdown_requested) {
+        int n = epoll_wait(r->epfd, eventos, MAX_EVENTOS, laco_espera_ms(&r->laco, EPOLL_TIMEOUT_MS));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            log_server_error("epoll_wait", errno);
+            break;
+        }
+
+        for (int i = 0; i < n && !shutdown_requested; i++) {
+            conexao_t *c = eventos[i].data.ptr;
+            if (c == NULL) {
+                aceitar_conexoes(r, r->listen_fd);
+                continue;
+            }
+            if (c == &sentinela_local) {
+                aceitar_conexoes(r, local_escuta());
+                continue;
+            }
+
+            // EPOLLHUP/EPOLLERR também são tratados pela leitura (recv retorna 0 ou erro)
+            if (handle_client_event(c, eventos[i].events) < 0) {
+                fechar_conexao(r, c);
+            }
+        }
+
+        // Conexões cuja suspensão pelo limite de taxa terminou
+        for (conexao_t *c; (c = laco_retomar(&r->laco, 0)) != NULL;) {
+            if (resume_client(c) < 0) {
+                fechar_conexao(r, c);
+            }
+            conexao_unref(c);
+        }
+
+        // Um único flush por conexão com tudo o que foi enfileirado nesta iteração
+        laco_descarregar(&r->laco);
+
+        // Conexões removidas cujo período de graça já terminou
+        registro_coletar();
+    }
+
+    laco_definir_atual(NULL);
+    return NULL;
+}
+
+/**
+ * Executa n reactors, cada um com seu próprio socket de escuta (SO_REUSEPORT)
+ * e seu próprio conjunto de clientes. Bloqueia até o shutdown.
+ * @param listen_fds vetor com n sockets de escuta
+ * @param n número de reactors
+ * @param fixar_cpu se diferente de zero, fixa o reactor i na CPU i (módulo nº de CPUs)
+ * @return 0 ao finalizar normalmente, -1 em erro de inicialização
+ */
+int reactor_executar(const int *listen_fds, int n, int fixar_cpu) {
+    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpus < 1) {
+        ncpus = 1;
+    }
+
+    reactors = calloc(n, sizeof(reactor_t));
+    if (reactors == NULL) {
+        log_server_error("alocação dos reactors", errno);
+        return -1;
+    }
+
+    int preparados = 0;
+    for (; preparados < n; preparados++) {
+        reactor_t *r = &reactors[preparados];
+        r->id = preparados;
+        r->listen_fd = listen_fds[preparados];
+        r->cpu = fixar_cpu ? (int)(preparados % ncpus) : -1;
+        if (reactor_preparar(r) != 0) {
+            break;
+        }
+    }
+    if (preparados < n) {
+        for (int i = 0; i < preparados; i++) {
+            reactor_liberar(&reactors[i]);
+        }
+        free(reactors);
+        reactors = NULL;
+        return -1;
+    }
+
+    // Conexões herdadas de um hot upgrade, em rodízio entre os reactors
+    int k = 0;
+    for (herdada_t *h; (h = transferencia_proxima()) != NULL; k++) {
+        adotar_conexao(&reactors[k % n], h);
+    }
+
+    int iniciados = 0;
+    for (; iniciados < n; iniciados++) {
+        if (pthread_create(&reactors[iniciados].tid, NULL, reactor_loop, &reactors[iniciados]) != 0) {
+            log_server_error("criação da thread do reactor", errno);
+            shutdown_requested = 1;
+            break;
+        }
+    }
+
+    for (int i = 0; i < iniciados; i++) {
+        pthread_join(reactors[i].tid, NULL);
+    }
+
+    for (int i = 0; i < n; i++) {
+        reactor_liberar(&reactors[i]);
+    }
+    free(reactors);
+    reactors = NULL;
+    return iniciados == n ? 0 : -1;
+}
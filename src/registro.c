@@ -0,0 +1,335 @@
+#include "../include/registro.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sched.h>
+
+#define HANDLE_INDICE(h) ((uint32_t)((h) & 0xffffffffu))
+#define HANDLE_GERACAO(h) ((uint32_t)((h) >> 32))
+#define HANDLE(geracao, indice) (((uint64_t)(geracao) << 32) | (uint64_t)(indice))
+
+// Tabela lida pelos leitores; trocada inteira (e aposentada) ao crescer
+typedef struct {
+    size_t capacidade;
+    _Atomic(conexao_t *) slots[];
+} tabela_t;
+
+// Leitor registrado (uma entrada por thread que já leu o registro)
+typedef struct leitor {
+    struct leitor *prox;
+    atomic_int em_uso;
+    atomic_uint_fast64_t epoca;     // 0 = fora da seção de leitura
+    int profundidade;               // seções aninhadas (só a thread dona usa)
+} leitor_t;
+
+// Objeto removido aguardando o fim do período de graça
+typedef struct {
+    void *ptr;
+    void (*liberar)(void *ptr);
+    uint64_t epoca;
+} aposentado_t;
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;   // só escritores
+static _Atomic(tabela_t *) tabela = NULL;
+static atomic_size_t usados = 0;      // maior índice já usado + 1 (limite da varredura)
+static atomic_size_t total = 0;
+static size_t limite = 0;
+
+// Estado dos escritores (protegido pelo mutex)
+static uint32_t *geracoes = NULL;
+static uint32_t *livres = NULL;
+static size_t num_livres = 0;
+static aposentado_t *aposentados = NULL;
+static size_t num_aposentados = 0;
+static size_t cap_aposentados = 0;
+
+// Épocas
+static atomic_uint_fast64_t epoca_global = 1;
+static _Atomic(leitor_t *) leitores = NULL;
+static _Thread_local leitor_t *leitor_atual = NULL;
+static pthread_key_t chave_leitor;
+
+static void leitor_devolver(void *ptr) {
+    leitor_t *l = ptr;
+    atomic_store(&l->em_uso, 0);
+}
+
+/**
+ * Entrada de leitor da thread atual (reaproveita entradas de threads encerradas)
+ */
+static leitor_t *leitor_obter(void) {
+    if (leitor_atual != NULL) {
+        return leitor_atual;
+    }
+
+    leitor_t *l;
+    for (l = atomic_load(&leitores); l; l = l->prox) {
+        int livre = 0;
+        if (atomic_compare_exchange_strong(&l->em_uso, &livre, 1)) {
+            break;
+        }
+    }
+    if (l == NULL) {
+        l = calloc(1, sizeof(leitor_t));
+        if (l == NULL) {
+            return NULL;
+        }
+        atomic_init(&l->em_uso, 1);
+        atomic_init(&l->epoca, 0);
+        l->prox = atomic_load(&leitores);
+        while (!atomic_compare_exchange_weak(&leitores, &l->prox, l)) {
+        }
+    }
+    leitor_atual = l;
+    pthread_setspecific(chave_leitor, l);
+    return l;
+}
+
+static void tabela_liberar(void *ptr) {
+    free(ptr);
+}
+
+static void conexao_liberar(void *ptr) {
+    conexao_unref(ptr);
+}
+
+/**
+ * Libera os aposentados que nenhum leitor ativo pode mais enxergar
+ * (chamar com o mutex travado)
+ */
+static void coletar(void) {
+    if (num_aposentados == 0) {
+        return;
+    }
+
+    // Menor época entre os leitores dentro da seção de leitura
+    atomic_thread_fence(memory_order_seq_cst);
+    uint64_t minima = UINT64_MAX;
+    for (leitor_t *l = atomic_load(&leitores); l; l = l->prox) {
+        uint64_t e = atomic_load(&l->epoca);
+        if (e != 0 && e < minima) {
+            minima = e;
+        }
+    }
+
+    size_t mantidos = 0;
+    for (size_t i = 0; i < num_aposentados; i++) {
+        if (aposentados[i].epoca < minima) {
+            aposentados[i].liberar(aposentados[i].ptr);
+        } else {
+            aposentados[mantidos++] = aposentados[i];
+        }
+    }
+    num_aposentados = mantidos;
+}
+
+/**
+ * Espera todos os leitores que estão na seção de leitura agora saírem dela
+ */
+static void sincronizar(void) {
+    uint64_t alvo = atomic_fetch_add(&epoca_global, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+    for (leitor_t *l = atomic_load(&leitores); l; l = l->prox) {
+        uint64_t e;
+        while ((e = atomic_load(&l->epoca)) != 0 && e <= alvo) {
+            sched_yield();
+        }
+    }
+}
+
+/**
+ * Adia a liberação até o fim do período de graça (chamar com o mutex travado)
+ */
+static void aposentar(void *ptr, void (*liberar)(void *)) {
+    if (num_aposentados == cap_aposentados) {
+        size_t nova = cap_aposentados ? cap_aposentados * 2 : 64;
+        aposentado_t *v = realloc(aposentados, nova * sizeof(aposentado_t));
+        if (v == NULL) {
+            // Sem memória para adiar: espera os leitores atuais saírem
+            sincronizar();
+            liberar(ptr);
+            return;
+        }
+        aposentados = v;
+        cap_aposentados = nova;
+    }
+    // A época atual marca o aposentado; leitores que entrarem depois do
+    // incremento já não o encontram na tabela
+    aposentados[num_aposentados].ptr = ptr;
+    aposentados[num_aposentados].liberar = liberar;
+    aposentados[num_aposentados].epoca = atomic_fetch_add(&epoca_global, 1);
+    num_aposentados++;
+}
+
+int registro_iniciar(size_t max_conexoes) {
+    pthread_key_create(&chave_leitor, leitor_devolver);
+
+    tabela_t *t = calloc(1, sizeof(tabela_t) + REGISTRO_CAPACIDADE_INICIAL * sizeof(conexao_t *));
+    geracoes = malloc(REGISTRO_CAPACIDADE_INICIAL * sizeof(uint32_t));
+    livres = malloc(REGISTRO_CAPACIDADE_INICIAL * sizeof(uint32_t));
+    if (t == NULL || geracoes == NULL || livres == NULL) {
+        free(t);
+        free(geracoes);
+        free(livres);
+        return -1;
+    }
+    t->capacidade = REGISTRO_CAPACIDADE_INICIAL;
+    for (size_t i = 0; i < REGISTRO_CAPACIDADE_INICIAL; i++) {
+        geracoes[i] = 1;
+    }
+    atomic_store(&tabela, t);
+    limite = max_conexoes;
+    return 0;
+}
+
+/**
+ * Dobra a tabela (chamar com o mutex travado); a antiga é aposentada porque
+ * leitores podem estar no meio de uma varredura nela
+ */
+static int crescer(void) {
+    tabela_t *antiga = atomic_load(&tabela);
+    size_t nova_cap = antiga->capacidade * 2;
+
+    tabela_t *nova = calloc(1, sizeof(tabela_t) + nova_cap * sizeof(conexao_t *));
+    uint32_t *g = realloc(geracoes, nova_cap * sizeof(uint32_t));
+    if (g != NULL) {
+        geracoes = g;
+    }
+    uint32_t *l = realloc(livres, nova_cap * sizeof(uint32_t));
+    if (l != NULL) {
+        livres = l;
+    }
+    if (nova == NULL || g == NULL || l == NULL) {
+        free(nova);
+        return -1;
+    }
+
+    nova->capacidade = nova_cap;
+    for (size_t i = 0; i < antiga->capacidade; i++) {
+        atomic_init(&nova->slots[i], atomic_load(&antiga->slots[i]));
+    }
+    for (size_t i = antiga->capacidade; i < nova_cap; i++) {
+        geracoes[i] = 1;
+    }
+    atomic_store(&tabela, nova);
+    aposentar(antiga, tabela_liberar);
+    return 0;
+}
+
+int registro_inserir(conexao_t *c) {
+    pthread_mutex_lock(&mutex);
+    if (atomic_load(&total) >= limite) {
+        pthread_mutex_unlock(&mutex);
+        return -1;
+    }
+
+    // Slot livre ou o próximo nunca usado
+    uint32_t indice;
+    if (num_livres > 0) {
+        indice = livres[--num_livres];
+    } else {
+        size_t n = atomic_load(&usados);
+        if (n == atomic_load(&tabela)->capacidade && crescer() != 0) {
+            pthread_mutex_unlock(&mutex);
+            return -1;
+        }
+        indice = (uint32_t)n;
+        atomic_store(&usados, n + 1);
+    }
+
+    conexao_ref(c);
+    c->handle = HANDLE(geracoes[indice], indice);
+    atomic_store(&atomic_load(&tabela)->slots[indice], c);
+    atomic_fetch_add(&total, 1);
+    coletar();
+    pthread_mutex_unlock(&mutex);
+    return 0;
+}
+
+int registro_remover(conexao_t *c) {
+    registro_handle_t h = c->handle;
+    uint32_t indice = HANDLE_INDICE(h);
+
+    pthread_mutex_lock(&mutex);
+    tabela_t *t = atomic_load(&tabela);
+    if (h == REGISTRO_HANDLE_INVALIDO || indice >= atomic_load(&usados) ||
+        geracoes[indice] != HANDLE_GERACAO(h) || atomic_load(&t->slots[indice]) != c) {
+        pthread_mutex_unlock(&mutex);
+        return -1;
+    }
+
+    atomic_store(&t->slots[indice], NULL);
+    // Nova geração invalida o handle antigo (0 fica reservado para inválido)
+    if (++geracoes[indice] == 0) {
+        geracoes[indice] = 1;
+    }
+    livres[num_livres++] = indice;
+    atomic_fetch_sub(&total, 1);
+    c->handle = REGISTRO_HANDLE_INVALIDO;
+
+    aposentar(c, conexao_liberar);
+    coletar();
+    pthread_mutex_unlock(&mutex);
+    return 0;
+}
+
+conexao_t *registro_obter(registro_handle_t h) {
+    uint32_t indice = HANDLE_INDICE(h);
+    conexao_t *c = NULL;
+
+    pthread_mutex_lock(&mutex);
+    if (h != REGISTRO_HANDLE_INVALIDO && indice < atomic_load(&usados) &&
+        geracoes[indice] == HANDLE_GERACAO(h)) {
+        c = atomic_load(&atomic_load(&tabela)->slots[indice]);
+        if (c != NULL) {
+            conexao_ref(c);
+        }
+    }
+    pthread_mutex_unlock(&mutex);
+    return c;
+}
+
+size_t registro_contar(void) {
+    return atomic_load(&total);
+}
+
+size_t registro_limite(void) {
+    return limite;
+}
+
+void registro_para_cada(void (*fn)(conexao_t *c, void *arg), void *arg) {
+    leitor_t *l = leitor_obter();
+    if (l == NULL) {
+        return;
+    }
+
+    // Anuncia a época antes de ler a tabela (par com a cerca em coletar)
+    if (l->profundidade++ == 0) {
+        atomic_store(&l->epoca, atomic_load(&epoca_global));
+        atomic_thread_fence(memory_order_seq_cst);
+    }
+
+    tabela_t *t = atomic_load_explicit(&tabela, memory_order_acquire);
+    size_t n = atomic_load(&usados);
+    if (n > t->capacidade) {
+        n = t->capacidade;
+    }
+    for (size_t i = 0; i < n; i++) {
+        conexao_t *c = atomic_load_explicit(&t->slots[i], memory_order_acquire);
+        if (c != NULL) {
+            fn(c, arg);
+        }
+    }
+
+    if (--l->profundidade == 0) {
+        atomic_store_explicit(&l->epoca, 0, memory_order_release);
+    }
+}
+
+void registro_coletar(void) {
+    if (pthread_mutex_trylock(&mutex) == 0) {
+        coletar();
+        pthread_mutex_unlock(&mutex);
+    }
+}
@@ -0,0 +1,364 @@
+#include "../include/salas.h"
+#include "../include/metricas.h"
+#include "../include/federacao.h"
+#include "../include/difusao.h"
+#include "../include/rastro.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+static sala_t *tabela[SALAS_BUCKETS];
+static pthread_mutex_t tabela_mutex = PTHREAD_MUTEX_INITIALIZER;
+static size_t historico_quadros = SALA_HISTORICO_PADRAO;
+static size_t historico_bytes = SALA_HISTORICO_BYTES_PADRAO;
+
+void sala_configurar_historico(size_t quadros, size_t bytes) {
+    historico_quadros = bytes ? quadros : 0;
+    historico_bytes = bytes;
+}
+
+/**
+ * Hash FNV-1a do nome da sala
+ */
+static size_t bucket_de(const char *nome) {
+    uint32_t h = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)nome; *p; p++) {
+        h = (h ^ *p) * 16777619u;
+    }
+    return h % SALAS_BUCKETS;
+}
+
+int sala_nome_valido(const char *nome, size_t tamanho) {
+    if (tamanho == 0 || tamanho >= SALA_NOME_MAX) {
+        return 0;
+    }
+    for (size_t i = 0; i < tamanho; i++) {
+        unsigned char ch = (unsigned char)nome[i];
+        if (!isalnum(ch) && ch != '-' && ch != '_') {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Procura a sala; se não existir, cria (chamar com tabela_mutex travado)
+ */
+static sala_t *sala_obter(const char *nome) {
+    size_t b = bucket_de(nome);
+    for (sala_t *s = tabela[b]; s; s = s->prox) {
+        if (strcmp(s->nome, nome) == 0) {
+            return s;
+        }
+    }
+
+    sala_t *s = calloc(1, sizeof(sala_t));
+    if (s == NULL) {
+        return NULL;
+    }
+    strncpy(s->nome, nome, SALA_NOME_MAX - 1);
+    pthread_mutex_init(&s->mutex, NULL);
+    pthread_mutex_init(&s->ordem, NULL);
+    atomic_init(&s->mensagens, 0);
+    atomic_init(&s->entregas, 0);
+    s->prox = tabela[b];
+    tabela[b] = s;
+    return s;
+}
+
+/**
+ * Libera uma sala vazia (chamar com tabela_mutex travado)
+ */
+static void sala_liberar(sala_t *s) {
+    sala_t **pp = &tabela[bucket_de(s->nome)];
+    while (*pp && *pp != s) {
+        pp = &(*pp)->prox;
+    }
+    if (*pp) {
+        *pp = s->prox;
+    }
+    // Uma entrega federada pode estar em curso com a sala já vazia; fora da
+    // tabela, ninguém mais a encontra
+    pthread_mutex_lock(&s->ordem);
+    pthread_mutex_unlock(&s->ordem);
+    pthread_mutex_destroy(&s->ordem);
+    pthread_mutex_destroy(&s->mutex);
+    for (size_t i = 0; i < s->hist_quantidade; i++) {
+        quadro_unref(s->historico[(s->hist_inicio + i) % historico_quadros]);
+    }
+    free(s->historico);
+    free(s->membros);
+    free(s);
+}
+
+/**
+ * Guarda o quadro no fim do histórico, removendo os mais antigos até caber
+ * nos limites de quantidade e bytes (chamar com o mutex da sala travado)
+ */
+static void historico_guardar(sala_t *s, quadro_t *q) {
+    if (historico_quadros == 0 || q->tamanho > historico_bytes) {
+        return;
+    }
+    if (s->historico == NULL) {
+        s->historico = malloc(historico_quadros * sizeof(quadro_t *));
+        if (s->historico == NULL) {
+            return;
+        }
+    }
+    while (s->hist_quantidade == historico_quadros || s->hist_bytes + q->tamanho > historico_bytes) {
+        quadro_t *antigo = s->historico[s->hist_inicio];
+        s->hist_bytes -= antigo->tamanho;
+        quadro_unref(antigo);
+        s->hist_inicio = (s->hist_inicio + 1) % historico_quadros;
+        s->hist_quantidade--;
+    }
+    s->historico[(s->hist_inicio + s->hist_quantidade) % historico_quadros] = quadro_ref(q);
+    s->hist_quantidade++;
+    s->hist_bytes += q->tamanho;
+}
+
+/**
+ * Enfileira o histórico para quem acabou de entrar (chamar com o mutex da
+ * sala travado, na mesma seção que o inclui nos membros: broadcasts
+ * anteriores vêm do histórico e os seguintes chegam depois deles). Só
+ * referências trocam de mãos; a escrita acontece no laço dono, em lote.
+ */
+static void historico_reenviar(sala_t *s, conexao_t *c) {
+    if (s->hist_quantidade == 0) {
+        return;
+    }
+    size_t primeiro = historico_quadros - s->hist_inicio;
+    if (primeiro > s->hist_quantidade) {
+        primeiro = s->hist_quantidade;
+    }
+    // O anel pode dar a volta: dois trechos contíguos
+    if (conexao_enfileirar_lote(c, s->historico + s->hist_inicio, primeiro) == primeiro) {
+        conexao_enfileirar_lote(c, s->historico, s->hist_quantidade - primeiro);
+    }
+}
+
+/**
+ * Remove a conexão do índice da sala (chamar com tabela_mutex travado)
+ */
+static void remover_membro(conexao_t *c) {
+    sala_t *s = c->sala;
+    if (s == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&s->mutex);
+    size_t i = c->indice_sala;
+    conexao_t *ultimo = s->membros[--s->num_membros];
+    s->membros[i] = ultimo;
+    ultimo->indice_sala = i;
+    size_t restantes = s->num_membros;
+    pthread_mutex_unlock(&s->mutex);
+
+    c->sala = NULL;
+    if (restantes == 0 && strcmp(s->nome, SALA_PADRAO) != 0) {
+        sala_liberar(s);
+    }
+}
+
+int sala_entrar(conexao_t *c, const char *nome) {
+    pthread_mutex_lock(&tabela_mutex);
+    sala_t *s = sala_obter(nome);
+    if (s == NULL) {
+        pthread_mutex_unlock(&tabela_mutex);
+        return -1;
+    }
+    if (c->sala == s) {
+        pthread_mutex_unlock(&tabela_mutex);
+        return 0;
+    }
+
+    pthread_mutex_lock(&s->mutex);
+    if (s->num_membros == s->capacidade) {
+        size_t nova = s->capacidade ? s->capacidade * 2 : SALA_CAPACIDADE_INICIAL;
+        conexao_t **v = realloc(s->membros, nova * sizeof(conexao_t *));
+        if (v == NULL) {
+            pthread_mutex_unlock(&s->mutex);
+            if (s->num_membros == 0 && strcmp(s->nome, SALA_PADRAO) != 0) {
+                sala_liberar(s);
+            }
+            pthread_mutex_unlock(&tabela_mutex);
+            return -1;
+        }
+        s->membros = v;
+        s->capacidade = nova;
+    }
+    pthread_mutex_unlock(&s->mutex);
+
+    // Sai da sala anterior antes de aparecer na nova
+    remover_membro(c);
+
+    pthread_mutex_lock(&s->mutex);
+    c->indice_sala = s->num_membros;
+    s->membros[s->num_membros++] = c;
+    historico_reenviar(s, c);
+    pthread_mutex_unlock(&s->mutex);
+    c->sala = s;
+
+    pthread_mutex_unlock(&tabela_mutex);
+    return 0;
+}
+
+void sala_sair(conexao_t *c) {
+    if (c->sala == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&tabela_mutex);
+    remover_membro(c);
+    pthread_mutex_unlock(&tabela_mutex);
+}
+
+/**
+ * Guarda o quadro no histórico e o enfileira para uma cópia dos membros (em
+ * fatias paralelas nas salas acima do limiar). A cópia leva uma referência
+ * de cada membro e a entrega acontece com o mutex solto: entradas, saídas e
+ * listagens não esperam o fan-out. Quem sai durante a entrega ainda recebe
+ * a mensagem em curso; quem entra a recebe pelo histórico.
+ * Chamar com o mutex de ordem da sala travado.
+ * @return quantidade de membros que receberam
+ */
+static int difundir(sala_t *s, quadro_t *q, const conexao_t *excluir) {
+    conexao_t *locais[SALA_COPIA_LOCAL];
+    conexao_t **copia = locais;
+
+    pthread_mutex_lock(&s->mutex);
+    size_t n = s->num_membros;
+    if (n > SALA_COPIA_LOCAL) {
+        copia = malloc(n * sizeof(conexao_t *));
+    }
+    if (copia == NULL) {
+        // Sem memória para a cópia: entrega com os membros travados
+        int entregues = difusao_entregar(s->membros, n, q, excluir);
+        historico_guardar(s, q);
+        pthread_mutex_unlock(&s->mutex);
+        return entregues;
+    }
+    for (size_t i = 0; i < n; i++) {
+        copia[i] = s->membros[i];
+        conexao_ref(copia[i]);
+    }
+    historico_guardar(s, q);
+    pthread_mutex_unlock(&s->mutex);
+
+    int entregues = difusao_entregar(copia, n, q, excluir);
+    for (size_t i = 0; i < n; i++) {
+        conexao_unref(copia[i]);
+    }
+    if (copia != locais) {
+        free(copia);
+    }
+    return entregues;
+}
+
+static void contar_broadcast(sala_t *s, int entregues) {
+    metricas_somar(METRICA_BROADCASTS, 1);
+    metricas_somar(METRICA_ENTREGAS, (uint64_t)entregues);
+    atomic_fetch_add(&s->mensagens, 1);
+    atomic_fetch_add(&s->entregas, (uint_fast64_t)entregues);
+}
+
+int sala_broadcast(conexao_t *c, const char *msg, size_t tamanho, int excluir_remetente) {
+    sala_t *s = c->sala;
+    if (s == NULL) {
+        return 0;
+    }
+
+    quadro_t *q = quadro_criar(msg, tamanho);
+    if (q == NULL) {
+        return 0;
+    }
+
+    // A sala não some durante o envio: o remetente é membro dela
+    uint64_t inicio = metricas_agora_ns();
+    RASTRO_INICIO(rastro);
+    pthread_mutex_lock(&s->ordem);
+    int entregues = difundir(s, q, excluir_remetente ? c : NULL);
+    pthread_mutex_unlock(&s->ordem);
+    RASTRO_FIM(rastro, "broadcast", entregues);
+    metricas_registrar_fanout(metricas_agora_ns() - inicio);
+    quadro_unref(q);
+
+    contar_broadcast(s, entregues);
+    federacao_publicar(s->nome, msg, tamanho);
+    return entregues;
+}
+
+int sala_difundir(const char *nome, const char *msg, size_t tamanho) {
+    quadro_t *q = quadro_criar(msg, tamanho);
+    if (q == NULL) {
+        return 0;
+    }
+
+    // Sem remetente local: a sala é segurada pelo mutex de ordem, tomado antes
+    // de soltar a tabela (quem a libera espera por ele)
+    pthread_mutex_lock(&tabela_mutex);
+    sala_t *s = tabela[bucket_de(nome)];
+    while (s && strcmp(s->nome, nome) != 0) {
+        s = s->prox;
+    }
+    if (s == NULL) {
+        pthread_mutex_unlock(&tabela_mutex);
+        quadro_unref(q);
+        return 0;
+    }
+    uint64_t inicio = metricas_agora_ns();
+    RASTRO_INICIO(rastro);
+    pthread_mutex_lock(&s->ordem);
+    pthread_mutex_unlock(&tabela_mutex);
+    int entregues = difundir(s, q, NULL);
+    contar_broadcast(s, entregues);
+    pthread_mutex_unlock(&s->ordem);
+    RASTRO_FIM(rastro, "broadcast_federado", entregues);
+    metricas_registrar_fanout(metricas_agora_ns() - inicio);
+    quadro_unref(q);
+    return entregues;
+}
+
+static int comparar_entregas(const void *a, const void *b) {
+    const sala_info_t *x = a;
+    const sala_info_t *y = b;
+    return (x->entregas < y->entregas) - (x->entregas > y->entregas);
+}
+
+size_t sala_listar(sala_info_t *info, size_t max) {
+    size_t n = 0;
+    size_t total = 0;
+    sala_info_t *todas = NULL;
+
+    pthread_mutex_lock(&tabela_mutex);
+    for (size_t b = 0; b < SALAS_BUCKETS; b++) {
+        for (sala_t *s = tabela[b]; s; s = s->prox) {
+            total++;
+        }
+    }
+    todas = malloc((total ? total : 1) * sizeof(sala_info_t));
+    if (todas != NULL) {
+        for (size_t b = 0; b < SALAS_BUCKETS; b++) {
+            for (sala_t *s = tabela[b]; s; s = s->prox) {
+                memcpy(todas[n].nome, s->nome, SALA_NOME_MAX);
+                pthread_mutex_lock(&s->mutex);
+                todas[n].membros = s->num_membros;
+                pthread_mutex_unlock(&s->mutex);
+                todas[n].mensagens = atomic_load(&s->mensagens);
+                todas[n].entregas = atomic_load(&s->entregas);
+                n++;
+            }
+        }
+    }
+    pthread_mutex_unlock(&tabela_mutex);
+
+    if (todas == NULL) {
+        return 0;
+    }
+    qsort(todas, n, sizeof(sala_info_t), comparar_entregas);
+    if (n > max) {
+        n = max;
+    }
+    memcpy(info, todas, n * sizeof(sala_info_t));
+    free(todas);
+    return n;
+}
@@ -1,5 +1,7 @@
-#include "../include/libtslog.h"
-#include "../include/fila_threadsafe.h" 
+#define _GNU_SOURCE
+#include "../include/servidor.h"
+#include "../include/reactor.h"
+#include "../include/protocolo.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,33 +12,47 @@
 #include <arpa/inet.h>
 #include <signal.h>
 #include <errno.h>
-
-#define PORT 8080
-#define MAX_CLIENTS 10
-#define BUFFER_SIZE 1024
+#include <getopt.h>
+#include <sys/epoll.h>
 
 static logger_t *log = NULL;
-int client_sockets[MAX_CLIENTS];
-pthread_mutex_t clients_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Marca de fim enfileirada no shutdown para encerrar a thread de logger
+#define LOGGER_FIM "\x04FIM"
+#define LOGGER_LOTE 32    // mensagens retiradas da fila por vez
 
 // Fila global de mensagens
 ThreadSafeQueue msg_queue;
 
 // Variáveis globais para controle de shutdown
-static volatile sig_atomic_t shutdown_requested = 0;
-static int server_fd_global = -1;
+volatile sig_atomic_t shutdown_requested = 0;
+int server_fd_global = -1;
 
 /**
  * Handler para sinais de shutdown (Ctrl+C, etc)
  */
 void graceful_shutdown(int sig) {
-    printf("\n🛑 Recebido sinal %d. Finalizando servidor graciosamente...\n", sig);
+    // Só funções async-signal-safe: um printf aqui pode travar no lock do
+    // stdout tomado pela thread interrompida, antes de marcar o shutdown.
+    // O socket de escuta fica aberto: os laços acordam pelo próprio timeout
+    // e o main o fecha uma única vez
+    static const char aviso[] = "\n🛑 Sinal recebido. Finalizando servidor graciosamente...\n";
+    (void)sig;
     shutdown_requested = 1;
-    
-    // Fechar socket do servidor para parar accept()
-    if (server_fd_global != -1) {
-        close(server_fd_global);
-    }
+    ssize_t escrito = write(STDOUT_FILENO, aviso, sizeof(aviso) - 1);
+    (void)escrito;
+}
+
+/**
+ * SIGUSR1: grava o rastro do caminho quente (só acorda a thread gravadora)
+ */
+static void pedir_rastro(int sig) {
+    (void)sig;
+    rastro_sinal();
+}
+
+static void avisar_rastro(const char *msg) {
+    tsqueue_push(&msg_queue, msg);
 }
 
 /**
@@ -50,266 +66,655 @@ void setup_signal_handlers() {
     
     sigaction(SIGINT, &sa, NULL);  // Ctrl+C
     sigaction(SIGTERM, &sa, NULL); // kill command
+
+    struct sigaction rastro_sa;
+    rastro_sa.sa_handler = pedir_rastro;
+    sigemptyset(&rastro_sa.sa_mask);
+    rastro_sa.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &rastro_sa, NULL);
+
+    // Escrita em socket fechado pelo cliente deve virar EPIPE, não encerrar o processo
+    signal(SIGPIPE, SIG_IGN);
 }
 
 /**
- * Marcar socket para remoção da lista
+ * Registra erro no log do servidor (usado pelos demais módulos)
  */
-void mark_socket_for_removal(int bad_socket) {
-    pthread_mutex_lock(&clients_mutex);
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (client_sockets[i] == bad_socket) {
-            client_sockets[i] = 0; // Marcar como disponível
-            close(bad_socket); // Fechar o socket problemático
-            break;
-        }
+void log_server_error(const char *operacao, int error_code) {
+    log_erro(log, operacao, error_code);
+}
+
+/**
+ * Evento no log binário: dados brutos, sem formatação no caminho quente
+ */
+int log_server_event(evento_t tipo, uint64_t cliente_id, const void *payload, size_t len) {
+    if (!log_binario_ativo(log)) {
+        return -1;
     }
-    pthread_mutex_unlock(&clients_mutex);
+    log_evento(log, (uint16_t)tipo, cliente_id, payload, len);
+    return 0;
+}
+
+/**
+ * Evento de entrada/saída com o endereço do cliente como payload
+ */
+void log_client_address(evento_t tipo, const conexao_t *c) {
+    evento_endereco_t end;
+    memset(&end, 0, sizeof(end));
+    memcpy(end.ip, c->ip, sizeof(end.ip));
+    end.porta = (uint16_t)c->porta;
+    log_server_event(tipo, c->id, &end, sizeof(end));
+}
+
+/**
+ * Marcar conexão para remoção da lista
+ */
+void mark_socket_for_removal(conexao_t *c) {
+    // Apenas interrompe o socket: o laço dono (thread ou reactor) detecta o
+    // EOF, remove da lista e libera a conexão. Fechar aqui permitiria reuso
+    // do fd enquanto o dono ainda o usa.
+    conexao_encerrar(c);
+    metricas_somar(METRICA_FALHAS_ENVIO, 1);
     
     char remove_log[100];
-    sprintf(remove_log, "Socket %d removido por erro de comunicação", bad_socket);
+    sprintf(remove_log, "Socket %d removido por erro de comunicação", c->fd);
     tsqueue_push(&msg_queue, remove_log);
 }
 
 /**
- * Broadcast: envia mensagem para todos os clientes conectados
- * Versão segura contra race conditions
+ * Thread que consome mensagens da fila e grava no log centralizado
  */
-void broadcast_message(const char *msg, int exclude_fd) {
-    int socket_copy[MAX_CLIENTS];
-    int client_count = 0;
-    
-    // Fazer cópia protegida da lista de sockets
-    pthread_mutex_lock(&clients_mutex);
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (client_sockets[i] != 0) {
-            socket_copy[client_count++] = client_sockets[i];
-        }
-    }
-    pthread_mutex_unlock(&clients_mutex);
-    
-    int sent_count = 0;
-    int failed_count = 0;
-    
-    // Enviar para a cópia (sem precisar de lock)
-    for (int i = 0; i < client_count; i++) {
-        if (socket_copy[i] != exclude_fd) {
-            int bytes_sent = send(socket_copy[i], msg, strlen(msg), MSG_DONTWAIT);
-            if (bytes_sent > 0) {
-                sent_count++;
-            } else {
-                // Verificar se é erro não-blocking ou socket fechado
-                if (bytes_sent < 0 && (errno != EAGAIN && errno != EWOULDBLOCK)) {
-                    failed_count++;
-                    // Marcar socket para remoção posterior
-                    mark_socket_for_removal(socket_copy[i]);
-                }
+void *logger_thread(void *arg) {
+    (void)arg;
+    static char lote[LOGGER_LOTE][MSG_SIZE];
+    RASTRO_NOMEAR("logger");
+    // Continua consumindo durante o shutdown: produtores bloqueados em
+    // tsqueue_push só são liberados enquanto alguém esvazia a fila
+    while (1) {
+        size_t n = tsqueue_pop_many(&msg_queue, lote, LOGGER_LOTE); // espera até ter msg
+        for (size_t i = 0; i < n; i++) {
+            if (strcmp(lote[i], LOGGER_FIM) == 0) {
+                return NULL;
             }
+            RASTRO_INICIO(escrita);
+            log_escrever_verbose(log, lote[i]);
+            printf("📜 [LoggerThread] %s\n", lote[i]);
+            RASTRO_FIM(escrita, "log", n);
         }
     }
-    
-    // Log do broadcast
-    char broadcast_log[150];
-    sprintf(broadcast_log, "Broadcast: '%s' enviado para %d/%d clientes (%d falhas)", 
-            msg, sent_count, client_count, failed_count);
-    tsqueue_push(&msg_queue, broadcast_log);
 }
 
 /**
- * Thread que consome mensagens da fila e grava no log centralizado
+ * Contador de clientes conectados
  */
-void *logger_thread(void *arg) {
-    char msg[MSG_SIZE];
-    while (!shutdown_requested) {
-        tsqueue_pop(&msg_queue, msg); // espera até ter msg
-        log_escrever_verbose(log, msg);
-        printf("📜 [LoggerThread] %s\n", msg);
-    }
-    return NULL;
+int count_connected_clients(void) {
+    return (int)registro_contar();
 }
 
 /**
- * Contador de clientes conectados
+ * Adiciona cliente ao registro (o registro guarda uma referência própria),
+ * cobrando o custo fixo da conexão do orçamento de memória; a cobrança é
+ * devolvida junto com o objeto no último conexao_unref
+ * @return 0 em sucesso, -1 se o limite de clientes ou de memória foi atingido
  */
-int count_connected_clients() {
-    pthread_mutex_lock(&clients_mutex);
-    int count = 0;
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (client_sockets[i] != 0) {
-            count++;
-        }
+int add_client(conexao_t *c) {
+    size_t custo = memoria_custo_conexao();
+    if (memoria_reservar(MEMORIA_CONEXOES, custo) != 0) {
+        return -1;
+    }
+    c->memoria = custo;
+    if (registro_inserir(c) != 0) {
+        c->memoria = 0;
+        memoria_devolver(MEMORIA_CONEXOES, custo);
+        return -1;
     }
-    pthread_mutex_unlock(&clients_mutex);
-    return count;
+    metricas_somar(METRICA_ACEITAS, 1);
+    return 0;
 }
 
 /**
- * Thread para atender um cliente 
+ * Remove cliente do registro (não fecha o socket); a referência do registro
+ * é liberada depois que nenhum broadcast em andamento pode mais vê-la
  */
-void *handle_client(void *arg) {
-    int client_fd = *(int *)arg;
-    free(arg);
-    char buffer[BUFFER_SIZE];
-    int read_size;
-    char client_ip[INET_ADDRSTRLEN];
-    struct sockaddr_in addr;
-    socklen_t addr_len = sizeof(addr);
-
-    // Obter informações do cliente
-    getpeername(client_fd, (struct sockaddr*)&addr, &addr_len);
-    inet_ntop(AF_INET, &addr.sin_addr, client_ip, INET_ADDRSTRLEN);
-    int client_port = ntohs(addr.sin_port);
-
-
-    char conn_msg[150];
-    sprintf(conn_msg, "Cliente conectado: FD=%d, IP=%s:%d", 
-            client_fd, client_ip, client_port);
-    tsqueue_push(&msg_queue, conn_msg);
+void remove_client(conexao_t *c) {
+    registro_remover(c);
+}
+
+/**
+ * Anuncia a entrada de um cliente: log, aviso aos demais e boas-vindas
+ * @return 0 em sucesso, -1 se o cliente já desconectou
+ */
+int announce_client_join(conexao_t *c) {
+    if (log_binario_ativo(log)) {
+        log_client_address(EVENTO_CONECTADO, c);
+    } else {
+        char conn_msg[150];
+        sprintf(conn_msg, "Cliente conectado: FD=%d, IP=%s:%d", 
+                c->fd, c->ip, c->porta);
+        tsqueue_push(&msg_queue, conn_msg);
+    }
     
-    // Notificar outros clientes sobre nova conexão
+    // Todo cliente começa na sala padrão
+    if (sala_entrar(c, SALA_PADRAO) != 0) {
+        return -1;
+    }
+
+    // Notificar os demais membros da sala sobre nova conexão
     char welcome_msg[BUFFER_SIZE];
-    sprintf(welcome_msg, "🟢 Novo usuário conectado: %s:%d", client_ip, client_port);
-    broadcast_message(welcome_msg, client_fd);
+    int welcome_len = sprintf(welcome_msg, "🟢 Novo usuário conectado: %s:%d", c->ip, c->porta);
+    sala_broadcast(c, welcome_msg, (size_t)welcome_len, 1);
     
     // Mensagem de boas-vindas para o novo cliente
-    char personal_welcome[100];
-    sprintf(personal_welcome, "Bem-vindo ao chat! Você está conectado como %s:%d", client_ip, client_port);
-    if (send(client_fd, personal_welcome, strlen(personal_welcome), MSG_DONTWAIT) < 0) {
+    char personal_welcome[200];
+    sprintf(personal_welcome, "Bem-vindo ao chat! Você está conectado como %s:%d na sala %s "
+            "(comandos: /entrar SALA, /sair-sala, /salas)", c->ip, c->porta, SALA_PADRAO);
+    if (conexao_enviar(c, personal_welcome, strlen(personal_welcome)) < 0) {
         // Erro ao enviar - cliente provavelmente desconectou
-        goto cleanup;
+        return -1;
     }
 
-    printf("✅ Novo cliente conectado: %s:%d\n", client_ip, client_port);
+    printf("✅ Novo cliente conectado: %s:%d\n", c->ip, c->porta);
+    return 0;
+}
 
-    while (!shutdown_requested && (read_size = recv(client_fd, buffer, BUFFER_SIZE - 1, 0)) > 0) {
-        buffer[read_size] = '\0';
-        
-        // Verificar se é comando de saída
-        if (strcmp(buffer, "sair") == 0 || strcmp(buffer, "/quit") == 0) {
-            break;
+/**
+ * Troca o cliente de sala avisando a sala antiga e a nova
+ */
+static void change_room(conexao_t *c, const char *nome) {
+    char aviso[BUFFER_SIZE];
+    int aviso_len;
+
+    if (c->sala != NULL && strcmp(c->sala->nome, nome) == 0) {
+        return;
+    }
+    if (c->sala != NULL) {
+        aviso_len = snprintf(aviso, sizeof(aviso), "🔴 %s:%d saiu da sala", c->ip, c->porta);
+        sala_broadcast(c, aviso, (size_t)aviso_len, 1);
+    }
+    if (sala_entrar(c, nome) != 0) {
+        conexao_enviar(c, "Não foi possível entrar na sala", strlen("Não foi possível entrar na sala"));
+        return;
+    }
+    aviso_len = snprintf(aviso, sizeof(aviso), "🟢 %s:%d entrou na sala", c->ip, c->porta);
+    sala_broadcast(c, aviso, (size_t)aviso_len, 1);
+
+    aviso_len = snprintf(aviso, sizeof(aviso), "Você está na sala %s", nome);
+    conexao_enviar(c, aviso, (size_t)aviso_len);
+
+    if (log_server_event(EVENTO_SALA, c->id, nome, strlen(nome)) != 0) {
+        char log_msg[150];
+        snprintf(log_msg, sizeof(log_msg), "Cliente %s:%d entrou na sala %s", c->ip, c->porta, nome);
+        tsqueue_push(&msg_queue, log_msg);
+    }
+}
+
+/**
+ * Lista as salas mais movimentadas para o cliente
+ */
+static void list_rooms(conexao_t *c) {
+    sala_info_t info[SALAS_LISTAGEM];
+    size_t n = sala_listar(info, SALAS_LISTAGEM);
+    char resposta[PROTO_MAX_TEXTO];
+    size_t pos = (size_t)snprintf(resposta, sizeof(resposta), "Salas (%zu):", n);
+
+    for (size_t i = 0; i < n && pos < sizeof(resposta); i++) {
+        pos += (size_t)snprintf(resposta + pos, sizeof(resposta) - pos,
+                                "\n  %s - %zu membro(s), %llu mensagens, %llu entregas",
+                                info[i].nome, info[i].membros,
+                                (unsigned long long)info[i].mensagens,
+                                (unsigned long long)info[i].entregas);
+    }
+    if (pos > sizeof(resposta) - 1) {
+        pos = sizeof(resposta) - 1;
+    }
+    conexao_enviar(c, resposta, pos);
+}
+
+/**
+ * Comandos de sala: /entrar SALA, /sair-sala e /salas
+ * @return 1 se a mensagem era um comando de sala, 0 caso contrário
+ */
+static int handle_room_command(conexao_t *c, const char *buffer, size_t len) {
+    if (len > 8 && memcmp(buffer, "/entrar ", 8) == 0) {
+        char nome[SALA_NOME_MAX];
+        size_t nome_len = len - 8;
+        if (!sala_nome_valido(buffer + 8, nome_len)) {
+            const char *erro = "Nome de sala inválido (até 31 caracteres: letras, números, '-' ou '_')";
+            conexao_enviar(c, erro, strlen(erro));
+            return 1;
         }
-        
-        // Ignorar mensagens vazias
-        if (strlen(buffer) == 0) continue;
-        
-        // Exibir mensagem recebida no servidor
-        printf("\n📨 [%s:%d]: %s\n", client_ip, client_port, buffer);
-        
-        // Formatar mensagem para broadcast
-        char formatted_msg[BUFFER_SIZE + 100];
-        sprintf(formatted_msg, "[%s:%d]: %s", client_ip, client_port, buffer);
-        
-        // Enviar para TODOS os clientes (broadcast)
-        broadcast_message(formatted_msg, client_fd);
-        
-        // Enviar para o logger thread-safe
+        memcpy(nome, buffer + 8, nome_len);
+        nome[nome_len] = '\0';
+        change_room(c, nome);
+        return 1;
+    }
+    if (len == 10 && memcmp(buffer, "/sair-sala", 10) == 0) {
+        change_room(c, SALA_PADRAO);
+        return 1;
+    }
+    if (len == 6 && memcmp(buffer, "/salas", 6) == 0) {
+        list_rooms(c);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Processa uma mensagem (payload de um quadro) recebida de um cliente
+ * @return 1 se o cliente pediu para sair ou violou o protocolo, 0 caso contrário
+ */
+int process_client_message(conexao_t *c, const char *buffer, size_t len) {
+    // Verificar se é comando de saída
+    if ((len == 4 && memcmp(buffer, "sair", 4) == 0) ||
+        (len == 5 && memcmp(buffer, "/quit", 5) == 0)) {
+        return 1;
+    }
+    
+    // Ignorar mensagens vazias
+    if (len == 0) return 0;
+    metricas_somar(METRICA_MENSAGENS, 1);
+
+    if (len > PROTO_MAX_TEXTO) {
+        char err_msg[150];
+        sprintf(err_msg, "Cliente %s:%d enviou mensagem de %zu bytes (limite %d)",
+                c->ip, c->porta, len, PROTO_MAX_TEXTO);
+        tsqueue_push(&msg_queue, err_msg);
+        return 1;
+    }
+    
+    // Exibir mensagem recebida no servidor
+    printf("\n📨 [%s:%d]: %.*s\n", c->ip, c->porta, (int)len, buffer);
+    
+    if (buffer[0] == '/' && handle_room_command(c, buffer, len)) {
+        return 0;
+    }
+    if (len == sizeof(ANEL_SHM_PEDIDO) - 1 && memcmp(buffer, ANEL_SHM_PEDIDO, len) == 0) {
+        return local_ativar_shm(c) < 0;
+    }
+
+    // Formatar mensagem para broadcast
+    char formatted_msg[PROTO_MAX_PAYLOAD];
+    int formatted_len = snprintf(formatted_msg, sizeof(formatted_msg), "[%s:%d]: %.*s",
+                                 c->ip, c->porta, (int)len, buffer);
+    
+    // Enviar para os membros da sala do remetente
+    sala_broadcast(c, formatted_msg, (size_t)formatted_len, 1);
+    
+    // Enviar para o logger (binário: payload bruto, sem formatação)
+    if (log_server_event(EVENTO_MENSAGEM, c->id, buffer, len) != 0) {
         char log_msg[BUFFER_SIZE + 100];
-        sprintf(log_msg, "Mensagem do cliente [%s:%d]: %s", 
-                client_ip, client_port, buffer);
+        snprintf(log_msg, sizeof(log_msg), "Mensagem do cliente [%s:%d]: %.*s", 
+                 c->ip, c->porta, (int)len, buffer);
         tsqueue_push(&msg_queue, log_msg);
-        
-        printf("> Mensagem broadcast enviada para outros clientes...\n");
     }
+    
+    printf("> Mensagem broadcast enviada para a sala %s...\n", c->sala ? c->sala->nome : "-");
+    return 0;
+}
 
-cleanup:
-    // Cliente desconectado
-    char disc_msg[100];
-    sprintf(disc_msg, "Cliente desconectado: %s:%d", client_ip, client_port);
-    tsqueue_push(&msg_queue, disc_msg);
+/**
+ * Processa todos os quadros completos já recebidos no anel da conexão
+ * @return 0 se a conexão continua, -1 se deve ser encerrada
+ */
+int process_client_frames(conexao_t *c) {
+    const char *payload;
+    size_t len;
+    int status = 0;
+
+    // Suspensa pelo limite de taxa: o resto do anel espera a retomada
+    while (c->retomar_ns == 0 && (status = proto_proximo_quadro(&c->ring, &payload, &len)) == 1) {
+        uint64_t espera = limites_ativos() ? limites_cobrar(&c->limite, len) : 0;
+        if (espera > 0 && limites_acao() == LIMITE_DESCARTAR) {
+            continue;
+        }
+        if (espera > 0 && limites_acao() == LIMITE_DESCONECTAR) {
+            char err_msg[100];
+            sprintf(err_msg, "Cliente %s:%d acima do limite de taxa - conexão encerrada", c->ip, c->porta);
+            tsqueue_push(&msg_queue, err_msg);
+            return -1;
+        }
+        if (process_client_message(c, payload, len)) {
+            return -1;
+        }
+        if (espera > 0) {
+            conexao_suspender(c, espera);
+        }
+    }
+    if (status < 0) {
+        char err_msg[100];
+        sprintf(err_msg, "Quadro inválido de %s:%d - conexão encerrada", c->ip, c->porta);
+        tsqueue_push(&msg_queue, err_msg);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Trata um evento epoll de uma conexão no seu laço dono: agenda o envio da
+ * fila de saída quando gravável (feito no laco_descarregar do fim da
+ * iteração) e lê até EAGAIN, processando todos os quadros de cada leitura
+ * (um readv pode trazer vários quadros ou parte de um).
+ * @return 0 se a conexão continua, -1 se deve ser encerrada
+ */
+int handle_client_event(conexao_t *c, uint32_t events) {
+    if (events & EPOLLOUT) {
+        conexao_escrita_pronta(c);
+    }
+    if (!(events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+        return 0;
+    }
+    // Quadros que ficaram no anel durante uma suspensão pelo limite de taxa
+    if (process_client_frames(c) < 0) {
+        return -1;
+    }
+
+    while (1) {
+        // Suspensa: os dados ficam no socket (o TCP segura o cliente) até a
+        // retomada; despejada, lê até o EOF para ser fechada
+        if (c->retomar_ns != 0 && !atomic_load(&c->encerrada)) {
+            return 0;
+        }
+        RASTRO_INICIO(leitura);
+        ssize_t read_size = proto_ring_ler(&c->ring, c->fd);
+        RASTRO_FIM(leitura, "recv", read_size);
+        if (read_size > 0) {
+            metricas_somar(METRICA_BYTES_RECEBIDOS, (uint64_t)read_size);
+            RASTRO_INICIO(quadros);
+            int status = process_client_frames(c);
+            RASTRO_FIM(quadros, "quadros", read_size);
+            if (status < 0) {
+                return -1;
+            }
+            continue;
+        }
+        if (read_size == 0) {
+            return -1;  // cliente fechou a conexão
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            // Canal em memória compartilhada: o socket só sinaliza o fim
+            return c->shm != NULL ? local_shm_receber(c) : 0;
+        }
+        return -1;
+    }
+}
+
+/**
+ * Retoma uma conexão devolvida por laco_retomar: processa o que ficou no
+ * anel e volta a ler o socket (pode suspender de novo)
+ * @return 0 se a conexão continua ou já foi fechada pelo laço, -1 se deve ser encerrada
+ */
+int resume_client(conexao_t *c) {
+    if (c->handle == REGISTRO_HANDLE_INVALIDO) {
+        return 0;
+    }
+    return handle_client_event(c, EPOLLIN);
+}
+
+/**
+ * Avisa o cliente de que o servidor está cheio (o chamador fecha o socket)
+ */
+void reject_client(int client_fd) {
+    send(client_fd, REJECT_FRAME, sizeof(REJECT_FRAME) - 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+    metricas_somar(METRICA_REJEITADAS, 1);
+
+    if (log_server_event(EVENTO_REJEITADO, 0, NULL, 0) == 0) {
+        return;
+    }
+    char full_msg[100];
+    sprintf(full_msg, "Cliente rejeitado - Limite máximo (%zu) atingido", registro_limite());
+    tsqueue_push(&msg_queue, full_msg);
+}
+
+/**
+ * Anuncia a saída de um cliente (log e aviso aos demais)
+ */
+void announce_client_leave(conexao_t *c) {
+    if (log_binario_ativo(log)) {
+        log_client_address(EVENTO_DESCONECTADO, c);
+    } else {
+        char disc_msg[100];
+        sprintf(disc_msg, "Cliente desconectado: %s:%d", c->ip, c->porta);
+        tsqueue_push(&msg_queue, disc_msg);
+    }
     
-    // Notificar outros clientes sobre a desconexão (se não for shutdown)
+    // Notificar a sala sobre a desconexão (se não for shutdown)
     if (!shutdown_requested) {
         char leave_msg[BUFFER_SIZE];
-        sprintf(leave_msg, "🔴 Usuário saiu: %s:%d", client_ip, client_port);
-        broadcast_message(leave_msg, client_fd);
+        int leave_len = sprintf(leave_msg, "🔴 Usuário saiu: %s:%d", c->ip, c->porta);
+        sala_broadcast(c, leave_msg, (size_t)leave_len, 1);
     }
+    sala_sair(c);
     
-    printf("❌ Cliente desconectado: %s:%d\n", client_ip, client_port);
+    printf("❌ Cliente desconectado: %s:%d\n", c->ip, c->porta);
+}
 
-    // Remover cliente da lista
-    pthread_mutex_lock(&clients_mutex);
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (client_sockets[i] == client_fd) {
-            client_sockets[i] = 0;
-            break;
+/**
+ * Encerra a conexão no laço dono: anuncia a saída, tira da lista e do epoll
+ * e libera a referência do dono (o fd é fechado com a última referência)
+ */
+void close_client(conexao_t *c) {
+    // Hot upgrade: a conexão segue viva no processo novo, sem aviso de saída
+    if (transferencia_guardar(c) == 0) {
+        if (c->epfd >= 0) {
+            epoll_ctl(c->epfd, EPOLL_CTL_DEL, c->fd, NULL);
         }
+        conexao_unref(c);
+        return;
     }
-    pthread_mutex_unlock(&clients_mutex);
 
-    close(client_fd);
-    return NULL;
+    announce_client_leave(c);
+    remove_client(c);
+    if (c->epfd >= 0) {
+        epoll_ctl(c->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    }
+    local_fechar(c);
+    conexao_encerrar(c);
+    conexao_unref(c);
 }
 
 /**
- * Função principal - Versão com shutdown graceful
+ * Atende um cliente em um laço epoll privado com o socket dele, para ler
+ * mensagens e descarregar a própria fila de saída. Um cliente herdado (h)
+ * volta ao registro e à sala sem anúncio de entrada.
  */
-int main() {
-    // Configurar handlers de sinal primeiro
-    setup_signal_handlers();
-    
-    log = log_init("servidor.log");
-    if (log == NULL) {
-        fprintf(stderr, "Erro ao inicializar logger do servidor.\n");
-        return 1;
+static void serve_client(conexao_t *c, herdada_t *h) {
+    laco_t laco;
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) {
+        log_erro(log, "epoll_create1", errno);
+        if (h != NULL) {
+            transferencia_descartar(h);
+        } else {
+            conexao_unref(c);
+        }
+        return;
     }
-    log_set_verbose(log, 1);
+    c->epfd_proprio = 1;
+    c->epfd = epfd;
+    laco_iniciar(&laco, epfd);
+    laco_definir_atual(&laco);
+    RASTRO_NOMEAR("cliente");
 
-    // Inicializar fila de mensagens
-    tsqueue_init(&msg_queue);
+    if (h != NULL) {
+        if (transferencia_adotar(h, &laco) == NULL) {
+            laco_definir_atual(NULL);
+            return;
+        }
+    } else if (conexao_registrar(c, &laco) < 0 || add_client(c) != 0) {
+        // Só entra na lista depois de registrada no epoll: a partir daí outras
+        // threads podem enfileirar mensagens e armar EPOLLOUT para ela
+        send(c->fd, REJECT_FRAME, sizeof(REJECT_FRAME) - 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+        tsqueue_push(&msg_queue, "ERRO: Número máximo de clientes atingido");
+        conexao_encerrar(c);
+        conexao_unref(c);
+        laco_definir_atual(NULL);
+        return;
+    }
 
-    // Criar thread para consumir mensagens da fila e registrar logs
-    pthread_t log_tid;
-    if (pthread_create(&log_tid, NULL, logger_thread, NULL) != 0) {
-        log_erro(log, "criação da thread de logger", errno);
-        return 1;
+    if (h != NULL || announce_client_join(c) == 0) {
+        laco_descarregar(&laco);
+
+        struct epoll_event ev;
+        while (!shutdown_requested) {
+            int n = epoll_wait(epfd, &ev, 1, laco_espera_ms(&laco, 1000));
+            if (n < 0 && errno != EINTR) {
+                log_erro(log, "epoll_wait", errno);
+                break;
+            }
+            if (n > 0 && handle_client_event(c, ev.events) < 0) {
+                break;
+            }
+            conexao_t *suspensa = laco_retomar(&laco, 0);
+            if (suspensa != NULL) {
+                int resultado = resume_client(suspensa);
+                conexao_unref(suspensa);
+                if (resultado < 0) {
+                    break;
+                }
+            }
+            laco_descarregar(&laco);
+        }
     }
-    pthread_detach(log_tid);
 
+    // Cliente desconectado
+    close_client(c);
+    laco_finalizar(&laco);
+    laco_definir_atual(NULL);
+}
+
+/**
+ * Thread para atender um cliente recém-aceito
+ */
+void *handle_client(void *arg) {
+    serve_client(arg, NULL);
+    return NULL;
+}
+
+void *handle_inherited_client(void *arg) {
+    herdada_t *h = arg;
+    serve_client(h->c, h);
+    return NULL;
+}
+
+/**
+ * Cria o socket de escuta TCP na porta do servidor
+ * @param reuseport habilita SO_REUSEPORT (um socket por reactor)
+ * @return descritor do socket ou -1 em erro
+ */
+static int create_listen_socket(int port, int reuseport) {
     struct sockaddr_in address;
     int opt = 1;
-    int addrlen = sizeof(address);
-
-    // Inicializar lista de clientes
-    memset(client_sockets, 0, sizeof(client_sockets));
+    int fd;
 
     // Criar socket
-    if ((server_fd_global = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
+    if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
         log_erro(log, "criação do socket", errno);
-        exit(EXIT_FAILURE);
+        return -1;
     }
 
     // Configurar socket para reutilizar porta
-    if (setsockopt(server_fd_global, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt))) {
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt))) {
         log_erro(log, "configuração do socket", errno);
-        close(server_fd_global);
-        exit(EXIT_FAILURE);
+        close(fd);
+        return -1;
+    }
+
+    // Vários sockets na mesma porta: o kernel distribui as conexões entre eles
+    if (reuseport && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt))) {
+        log_erro(log, "configuração SO_REUSEPORT", errno);
+        close(fd);
+        return -1;
     }
 
+    memset(&address, 0, sizeof(address));
     address.sin_family = AF_INET;
     address.sin_addr.s_addr = INADDR_ANY;
-    address.sin_port = htons(PORT);
+    address.sin_port = htons(port);
 
     // Bind
-    if (bind(server_fd_global, (struct sockaddr *)&address, sizeof(address)) < 0) {
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
         log_erro(log, "bind da porta", errno);
-        close(server_fd_global);
-        exit(EXIT_FAILURE);
+        close(fd);
+        return -1;
     }
 
     // Listen
-    if (listen(server_fd_global, 3) < 0) {
+    if (listen(fd, SOMAXCONN) < 0) {
         log_erro(log, "listen", errno);
-        close(server_fd_global);
-        exit(EXIT_FAILURE);
+        close(fd);
+        return -1;
     }
 
-    char startup_msg[100];
-    sprintf(startup_msg, "=== Servidor de Chat Iniciado (Porta: %d) ===", PORT);
-    tsqueue_push(&msg_queue, startup_msg);
-    
-    printf("🚀 Servidor de Chat iniciado na porta %d\n", PORT);
-    printf("📡 Aguardando conexões de clientes...\n");
-    printf("💡 Pressione Ctrl+C para finalizar graciosamente\n");
+    return fd;
+}
+
+/**
+ * Aceita uma conexão e cria a thread que vai atendê-la
+ */
+static void accept_threaded(int listen_fd, const pthread_attr_t *attr) {
+    struct sockaddr_in address;
+    socklen_t addrlen = sizeof(address);
+    int client_fd = accept4(listen_fd, (struct sockaddr *)&address, &addrlen,
+                            SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (client_fd < 0) {
+        if (errno != EINTR) {
+            log_erro(log, "accept", errno);
+        }
+        return;
+    }
+
+    // Verificar se há slots disponíveis
+    if (registro_contar() >= registro_limite()) {
+        reject_client(client_fd);
+        close(client_fd);
+        return;
+    }
+
+    conexao_t *c = conexao_criar(client_fd, &address);
+    if (c == NULL) {
+        log_erro(log, "alocação da conexão", errno);
+        close(client_fd);
+        return;
+    }
+
+    // Criar thread para o cliente (a referência de criação passa para
+    // ela, que também adiciona o cliente à lista)
+    pthread_t thread_id;
+    if (pthread_create(&thread_id, attr, handle_client, c) != 0) {
+        log_erro(log, "criação da thread do cliente", errno);
+        conexao_unref(c);
+        return;
+    }
+
+    printf("👥 Clientes conectados: %d/%zu\n", count_connected_clients() + 1, registro_limite());
+}
+
+/**
+ * Loop de accept do modelo thread-por-cliente (socket TCP e, se ativo, o
+ * socket Unix)
+ */
+static void run_threaded_loop(size_t pilha) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_attr_setstacksize(&attr, pilha) != 0) {
+        log_erro(log, "tamanho de pilha das threads", EINVAL);
+    }
+
+    // Conexões herdadas de um hot upgrade: uma thread para cada, como no accept
+    for (herdada_t *h; (h = transferencia_proxima()) != NULL;) {
+        pthread_t thread_id;
+        if (pthread_create(&thread_id, &attr, handle_inherited_client, h) != 0) {
+            log_erro(log, "criação da thread do cliente", errno);
+            transferencia_descartar(h);
+        }
+    }
+
+    int local_fd = local_escuta();
 
     // Loop principal com verificação de shutdown
     while (!shutdown_requested) {
@@ -317,12 +722,16 @@ int main() {
         fd_set readfds;
         FD_ZERO(&readfds);
         FD_SET(server_fd_global, &readfds);
+        if (local_fd >= 0) {
+            FD_SET(local_fd, &readfds);
+        }
         
         struct timeval timeout;
         timeout.tv_sec = 1;
         timeout.tv_usec = 0;
         
-        int activity = select(server_fd_global + 1, &readfds, NULL, NULL, &timeout);
+        int maior = local_fd > server_fd_global ? local_fd : server_fd_global;
+        int activity = select(maior + 1, &readfds, NULL, NULL, &timeout);
         
         if (activity < 0 && errno != EINTR) {
             log_erro(log, "select", errno);
@@ -332,76 +741,551 @@ int main() {
         if (shutdown_requested) {
             break;
         }
+
+        // Conexões removidas cujo período de graça já terminou
+        registro_coletar();
         
         if (activity > 0 && FD_ISSET(server_fd_global, &readfds)) {
-            int client_fd = accept(server_fd_global, (struct sockaddr *)&address, (socklen_t*)&addrlen);
-            if (client_fd < 0) {
-                if (errno != EINTR) {
-                    log_erro(log, "accept", errno);
-                }
-                continue;
-            }
+            accept_threaded(server_fd_global, &attr);
+        }
+        if (activity > 0 && local_fd >= 0 && FD_ISSET(local_fd, &readfds)) {
+            accept_threaded(local_fd, &attr);
+        }
+    }
+    pthread_attr_destroy(&attr);
+}
 
-            // Verificar se há slots disponíveis
-            if (count_connected_clients() >= MAX_CLIENTS) {
-                char reject_msg[] = "Servidor cheio. Tente novamente mais tarde.";
-                send(client_fd, reject_msg, strlen(reject_msg), MSG_DONTWAIT);
-                close(client_fd);
-                
-                char full_msg[100];
-                sprintf(full_msg, "Cliente rejeitado - Limite máximo (%d) atingido", MAX_CLIENTS);
-                tsqueue_push(&msg_queue, full_msg);
-                continue;
-            }
+/**
+ * Interpreta os argumentos de linha de comando
+ * @return 0 em sucesso, -1 se houver argumento inválido
+ */
+static int parse_args(int argc, char *argv[], config_servidor_t *cfg) {
+    static const struct option opcoes[] = {
+        {"modo",     required_argument, NULL, 'm'},
+        {"reactors", required_argument, NULL, 'r'},
+        {"workers",  required_argument, NULL, 'w'},
+        {"pilha-kb", required_argument, NULL, 'S'},
+        {"max-clientes", required_argument, NULL, 'M'},
+        {"fixar-cpu", no_argument,      NULL, 'c'},
+        {"marca-alta", required_argument, NULL, 'A'},
+        {"marca-baixa", required_argument, NULL, 'B'},
+        {"despejo-ms", required_argument, NULL, 'D'},
+        {"log-assincrono", no_argument, NULL, 'L'},
+        {"log-binario", required_argument, NULL, 'b'},
+        {"admin-porta", required_argument, NULL, 'P'},
+        {"historico", required_argument, NULL, 'H'},
+        {"historico-bytes", required_argument, NULL, 'Y'},
+        {"coalescer-us", required_argument, NULL, 'J'},
+        {"coalescer-bytes", required_argument, NULL, 'K'},
+        {"transferencia", required_argument, NULL, 'T'},
+        {"limite-msgs", required_argument, NULL, 'n'},
+        {"limite-bytes", required_argument, NULL, 'y'},
+        {"limite-global-msgs", required_argument, NULL, 'N'},
+        {"limite-global-bytes", required_argument, NULL, 'G'},
+        {"limite-rajada-ms", required_argument, NULL, 'R'},
+        {"limite-acao", required_argument, NULL, 'a'},
+        {"porta",    required_argument, NULL, 'p'},
+        {"federacao-porta", required_argument, NULL, 'F'},
+        {"par",      required_argument, NULL, 'E'},
+        {"unix",     required_argument, NULL, 'U'},
+        {"shm",      no_argument,       NULL, 'Z'},
+        {"difusao-limiar", required_argument, NULL, 'V'},
+        {"difusao-fatias", required_argument, NULL, 'W'},
+        {"memoria-max", required_argument, NULL, 'X'},
+        {"help",     no_argument,       NULL, 'h'},
+        {NULL,       0,                 NULL, 0}
+    };
+    int opt;
 
-            // Adicionar cliente à lista
-            pthread_mutex_lock(&clients_mutex);
-            int added = 0;
-            for (int i = 0; i < MAX_CLIENTS; i++) {
-                if (client_sockets[i] == 0) {
-                    client_sockets[i] = client_fd;
-                    added = 1;
-                    
-                    // Criar thread para o cliente
-                    pthread_t thread_id;
-                    int *new_sock = malloc(sizeof(int));
-                    *new_sock = client_fd;
-                    
-                    if (pthread_create(&thread_id, NULL, handle_client, (void*)new_sock) != 0) {
-                        log_erro(log, "criação da thread do cliente", errno);
-                        free(new_sock);
-                        client_sockets[i] = 0;
-                        close(client_fd);
-                    } else {
-                        pthread_detach(thread_id);
-                    }
-                    break;
-                }
+    cfg->modo = MODO_THREADS;
+    cfg->porta = PORT;
+    cfg->num_reactors = 1;
+    cfg->num_workers = 0;
+    cfg->pilha_kb = POOL_PILHA_KB_PADRAO;
+    cfg->max_clientes = MAX_CLIENTS;
+    cfg->fixar_cpu = 0;
+    cfg->saida.marca_alta = SAIDA_MARCA_ALTA_PADRAO;
+    cfg->saida.marca_baixa = SAIDA_MARCA_BAIXA_PADRAO;
+    cfg->saida.despejo_ms = SAIDA_DESPEJO_MS_PADRAO;
+    cfg->saida.coalescer_us = 0;
+    cfg->saida.coalescer_bytes = SAIDA_COALESCER_BYTES_PADRAO;
+    cfg->log_assincrono = 0;
+    cfg->log_binario = NULL;
+    cfg->admin_porta = METRICAS_PORTA_PADRAO;
+    cfg->historico = SALA_HISTORICO_PADRAO;
+    cfg->historico_bytes = SALA_HISTORICO_BYTES_PADRAO;
+    cfg->transferencia = NULL;
+    cfg->limites.mensagens = 0;
+    cfg->limites.bytes = 0;
+    cfg->limites.global_mensagens = 0;
+    cfg->limites.global_bytes = 0;
+    cfg->limites.rajada_ms = LIMITES_RAJADA_MS_PADRAO;
+    cfg->limites.acao = LIMITE_ATRASAR;
+    cfg->federacao.porta = 0;
+    cfg->federacao.num_pares = 0;
+    cfg->local.caminho = NULL;
+    cfg->local.shm = 0;
+    cfg->difusao.limiar = DIFUSAO_LIMIAR_PADRAO;
+    cfg->difusao.fatias = 0;
+    cfg->memoria.limite = 0;
+    cfg->memoria.pilha = 0;
+
+    while ((opt = getopt_long(argc, argv, "m:r:w:S:M:chA:B:D:Lb:P:H:Y:J:K:T:n:y:N:G:R:a:p:F:E:U:ZV:W:X:", opcoes, NULL)) != -1) {
+        switch (opt) {
+        case 'm':
+            if (strcmp(optarg, "threads") == 0) {
+                cfg->modo = MODO_THREADS;
+            } else if (strcmp(optarg, "epoll") == 0) {
+                cfg->modo = MODO_EPOLL;
+            } else if (strcmp(optarg, "uring") == 0) {
+                cfg->modo = MODO_URING;
+            } else if (strcmp(optarg, "pool") == 0) {
+                cfg->modo = MODO_POOL;
+            } else {
+                fprintf(stderr, "Modo inválido: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'r':
+            // 0 = um reactor por CPU disponível
+            cfg->num_reactors = atoi(optarg);
+            if (cfg->num_reactors == 0) {
+                cfg->num_reactors = (int)sysconf(_SC_NPROCESSORS_ONLN);
+            }
+            if (cfg->num_reactors < 1 || cfg->num_reactors > MAX_REACTORS) {
+                fprintf(stderr, "Número de reactors inválido: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'w':
+            cfg->num_workers = atoi(optarg);
+            if (cfg->num_workers < 0) {
+                fprintf(stderr, "Número de workers inválido: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'S':
+            cfg->pilha_kb = strtoul(optarg, NULL, 10);
+            if (cfg->pilha_kb == 0) {
+                fprintf(stderr, "Tamanho de pilha inválido: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'M':
+            cfg->max_clientes = strtoul(optarg, NULL, 10);
+            if (cfg->max_clientes == 0) {
+                fprintf(stderr, "Limite de clientes inválido: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'c':
+            cfg->fixar_cpu = 1;
+            break;
+        case 'A':
+            cfg->saida.marca_alta = strtoul(optarg, NULL, 10);
+            break;
+        case 'B':
+            cfg->saida.marca_baixa = strtoul(optarg, NULL, 10);
+            break;
+        case 'D':
+            cfg->saida.despejo_ms = atoi(optarg);
+            break;
+        case 'L':
+            cfg->log_assincrono = 1;
+            break;
+        case 'b':
+            cfg->log_binario = optarg;
+            break;
+        case 'P':
+            cfg->admin_porta = atoi(optarg);
+            if (cfg->admin_porta < 0 || cfg->admin_porta > 65535) {
+                fprintf(stderr, "Porta de administração inválida: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'H':
+            cfg->historico = strtoul(optarg, NULL, 10);
+            break;
+        case 'Y':
+            cfg->historico_bytes = strtoul(optarg, NULL, 10);
+            break;
+        case 'J':
+            cfg->saida.coalescer_us = atoi(optarg);
+            break;
+        case 'K':
+            cfg->saida.coalescer_bytes = strtoul(optarg, NULL, 10);
+            break;
+        case 'T':
+            cfg->transferencia = optarg;
+            break;
+        case 'n':
+            cfg->limites.mensagens = strtoull(optarg, NULL, 10);
+            break;
+        case 'y':
+            cfg->limites.bytes = strtoull(optarg, NULL, 10);
+            break;
+        case 'N':
+            cfg->limites.global_mensagens = strtoull(optarg, NULL, 10);
+            break;
+        case 'G':
+            cfg->limites.global_bytes = strtoull(optarg, NULL, 10);
+            break;
+        case 'R':
+            cfg->limites.rajada_ms = atoi(optarg);
+            if (cfg->limites.rajada_ms < 0) {
+                fprintf(stderr, "Rajada inválida: %s\n", optarg);
+                return -1;
             }
-            pthread_mutex_unlock(&clients_mutex);
-            
-            if (!added) {
-                tsqueue_push(&msg_queue, "ERRO: Número máximo de clientes atingido");
-                close(client_fd);
+            break;
+        case 'a':
+            if (strcmp(optarg, "atrasar") == 0) {
+                cfg->limites.acao = LIMITE_ATRASAR;
+            } else if (strcmp(optarg, "descartar") == 0) {
+                cfg->limites.acao = LIMITE_DESCARTAR;
+            } else if (strcmp(optarg, "desconectar") == 0) {
+                cfg->limites.acao = LIMITE_DESCONECTAR;
             } else {
-                printf("👥 Clientes conectados: %d/%d\n", count_connected_clients(), MAX_CLIENTS);
+                fprintf(stderr, "Ação de limite inválida: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'p':
+            cfg->porta = atoi(optarg);
+            if (cfg->porta <= 0 || cfg->porta > 65535) {
+                fprintf(stderr, "Porta inválida: %s\n", optarg);
+                return -1;
             }
+            break;
+        case 'F':
+            cfg->federacao.porta = atoi(optarg);
+            if (cfg->federacao.porta < 0 || cfg->federacao.porta > 65535) {
+                fprintf(stderr, "Porta da federação inválida: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'E':
+            if (cfg->federacao.num_pares == FEDERACAO_MAX_PARES) {
+                fprintf(stderr, "Máximo de %d pares na federação\n", FEDERACAO_MAX_PARES);
+                return -1;
+            }
+            cfg->federacao.pares[cfg->federacao.num_pares++] = optarg;
+            break;
+        case 'U':
+            cfg->local.caminho = optarg;
+            break;
+        case 'Z':
+            cfg->local.shm = 1;
+            break;
+        case 'V':
+            cfg->difusao.limiar = strtoul(optarg, NULL, 10);
+            break;
+        case 'W':
+            cfg->difusao.fatias = atoi(optarg);
+            if (cfg->difusao.fatias < 0 || cfg->difusao.fatias > DIFUSAO_MAX_FATIAS) {
+                fprintf(stderr, "Número de fatias inválido: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'X': {
+            // Só bytes em decimal: "1G" viraria um limite de 1 byte e "abc"
+            // desligaria o limite
+            char *fim;
+            errno = 0;
+            unsigned long long limite = strtoull(optarg, &fim, 10);
+            if (fim == optarg || *fim != '\0' || optarg[0] == '-' || errno == ERANGE ||
+                limite > SIZE_MAX) {
+                fprintf(stderr, "Limite de memória inválido: %s\n", optarg);
+                return -1;
+            }
+            cfg->memoria.limite = (size_t)limite;
+            break;
+        }
+        default:
+            fprintf(stderr, "Uso: %s [--modo threads|epoll|uring|pool] [--reactors N] [--fixar-cpu]\n"
+                            "          [--porta N]\n"
+                            "          [--workers N] [--pilha-kb KB]\n"
+                            "          [--max-clientes N]\n"
+                            "          [--marca-alta BYTES] [--marca-baixa BYTES] [--despejo-ms MS]\n"
+                            "          [--coalescer-us US] [--coalescer-bytes BYTES]\n"
+                            "          [--log-assincrono] [--log-binario ARQUIVO]\n"
+                            "          [--admin-porta N] [--historico N] [--historico-bytes BYTES]\n"
+                            "          [--transferencia SOCKET]\n"
+                            "          [--limite-msgs N] [--limite-bytes BYTES]\n"
+                            "          [--limite-global-msgs N] [--limite-global-bytes BYTES]\n"
+                            "          [--limite-rajada-ms MS] [--limite-acao atrasar|descartar|desconectar]\n"
+                            "          [--federacao-porta N] [--par HOST:PORTA]...\n"
+                            "          [--unix CAMINHO] [--shm]\n"
+                            "          [--difusao-limiar N] [--difusao-fatias N]\n"
+                            "          [--memoria-max BYTES]\n",
+                    argv[0]);
+            return -1;
+        }
+    }
+    if (cfg->saida.marca_baixa > cfg->saida.marca_alta || cfg->saida.despejo_ms < 0) {
+        fprintf(stderr, "Marcas de saída inválidas: baixa deve ser <= alta\n");
+        return -1;
+    }
+    if (cfg->saida.coalescer_us < 0) {
+        fprintf(stderr, "Janela de coalescência inválida: %d\n", cfg->saida.coalescer_us);
+        return -1;
+    }
+    if (cfg->local.shm && cfg->local.caminho == NULL) {
+        fprintf(stderr, "--shm exige --unix CAMINHO\n");
+        return -1;
+    }
+    // O laço io_uring não é acordado por outras threads: as mensagens vindas
+    // dos pares ficariam paradas na fila dos clientes
+    if (cfg->modo == MODO_URING && (cfg->federacao.porta != 0 || cfg->federacao.num_pares > 0)) {
+        fprintf(stderr, "Federação indisponível no modo uring (use threads, epoll ou pool)\n");
+        return -1;
+    }
+    // No modo threads cada conexão tem a própria pilha, cobrada junto com ela
+    if (cfg->modo == MODO_THREADS) {
+        cfg->memoria.pilha = cfg->pilha_kb * 1024;
+    }
+    return 0;
+}
+
+static void encerrar_cliente(conexao_t *c, void *arg) {
+    (void)arg;
+    conexao_encerrar(c);
+}
+
+/**
+ * Função principal - Versão com shutdown graceful
+ */
+int main(int argc, char *argv[]) {
+    config_servidor_t cfg;
+    if (parse_args(argc, argv, &cfg) != 0) {
+        return 1;
+    }
+
+    // Configurar handlers de sinal primeiro
+    setup_signal_handlers();
+    
+    log = log_init("servidor.log");
+    if (log == NULL) {
+        fprintf(stderr, "Erro ao inicializar logger do servidor.\n");
+        return 1;
+    }
+    log_set_verbose(log, 1);
+    if (cfg.log_assincrono &&
+        log_set_assincrono(log, LOG_LOTE_PADRAO, LOG_INTERVALO_MS_PADRAO) != 0) {
+        log_erro(log, "ativação do log assíncrono", errno);
+    }
+    if (cfg.log_binario && log_abrir_binario(log, cfg.log_binario) != 0) {
+        log_erro(log, "abertura do log binário", errno);
+    }
+
+    // Inicializar fila de mensagens
+    if (tsqueue_init(&msg_queue, QUEUE_CAPACIDADE_PADRAO) != 0) {
+        log_erro(log, "alocação da fila de mensagens", errno);
+        return 1;
+    }
+
+    // Criar thread para consumir mensagens da fila e registrar logs
+    pthread_t log_tid;
+    if (pthread_create(&log_tid, NULL, logger_thread, NULL) != 0) {
+        log_erro(log, "criação da thread de logger", errno);
+        return 1;
+    }
+
+    // Rastro do caminho quente (build com make RASTRO=1; senão não faz nada)
+    if (rastro_iniciar(avisar_rastro) != 0) {
+        log_erro(log, "thread do rastro", errno);
+    }
+
+    // Inicializar registro de clientes
+    if (registro_iniciar(cfg.max_clientes) != 0) {
+        log_erro(log, "alocação do registro de clientes", errno);
+        return 1;
+    }
+    conexao_configurar_saida(&cfg.saida);
+    memoria_configurar(&cfg.memoria);
+    if (conexao_iniciar() != 0) {
+        log_erro(log, "slab das conexões", errno);
+        return 1;
+    }
+    sala_configurar_historico(cfg.historico, cfg.historico_bytes);
+    limites_configurar(&cfg.limites);
+
+    // No modo epoll cada reactor tem o próprio socket de escuta na mesma porta.
+    // No hot upgrade os sockets vêm do processo antigo, que também entrega as
+    // conexões vivas antes de sair
+    int listen_fds[MAX_REACTORS];
+    int num_listeners = cfg.modo == MODO_EPOLL ? cfg.num_reactors : 1;
+    int herdados = 0;
+    if (cfg.transferencia) {
+        herdados = transferencia_receber(cfg.transferencia, listen_fds, MAX_REACTORS);
+        if (herdados < 0) {
+            log_erro(log, "conexão com o processo antigo", errno);
+            herdados = 0;
+        }
+    }
+    if (herdados > 0 && cfg.modo == MODO_EPOLL) {
+        num_listeners = herdados;  // um reactor por socket herdado
+    } else if (herdados > 0) {
+        // Os demais modos aceitam em um só socket (os extras perdem a fila)
+        for (int i = 1; i < herdados; i++) {
+            close(listen_fds[i]);
+        }
+    }
+    for (int i = 0; herdados == 0 && i < num_listeners; i++) {
+        listen_fds[i] = create_listen_socket(cfg.porta, num_listeners > 1);
+        if (listen_fds[i] < 0) {
+            exit(EXIT_FAILURE);
+        }
+    }
+    server_fd_global = listen_fds[0];
+
+    // Clientes na mesma máquina: socket Unix atendido pelo mesmo laço do TCP
+    if (local_iniciar(&cfg.local) != 0) {
+        log_erro(log, "socket Unix local", errno);
+    }
+
+    // Métricas em texto Prometheus num listener local separado do chat (no
+    // hot upgrade o processo antigo libera a porta antes do fim da transferência)
+    if (metricas_iniciar(cfg.admin_porta) != 0) {
+        log_erro(log, "listener de métricas", errno);
+    }
+    // Pares da federação: os broadcasts de sala passam a cruzar os nós
+    if (federacao_iniciar(&cfg.federacao) != 0) {
+        log_erro(log, "início da federação", errno);
+        exit(EXIT_FAILURE);
+    }
+    if (cfg.transferencia &&
+        transferencia_iniciar(cfg.transferencia, listen_fds, num_listeners) != 0) {
+        log_erro(log, "socket do hot upgrade", errno);
+    }
+
+    char startup_msg[100];
+    static const char *const nomes_modo[] = { "threads", "epoll", "uring", "pool" };
+    sprintf(startup_msg, "=== Servidor de Chat Iniciado (Porta: %d, Modo: %s, Reactors: %d) ===",
+            cfg.porta, nomes_modo[cfg.modo], num_listeners);
+    tsqueue_push(&msg_queue, startup_msg);
+    
+    printf("🚀 Servidor de Chat iniciado na porta %d\n", cfg.porta);
+    printf("📡 Aguardando conexões de clientes...\n");
+    printf("💡 Pressione Ctrl+C para finalizar graciosamente\n");
+
+    // Fan-out paralelo das salas grandes (o laço io_uring, único dono de
+    // todas as conexões, não é acordado por outras threads)
+    if (cfg.modo != MODO_URING && difusao_iniciar(&cfg.difusao) != 0) {
+        log_erro(log, "threads do fan-out paralelo", errno);
+    }
+
+    // Sem suporte a io_uring no kernel: mesmo laço, mas com um reactor epoll
+    if (cfg.modo == MODO_URING && uring_executar(listen_fds[0]) == URING_INDISPONIVEL) {
+        tsqueue_push(&msg_queue, "io_uring indisponível - usando o modo epoll");
+        cfg.modo = MODO_EPOLL;
+        if (difusao_iniciar(&cfg.difusao) != 0) {
+            log_erro(log, "threads do fan-out paralelo", errno);
+        }
+    }
+    if (cfg.modo == MODO_EPOLL) {
+        reactor_executar(listen_fds, num_listeners, cfg.fixar_cpu);
+        // listen_fds[0] é fechado junto com server_fd_global abaixo
+        for (int i = 1; i < num_listeners; i++) {
+            close(listen_fds[i]);
         }
+    } else if (cfg.modo == MODO_POOL) {
+        pool_executar(listen_fds[0], cfg.num_workers, cfg.pilha_kb * 1024);
+    } else {
+        run_threaded_loop(cfg.pilha_kb * 1024);
     }
 
     // SHUTDOWN GRACEFUL
     printf("\n🧹 Finalizando servidor suavemente...\n");
     
-    // Fechar todos os sockets dos clientes
-    pthread_mutex_lock(&clients_mutex);
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (client_sockets[i] != 0) {
-            close(client_sockets[i]);
-            client_sockets[i] = 0;
-        }
+    if (transferencia_ativa()) {
+        // Hot upgrade: as conexões seguem no processo novo, que só abre as
+        // portas de métricas e da federação depois do fim da transferência
+        metricas_encerrar();
+        federacao_encerrar();
+        transferencia_concluir();
+    } else {
+        // Interromper os sockets dos clientes restantes (as threads fazem o close)
+        registro_para_cada(encerrar_cliente, NULL);
+    }
+
+    uint64_t descartadas, despejadas;
+    conexao_estatisticas(&descartadas, &despejadas);
+    char stats_msg[150];
+    sprintf(stats_msg, "Backpressure: %llu mensagens descartadas, %llu clientes lentos despejados",
+            (unsigned long long)descartadas, (unsigned long long)despejadas);
+    tsqueue_push(&msg_queue, stats_msg);
+
+    if (limites_ativos()) {
+        uint64_t acionamentos[LIMITE_QUANTIDADE];
+        limites_estatisticas(acionamentos);
+        snprintf(stats_msg, sizeof(stats_msg),
+                 "Limites (%s): conexão %llu msgs/%llu bytes, global %llu msgs/%llu bytes",
+                 limites_nome_acao(limites_acao()),
+                 (unsigned long long)acionamentos[LIMITE_CONEXAO_MENSAGENS],
+                 (unsigned long long)acionamentos[LIMITE_CONEXAO_BYTES],
+                 (unsigned long long)acionamentos[LIMITE_GLOBAL_MENSAGENS],
+                 (unsigned long long)acionamentos[LIMITE_GLOBAL_BYTES]);
+        tsqueue_push(&msg_queue, stats_msg);
+    }
+
+    if (local_escuta() >= 0) {
+        local_info_t loc;
+        local_estatisticas(&loc);
+        snprintf(stats_msg, sizeof(stats_msg),
+                 "Local: %llu conexões Unix, %llu canais shm (%llu recusados), %llu sinais eventfd",
+                 (unsigned long long)loc.aceitas, (unsigned long long)loc.canais,
+                 (unsigned long long)loc.recusas, (unsigned long long)loc.sinais);
+        tsqueue_push(&msg_queue, stats_msg);
+    }
+
+    if (cfg.federacao.porta != 0 || cfg.federacao.num_pares > 0) {
+        federacao_info_t fed;
+        federacao_estatisticas(&fed);
+        snprintf(stats_msg, sizeof(stats_msg),
+                 "Federação: %llu enviadas, %llu recebidas, %llu duplicadas, %llu descartadas",
+                 (unsigned long long)fed.enviadas, (unsigned long long)fed.recebidas,
+                 (unsigned long long)fed.duplicadas, (unsigned long long)fed.descartadas);
+        tsqueue_push(&msg_queue, stats_msg);
+    }
+
+    difusao_info_t dif;
+    difusao_estatisticas(&dif);
+    if (dif.divididos > 0) {
+        snprintf(stats_msg, sizeof(stats_msg),
+                 "Fan-out paralelo: %llu broadcasts divididos, %llu fatias no remetente, %llu nas %d ajudantes",
+                 (unsigned long long)dif.divididos, (unsigned long long)dif.fatias_remetente,
+                 (unsigned long long)dif.fatias_ajudantes, dif.ajudantes);
+        tsqueue_push(&msg_queue, stats_msg);
+    }
+
+    // Dimensionamento: custo fixo por conexão e o que cada slab chegou a mapear
+    memoria_info_t mem;
+    memoria_estatisticas(&mem);
+    snprintf(stats_msg, sizeof(stats_msg),
+             "Memória: %zu bytes por conexão (pilha %zu), %llu bytes mapeados, "
+             "recusados %llu conexões/%llu quadros",
+             mem.por_conexao, mem.pilha, (unsigned long long)mem.mapeados,
+             (unsigned long long)mem.recusas[MEMORIA_CONEXOES],
+             (unsigned long long)mem.recusas[MEMORIA_FILAS]);
+    tsqueue_push(&msg_queue, stats_msg);
+
+    // Salas mais movimentadas (entregas = fan-out acumulado)
+    sala_info_t salas[SALAS_LISTAGEM];
+    size_t num_salas = sala_listar(salas, SALAS_LISTAGEM);
+    for (size_t i = 0; i < num_salas; i++) {
+        snprintf(stats_msg, sizeof(stats_msg), "Sala %.*s: %llu mensagens, %llu entregas",
+                 SALA_NOME_MAX - 1, salas[i].nome, (unsigned long long)salas[i].mensagens,
+                 (unsigned long long)salas[i].entregas);
+        tsqueue_push(&msg_queue, stats_msg);
     }
-    pthread_mutex_unlock(&clients_mutex);
     
+    metricas_encerrar();
+    federacao_encerrar();
+    difusao_encerrar();
+    rastro_encerrar();
+    local_encerrar();
+    transferencia_encerrar();
+
     // Fechar socket do servidor
     if (server_fd_global != -1) {
         close(server_fd_global);
@@ -410,8 +1294,10 @@ int main() {
     // Log final
     tsqueue_push(&msg_queue, "Servidor finalizado suavemente");
     
-    // Dar tempo para a thread de logger processar mensagens pendentes
-    sleep(2);
+    // Esperar a thread de logger processar as mensagens pendentes
+    tsqueue_push(&msg_queue, LOGGER_FIM);
+    pthread_join(log_tid, NULL);
+    log_flush(log);
     
     // Cleanup
     log_destruir(log);
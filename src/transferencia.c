@@ -0,0 +1,532 @@
+#define _GNU_SOURCE
+#include "../include/transferencia.h"
+#include "../include/servidor.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Registros trocados no socket SEQPACKET (um sendmsg cada)
+enum {
+    REGISTRO_ESCUTA = 1,   // sockets de escuta (SCM_RIGHTS)
+    REGISTRO_CONEXAO,      // uma conexão (SCM_RIGHTS) + quadro parcial recebido
+    REGISTRO_SAIDA,        // saída pendente da última conexão, em blocos
+    REGISTRO_FIM
+};
+
+// Cabeçalho de cada registro (mesmo host: ordem de bytes nativa)
+typedef struct {
+    uint32_t tipo;
+    uint32_t bytes;                // dados depois do cabeçalho
+    char sala[SALA_NOME_MAX];      // REGISTRO_CONEXAO
+} cabecalho_t;
+
+#define DADOS_MAX (PROTO_RING_CAPACIDADE > TRANSFERENCIA_BLOCO ? PROTO_RING_CAPACIDADE : TRANSFERENCIA_BLOCO)
+
+typedef union {
+    struct cmsghdr alinhamento;
+    char buf[CMSG_SPACE(sizeof(int) * MAX_REACTORS)];
+} controle_t;
+
+// Processo antigo: socket Unix do sucessor e conexões guardadas para ele
+static int escuta_fd = -1;
+static char escuta_caminho[sizeof(((struct sockaddr_un *)0)->sun_path)];
+static pthread_t escuta_tid;
+static int escutas_proprias[MAX_REACTORS];
+static int num_escutas_proprias;
+static int canal_fd = -1;
+static atomic_int ativa = 0;
+
+static pthread_mutex_t guardadas_mutex = PTHREAD_MUTEX_INITIALIZER;
+static conexao_t **guardadas;
+static size_t num_guardadas;
+static size_t cap_guardadas;
+static int concluida;
+
+// Processo novo: conexões recebidas, em ordem, até serem adotadas
+static herdada_t *herdadas;
+
+static int preencher_endereco(struct sockaddr_un *addr, const char *caminho) {
+    if (strlen(caminho) >= sizeof(addr->sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    strcpy(addr->sun_path, caminho);
+    return 0;
+}
+
+/**
+ * Envia um registro com até MAX_REACTORS descritores anexados
+ * @return 0 em sucesso, -1 em erro (errno definido)
+ */
+static int enviar_registro(uint32_t tipo, const char *sala, const void *dados, size_t n,
+                           const int *fds, int nfds) {
+    cabecalho_t cab;
+    memset(&cab, 0, sizeof(cab));
+    cab.tipo = tipo;
+    cab.bytes = (uint32_t)n;
+    if (sala != NULL) {
+        snprintf(cab.sala, sizeof(cab.sala), "%s", sala);
+    }
+
+    struct iovec iov[2];
+    iov[0].iov_base = &cab;
+    iov[0].iov_len = sizeof(cab);
+    iov[1].iov_base = (void *)dados;
+    iov[1].iov_len = n;
+
+    controle_t controle;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = n > 0 ? 2 : 1;
+    if (nfds > 0) {
+        msg.msg_control = controle.buf;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * (size_t)nfds);
+        struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_RIGHTS;
+        cm->cmsg_len = CMSG_LEN(sizeof(int) * (size_t)nfds);
+        memcpy(CMSG_DATA(cm), fds, sizeof(int) * (size_t)nfds);
+    }
+
+    while (sendmsg(canal_fd, &msg, MSG_NOSIGNAL) < 0) {
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Recebe um registro inteiro; os descritores anexados vão para fds
+ * @return 0 em sucesso, -1 em erro ou EOF (errno definido)
+ */
+static int receber_registro(int fd, cabecalho_t *cab, char *dados, int *fds, int *nfds) {
+    struct iovec iov[2];
+    iov[0].iov_base = cab;
+    iov[0].iov_len = sizeof(*cab);
+    iov[1].iov_base = dados;
+    iov[1].iov_len = DADOS_MAX;
+
+    controle_t controle;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    msg.msg_control = controle.buf;
+    msg.msg_controllen = sizeof(controle.buf);
+
+    ssize_t n;
+    do {
+        n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        if (n == 0) {
+            errno = ECONNRESET;  // processo antigo saiu antes do fim
+        }
+        return -1;
+    }
+
+    *nfds = 0;
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+        if (cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+        int quantidade = (int)((cm->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        memcpy(fds + *nfds, CMSG_DATA(cm), sizeof(int) * (size_t)quantidade);
+        *nfds += quantidade;
+    }
+
+    if ((size_t)n < sizeof(*cab) || (size_t)n - sizeof(*cab) != cab->bytes ||
+        (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC))) {
+        for (int i = 0; i < *nfds; i++) {
+            close(fds[i]);
+        }
+        errno = EPROTO;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Recria a conexão a partir do descritor recebido e do quadro parcial
+ * @return herdada ou NULL (cliente saiu durante a troca ou sem memória)
+ */
+static herdada_t *herdar(int fd, const cabecalho_t *cab, const char *dados) {
+    struct sockaddr_storage addr;
+    socklen_t addr_len = sizeof(addr);
+    if (getpeername(fd, (struct sockaddr *)&addr, &addr_len) < 0) {
+        close(fd);
+        return NULL;
+    }
+    // Conexão do socket Unix (sem canal shm): sem endereço, como no accept local
+    const struct sockaddr_in *inet = addr.ss_family == AF_INET ? (const struct sockaddr_in *)&addr : NULL;
+
+    herdada_t *h = calloc(1, sizeof(herdada_t));
+    conexao_t *c = h ? conexao_criar(fd, inet) : NULL;
+    if (c == NULL) {
+        log_server_error("alocação da conexão herdada", errno);
+        free(h);
+        close(fd);
+        return NULL;
+    }
+    proto_ring_escrever(&c->ring, dados, cab->bytes);
+    h->c = c;
+    memcpy(h->sala, cab->sala, SALA_NOME_MAX);
+    h->sala[SALA_NOME_MAX - 1] = '\0';
+    return h;
+}
+
+int transferencia_receber(const char *caminho, int *escutas, int max) {
+    struct sockaddr_un addr;
+    if (preencher_endereco(&addr, caminho) != 0) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        int err = errno;
+        close(fd);
+        // Sem processo antigo (arquivo ausente ou abandonado): início normal
+        if (err == ENOENT || err == ECONNREFUSED) {
+            return 0;
+        }
+        errno = err;
+        return -1;
+    }
+
+    char *dados = malloc(DADOS_MAX);
+    if (dados == NULL) {
+        close(fd);
+        return -1;
+    }
+
+    int num_escutas = 0;
+    size_t num_conexoes = 0;
+    herdada_t *cauda = NULL;
+    herdada_t *ultima = NULL;    // dona dos próximos registros de saída
+    while (1) {
+        cabecalho_t cab;
+        int fds[MAX_REACTORS];
+        int nfds;
+        if (receber_registro(fd, &cab, dados, fds, &nfds) != 0) {
+            log_server_error("recepção da transferência", errno);
+            break;
+        }
+        if (cab.tipo == REGISTRO_FIM) {
+            break;
+        }
+
+        if (cab.tipo == REGISTRO_ESCUTA) {
+            for (int i = 0; i < nfds; i++) {
+                if (num_escutas < max) {
+                    escutas[num_escutas++] = fds[i];
+                } else {
+                    close(fds[i]);
+                }
+            }
+        } else if (cab.tipo == REGISTRO_CONEXAO && nfds == 1) {
+            herdada_t *h = herdar(fds[0], &cab, dados);
+            if (h == NULL) {
+                ultima = NULL;  // a saída que vier a seguir é descartada
+                continue;
+            }
+            if (cauda) {
+                cauda->prox = h;
+            } else {
+                herdadas = h;
+            }
+            cauda = h;
+            ultima = h;
+            num_conexoes++;
+        } else if (cab.tipo == REGISTRO_SAIDA && ultima != NULL) {
+            char *saida = realloc(ultima->saida, ultima->saida_bytes + cab.bytes);
+            if (saida == NULL) {
+                log_server_error("alocação da saída herdada", errno);
+                continue;
+            }
+            memcpy(saida + ultima->saida_bytes, dados, cab.bytes);
+            ultima->saida = saida;
+            ultima->saida_bytes += cab.bytes;
+        } else {
+            for (int i = 0; i < nfds; i++) {
+                close(fds[i]);
+            }
+        }
+    }
+    free(dados);
+    close(fd);
+
+    char msg[150];
+    snprintf(msg, sizeof(msg), "Hot upgrade: %d socket(s) de escuta e %zu conexões herdadas",
+             num_escutas, num_conexoes);
+    tsqueue_push(&msg_queue, msg);
+    return num_escutas;
+}
+
+herdada_t *transferencia_proxima(void) {
+    herdada_t *h = herdadas;
+    if (h != NULL) {
+        herdadas = h->prox;
+        h->prox = NULL;
+    }
+    return h;
+}
+
+static void liberar_herdada(herdada_t *h) {
+    free(h->saida);
+    free(h);
+}
+
+conexao_t *transferencia_adotar(herdada_t *h, laco_t *laco) {
+    conexao_t *c = h->c;
+    if (conexao_registrar(c, laco) < 0 || add_client(c) != 0) {
+        reject_client(c->fd);
+        conexao_encerrar(c);
+        conexao_unref(c);
+        liberar_herdada(h);
+        return NULL;
+    }
+
+    // A saída herdada sai antes de qualquer quadro novo; um bloco perdido
+    // quebraria o enquadramento do resto, então a conexão é encerrada
+    for (size_t i = 0; i < h->saida_bytes; i += TRANSFERENCIA_BLOCO) {
+        size_t n = h->saida_bytes - i < TRANSFERENCIA_BLOCO ? h->saida_bytes - i : TRANSFERENCIA_BLOCO;
+        quadro_t *q = quadro_copiar(h->saida + i, n);
+        int resultado = q ? conexao_enfileirar(c, q) : -1;
+        if (q) {
+            quadro_unref(q);
+        }
+        if (resultado != 0) {
+            conexao_encerrar(c);
+            break;
+        }
+    }
+
+    if (sala_entrar(c, h->sala[0] ? h->sala : SALA_PADRAO) != 0) {
+        log_server_error("sala da conexão herdada", errno);
+    }
+    liberar_herdada(h);
+    return c;
+}
+
+void transferencia_descartar(herdada_t *h) {
+    conexao_encerrar(h->c);
+    conexao_unref(h->c);
+    liberar_herdada(h);
+}
+
+/**
+ * Thread que espera o sucessor: entrega os sockets de escuta e pede o
+ * shutdown dos laços, que passam a guardar as conexões em vez de fechá-las
+ */
+static void *aguardar_sucessor(void *arg) {
+    (void)arg;
+    while (!shutdown_requested) {
+        fd_set leitura;
+        FD_ZERO(&leitura);
+        FD_SET(escuta_fd, &leitura);
+        struct timeval timeout = { 1, 0 };
+        if (select(escuta_fd + 1, &leitura, NULL, NULL, &timeout) <= 0) {
+            continue;
+        }
+        int fd = accept4(escuta_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+
+        // Os sockets de escuta seguem abertos: conexões novas esperam na
+        // fila do kernel até o sucessor voltar a aceitar
+        canal_fd = fd;
+        if (enviar_registro(REGISTRO_ESCUTA, NULL, NULL, 0, escutas_proprias, num_escutas_proprias) != 0) {
+            log_server_error("envio dos sockets de escuta", errno);
+            close(fd);
+            canal_fd = -1;
+            continue;
+        }
+        atomic_store(&ativa, 1);
+        shutdown_requested = 1;
+        tsqueue_push(&msg_queue, "Hot upgrade: sucessor conectado, transferindo conexões");
+        break;
+    }
+    return NULL;
+}
+
+int transferencia_iniciar(const char *caminho, const int *escutas, int n) {
+    struct sockaddr_un addr;
+    if (preencher_endereco(&addr, caminho) != 0) {
+        return -1;
+    }
+    escuta_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (escuta_fd < 0) {
+        return -1;
+    }
+
+    // O arquivo pode ser do processo anterior (que já entregou tudo) ou de
+    // um que terminou sem removê-lo
+    unlink(caminho);
+    if (bind(escuta_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(escuta_fd, 1) < 0) {
+        int err = errno;
+        close(escuta_fd);
+        escuta_fd = -1;
+        errno = err;
+        return -1;
+    }
+    strcpy(escuta_caminho, caminho);
+    memcpy(escutas_proprias, escutas, sizeof(int) * (size_t)n);
+    num_escutas_proprias = n;
+
+    int err = pthread_create(&escuta_tid, NULL, aguardar_sucessor, NULL);
+    if (err != 0) {
+        close(escuta_fd);
+        escuta_fd = -1;
+        unlink(caminho);
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+int transferencia_ativa(void) {
+    return atomic_load(&ativa);
+}
+
+int transferencia_guardar(conexao_t *c) {
+    // O canal em memória compartilhada não atravessa o hot upgrade: o
+    // cliente recebe o fim da conexão e reconecta
+    if (!atomic_load(&ativa) || c->shm != NULL) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&guardadas_mutex);
+    if (!concluida && num_guardadas == cap_guardadas) {
+        size_t nova = cap_guardadas ? cap_guardadas * 2 : REGISTRO_CAPACIDADE_INICIAL;
+        conexao_t **itens = realloc(guardadas, nova * sizeof(conexao_t *));
+        if (itens != NULL) {
+            guardadas = itens;
+            cap_guardadas = nova;
+        }
+    }
+    if (concluida || num_guardadas == cap_guardadas) {
+        pthread_mutex_unlock(&guardadas_mutex);
+        return -1;
+    }
+    conexao_transferir(c);
+    conexao_ref(c);
+    guardadas[num_guardadas++] = c;
+    pthread_mutex_unlock(&guardadas_mutex);
+    return 0;
+}
+
+static size_t contar_guardadas(void) {
+    pthread_mutex_lock(&guardadas_mutex);
+    size_t n = num_guardadas;
+    pthread_mutex_unlock(&guardadas_mutex);
+    return n;
+}
+
+/**
+ * Copia os bytes ainda não processados do anel de recepção (quadro parcial)
+ */
+static size_t copiar_recepcao(const proto_ring_t *r, char *dst) {
+    size_t n = r->fim - r->inicio;
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = r->dados[(r->inicio + i) & (r->capacidade - 1)];
+    }
+    return n;
+}
+
+/**
+ * Envia o socket, a sala e o quadro parcial; depois a saída pendente em blocos
+ */
+static int enviar_conexao(conexao_t *c, char *entrada) {
+    size_t n = copiar_recepcao(&c->ring, entrada);
+    if (enviar_registro(REGISTRO_CONEXAO, c->sala ? c->sala->nome : NULL, entrada, n, &c->fd, 1) != 0) {
+        return -1;
+    }
+
+    char *saida;
+    size_t bytes = conexao_extrair_saida(c, &saida);
+    int resultado = 0;
+    for (size_t i = 0; i < bytes && resultado == 0; i += TRANSFERENCIA_BLOCO) {
+        size_t bloco = bytes - i < TRANSFERENCIA_BLOCO ? bytes - i : TRANSFERENCIA_BLOCO;
+        resultado = enviar_registro(REGISTRO_SAIDA, NULL, saida + i, bloco, NULL, 0);
+    }
+    free(saida);
+    return resultado;
+}
+
+void transferencia_concluir(void) {
+    if (!atomic_load(&ativa)) {
+        return;
+    }
+
+    // As threads por cliente só percebem o shutdown no timeout do próprio
+    // epoll: espera todas guardarem as conexões (nos demais modos os laços
+    // já terminaram e a contagem confere na hora)
+    for (int ms = 0; ms < TRANSFERENCIA_ESPERA_MS && contar_guardadas() < registro_contar(); ms += 10) {
+        struct timespec ts = { 0, 10 * 1000000L };
+        nanosleep(&ts, NULL);
+    }
+    pthread_mutex_lock(&guardadas_mutex);
+    concluida = 1;
+    pthread_mutex_unlock(&guardadas_mutex);
+
+    static char entrada[PROTO_RING_CAPACIDADE];
+    size_t transferidas = 0;
+    int falhou = 0;
+    for (size_t i = 0; i < num_guardadas; i++) {
+        conexao_t *c = guardadas[i];
+        if (!falhou && enviar_conexao(c, entrada) == 0) {
+            transferidas++;
+        } else {
+            // Sucessor perdido: o resto é encerrado como em um shutdown comum
+            if (!falhou) {
+                log_server_error("envio das conexões", errno);
+            }
+            falhou = 1;
+            conexao_encerrar(c);
+        }
+        remove_client(c);
+        sala_sair(c);
+        conexao_unref(c);
+    }
+    if (!falhou && enviar_registro(REGISTRO_FIM, NULL, NULL, 0, NULL, 0) != 0) {
+        log_server_error("fim da transferência", errno);
+    }
+    close(canal_fd);
+    canal_fd = -1;
+    free(guardadas);
+    guardadas = NULL;
+    num_guardadas = 0;
+
+    char msg[100];
+    snprintf(msg, sizeof(msg), "Hot upgrade: %zu conexões transferidas", transferidas);
+    tsqueue_push(&msg_queue, msg);
+}
+
+void transferencia_encerrar(void) {
+    if (escuta_fd < 0) {
+        return;
+    }
+    shutdown(escuta_fd, SHUT_RDWR);  // acorda o select da thread
+    pthread_join(escuta_tid, NULL);
+    close(escuta_fd);
+    escuta_fd = -1;
+
+    // Depois de uma transferência o caminho já é do sucessor
+    if (!atomic_load(&ativa)) {
+        unlink(escuta_caminho);
+    }
+}
@@ -0,0 +1,805 @@
+#define _GNU_SOURCE
+#include "../include/uring.h"
+#include "../include/servidor.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <linux/io_uring.h>
+
+#define URING_CQ_ENTRADAS (URING_ENTRADAS * 8)
+#define URING_GRUPO_BUFFERS 0
+#define URING_TIMEOUT_S 1
+#define URING_DRENAGEM_MAX 5     // esperas pelas operações em voo no shutdown
+
+// Tipo da operação nos bits baixos de user_data (o resto aponta para a conexão)
+enum {
+    OP_ACEITAR = 1,
+    OP_RECEBER,
+    OP_ENVIAR,
+    OP_TEMPORIZADOR,
+    OP_PRAZO,
+    OP_CANCELAR,
+    OP_MASCARA = 7
+};
+// Accept do socket Unix: bit acima do tipo (não há conexão em user_data)
+#define ACEITE_LOCAL 8
+
+// Estado de uma conexão no backend: operações em voo e o envio corrente
+typedef struct uring_conexao {
+    conexao_t *c;
+    int operacoes;        // SQEs em voo que apontam para esta estrutura
+    int fechada;          // close_client já executado
+    int enviando;         // há um SENDMSG em voo (no máximo um por conexão)
+    int recebendo;        // há um RECV em voo
+    int parada;           // recepção cancelada pelo limite de taxa até a retomada
+    char *retido;         // recebido com o anel cheio durante a suspensão
+    size_t retido_bytes;
+    struct msghdr msg;
+    struct iovec iov[SAIDA_MAX_IOV];
+    struct uring_conexao *ant;
+    struct uring_conexao *prox;
+} uring_conexao_t;
+
+typedef struct {
+    laco_t laco;
+    int fd;
+    int listen_fd;
+
+    // Anel de submissão (a cauda local só é publicada no io_uring_enter)
+    unsigned *sq_cabeca;
+    unsigned *sq_cauda;
+    unsigned *sq_mascara;
+    unsigned *sq_array;
+    unsigned sq_entradas;
+    unsigned sq_local;
+    struct io_uring_sqe *sqes;
+
+    // Anel de conclusão
+    unsigned *cq_cabeca;
+    unsigned *cq_cauda;
+    unsigned *cq_mascara;
+    struct io_uring_cqe *cqes;
+
+    void *mapa;
+    size_t mapa_tamanho;
+    size_t sqes_tamanho;
+
+    // Buffers fornecidos ao kernel para a recepção (um por CQE de recv)
+    struct io_uring_buf_ring *buffers;
+    size_t buffers_tamanho;
+    char *areas;
+    unsigned short buffers_cauda;
+
+    int aceitar_multishot;
+    int receber_multishot;
+    struct __kernel_timespec intervalo;
+    struct __kernel_timespec prazo;     // fim da janela de coalescência ou da suspensão (absoluto)
+    uint64_t prazo_armado;              // prazo do último timeout armado (0 = nenhum)
+    int pausado;          // hot upgrade: sem novos recv/send até a transferência
+    uring_conexao_t *conexoes;
+    slab_t *slab;                       // estado das conexões (fixo por conexão)
+} uring_t;
+
+static int sys_setup(unsigned entradas, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entradas, p);
+}
+
+static int sys_enter(int fd, unsigned submeter, unsigned minimo, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, submeter, minimo, flags, NULL, 0);
+}
+
+static int sys_register(int fd, unsigned opcode, void *arg, unsigned n) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, n);
+}
+
+/**
+ * Devolve um buffer ao anel de buffers fornecidos
+ */
+static void devolver_buffer(uring_t *u, unsigned bid) {
+    struct io_uring_buf *b = &u->buffers->bufs[u->buffers_cauda & (URING_BUFFERS - 1)];
+    b->addr = (uintptr_t)(u->areas + (size_t)bid * URING_BUFFER_TAMANHO);
+    b->len = URING_BUFFER_TAMANHO;
+    b->bid = (unsigned short)bid;
+    u->buffers_cauda++;
+    __atomic_store_n(&u->buffers->tail, u->buffers_cauda, __ATOMIC_RELEASE);
+}
+
+/**
+ * Cria o anel, mapeia SQ/CQ/SQEs e registra os buffers de recepção.
+ * Exige IORING_FEAT_SINGLE_MMAP/NODROP e IORING_REGISTER_PBUF_RING (5.19+).
+ * @return 0 em sucesso, -1 se o kernel não oferece o necessário (errno definido)
+ */
+static int uring_abrir(uring_t *u) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_COOP_TASKRUN | IORING_SETUP_SINGLE_ISSUER;
+    p.cq_entries = URING_CQ_ENTRADAS;
+    u->fd = sys_setup(URING_ENTRADAS, &p);
+    if (u->fd < 0 && errno == EINVAL) {
+        // Kernels anteriores a 6.0: só o tamanho da CQ
+        memset(&p, 0, sizeof(p));
+        p.flags = IORING_SETUP_CQSIZE;
+        p.cq_entries = URING_CQ_ENTRADAS;
+        u->fd = sys_setup(URING_ENTRADAS, &p);
+    }
+    if (u->fd < 0) {
+        return -1;
+    }
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_NODROP)) {
+        close(u->fd);
+        errno = ENOTSUP;
+        return -1;
+    }
+
+    size_t sq_tamanho = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cq_tamanho = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    u->mapa_tamanho = sq_tamanho > cq_tamanho ? sq_tamanho : cq_tamanho;
+    u->mapa = mmap(NULL, u->mapa_tamanho, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   u->fd, IORING_OFF_SQ_RING);
+    if (u->mapa == MAP_FAILED) {
+        close(u->fd);
+        return -1;
+    }
+    u->sqes_tamanho = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(NULL, u->sqes_tamanho, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   u->fd, IORING_OFF_SQES);
+    if (u->sqes == MAP_FAILED) {
+        munmap(u->mapa, u->mapa_tamanho);
+        close(u->fd);
+        return -1;
+    }
+
+    char *base = u->mapa;
+    u->sq_cabeca = (unsigned *)(base + p.sq_off.head);
+    u->sq_cauda = (unsigned *)(base + p.sq_off.tail);
+    u->sq_mascara = (unsigned *)(base + p.sq_off.ring_mask);
+    u->sq_array = (unsigned *)(base + p.sq_off.array);
+    u->sq_entradas = p.sq_entries;
+    u->sq_local = *u->sq_cauda;
+    u->cq_cabeca = (unsigned *)(base + p.cq_off.head);
+    u->cq_cauda = (unsigned *)(base + p.cq_off.tail);
+    u->cq_mascara = (unsigned *)(base + p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *)(base + p.cq_off.cqes);
+
+    u->buffers_tamanho = URING_BUFFERS * sizeof(struct io_uring_buf);
+    u->buffers = mmap(NULL, u->buffers_tamanho, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    u->areas = malloc((size_t)URING_BUFFERS * URING_BUFFER_TAMANHO);
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uintptr_t)u->buffers;
+    reg.ring_entries = URING_BUFFERS;
+    reg.bgid = URING_GRUPO_BUFFERS;
+    if (u->buffers == MAP_FAILED || u->areas == NULL ||
+        sys_register(u->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        int err = errno;
+        if (u->buffers != MAP_FAILED) {
+            munmap(u->buffers, u->buffers_tamanho);
+        }
+        free(u->areas);
+        munmap(u->sqes, u->sqes_tamanho);
+        munmap(u->mapa, u->mapa_tamanho);
+        close(u->fd);
+        errno = err;
+        return -1;
+    }
+    for (unsigned i = 0; i < URING_BUFFERS; i++) {
+        devolver_buffer(u, i);
+    }
+
+    u->aceitar_multishot = 1;
+    u->receber_multishot = 1;
+    u->intervalo.tv_sec = URING_TIMEOUT_S;
+    u->intervalo.tv_nsec = 0;
+    return 0;
+}
+
+static void uring_fechar(uring_t *u) {
+    close(u->fd);
+    munmap(u->buffers, u->buffers_tamanho);
+    free(u->areas);
+    munmap(u->sqes, u->sqes_tamanho);
+    munmap(u->mapa, u->mapa_tamanho);
+}
+
+/**
+ * Publica as SQEs preparadas e opcionalmente espera conclusões, tudo em um
+ * único io_uring_enter
+ * @return resultado de io_uring_enter (-1 com errno em erro)
+ */
+static int submeter(uring_t *u, unsigned esperar) {
+    __atomic_store_n(u->sq_cauda, u->sq_local, __ATOMIC_RELEASE);
+    unsigned novas = u->sq_local - __atomic_load_n(u->sq_cabeca, __ATOMIC_ACQUIRE);
+    if (novas == 0 && esperar == 0) {
+        return 0;
+    }
+    return sys_enter(u->fd, novas, esperar, esperar ? IORING_ENTER_GETEVENTS : 0);
+}
+
+/**
+ * Reserva a próxima SQE; com a SQ cheia o lote atual é entregue ao kernel
+ * @return SQE zerada ou NULL se a SQ continua cheia
+ */
+static struct io_uring_sqe *obter_sqe(uring_t *u) {
+    if (u->sq_local - __atomic_load_n(u->sq_cabeca, __ATOMIC_ACQUIRE) == u->sq_entradas) {
+        submeter(u, 0);
+        if (u->sq_local - __atomic_load_n(u->sq_cabeca, __ATOMIC_ACQUIRE) == u->sq_entradas) {
+            return NULL;
+        }
+    }
+    unsigned idx = u->sq_local & *u->sq_mascara;
+    struct io_uring_sqe *sqe = &u->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    u->sq_array[idx] = idx;
+    u->sq_local++;
+    return sqe;
+}
+
+static void preparar_aceitar(uring_t *u, int local) {
+    struct io_uring_sqe *sqe = obter_sqe(u);
+    if (sqe == NULL) {
+        log_server_error("io_uring accept", EBUSY);
+        return;
+    }
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = local ? local_escuta() : u->listen_fd;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->ioprio = u->aceitar_multishot ? IORING_ACCEPT_MULTISHOT : 0;
+    sqe->user_data = OP_ACEITAR | (local ? ACEITE_LOCAL : 0);
+}
+
+static void preparar_temporizador(uring_t *u) {
+    struct io_uring_sqe *sqe = obter_sqe(u);
+    if (sqe == NULL) {
+        return;
+    }
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = (uintptr_t)&u->intervalo;
+    sqe->len = 1;
+    sqe->user_data = OP_TEMPORIZADOR;
+}
+
+/**
+ * Timeout absoluto no prazo mais próximo do laço (adiado pela coalescência
+ * ou conexão suspensa); o kernel copia o timespec na submissão
+ */
+static void preparar_prazo(uring_t *u, uint64_t prazo_ns) {
+    struct io_uring_sqe *sqe = obter_sqe(u);
+    if (sqe == NULL) {
+        return;
+    }
+    u->prazo.tv_sec = (long long)(prazo_ns / 1000000000ULL);
+    u->prazo.tv_nsec = (long long)(prazo_ns % 1000000000ULL);
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = (uintptr_t)&u->prazo;
+    sqe->len = 1;
+    sqe->timeout_flags = IORING_TIMEOUT_ABS;
+    sqe->user_data = OP_PRAZO;
+    u->prazo_armado = prazo_ns;
+}
+
+/**
+ * Arma a recepção: multishot com buffer escolhido pelo kernel no grupo
+ * fornecido (um único SQE entrega todas as leituras até o EOF)
+ */
+static int preparar_receber(uring_t *u, uring_conexao_t *uc) {
+    if (u->pausado) {
+        return 0;  // hot upgrade: o processo novo lê o que chegar
+    }
+    struct io_uring_sqe *sqe = obter_sqe(u);
+    if (sqe == NULL) {
+        return -1;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = uc->c->fd;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_GRUPO_BUFFERS;
+    sqe->ioprio = u->receber_multishot ? IORING_RECV_MULTISHOT : 0;
+    sqe->len = u->receber_multishot ? 0 : URING_BUFFER_TAMANHO;
+    sqe->user_data = (uintptr_t)uc | OP_RECEBER;
+    uc->operacoes++;
+    uc->recebendo = 1;
+    return 0;
+}
+
+/**
+ * Prepara um SENDMSG com o próximo lote da fila de saída. Os quadros ficam
+ * na fila até a conclusão; mensagens enfileiradas enquanto o envio está em
+ * voo saem no lote seguinte.
+ * @return 0 em sucesso, -1 se não há SQE disponível
+ */
+static int enviar(uring_t *u, uring_conexao_t *uc) {
+    if (uc->fechada || uc->enviando || u->pausado) {
+        return 0;
+    }
+    size_t n = conexao_preparar_envio(uc->c, uc->iov, SAIDA_MAX_IOV);
+    if (n == 0) {
+        return 0;
+    }
+    struct io_uring_sqe *sqe = obter_sqe(u);
+    if (sqe == NULL) {
+        return -1;
+    }
+    memset(&uc->msg, 0, sizeof(uc->msg));
+    uc->msg.msg_iov = uc->iov;
+    uc->msg.msg_iovlen = n;
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = uc->c->fd;
+    sqe->addr = (uintptr_t)&uc->msg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = (uintptr_t)uc | OP_ENVIAR;
+    uc->enviando = 1;
+    uc->operacoes++;
+    return 0;
+}
+
+/**
+ * Cancela a operação multishot de user_data (a conclusão final chega com
+ * -ECANCELED, depois das que o kernel já tinha produzido)
+ */
+static int preparar_cancelar(uring_t *u, uint64_t alvo) {
+    struct io_uring_sqe *sqe = obter_sqe(u);
+    if (sqe == NULL) {
+        return -1;
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = alvo;
+    sqe->user_data = OP_CANCELAR;
+    return 0;
+}
+
+/**
+ * Callback de flush do laço: as conexões com saída nesta iteração ganham um
+ * SENDMSG cada, submetidos juntos no próximo io_uring_enter
+ */
+static int descarregar(laco_t *laco, conexao_t *c) {
+    uring_t *u = (uring_t *)((char *)laco - offsetof(uring_t, laco));
+    uring_conexao_t *uc = c->transporte;
+    if (uc == NULL) {
+        return 0;
+    }
+    return enviar(u, uc);
+}
+
+/**
+ * Encerra a conexão uma única vez; as operações em voo terminam com EOF/erro
+ * após o shutdown do socket
+ */
+static void fechar(uring_conexao_t *uc) {
+    if (uc->fechada) {
+        return;
+    }
+    uc->fechada = 1;
+    close_client(uc->c);
+}
+
+/**
+ * Libera o estado da conexão quando ela está fechada e sem operações em voo
+ */
+static void liberar_se_ociosa(uring_t *u, uring_conexao_t *uc) {
+    if (!uc->fechada || uc->operacoes > 0) {
+        return;
+    }
+    if (uc->ant) {
+        uc->ant->prox = uc->prox;
+    } else {
+        u->conexoes = uc->prox;
+    }
+    if (uc->prox) {
+        uc->prox->ant = uc->ant;
+    }
+    uc->c->transporte = NULL;
+    conexao_unref(uc->c);
+    free(uc->retido);
+    slab_liberar(u->slab, uc);
+}
+
+/**
+ * Cria o estado do backend para a conexão; ele guarda a própria referência
+ * até a última operação
+ */
+static uring_conexao_t *instalar(uring_t *u, conexao_t *c) {
+    uring_conexao_t *uc = slab_alocar(u->slab);
+    if (uc == NULL) {
+        return NULL;
+    }
+    memset(uc, 0, sizeof(*uc));
+    conexao_ref(c);
+    uc->c = c;
+    c->transporte = uc;
+    uc->prox = u->conexoes;
+    if (u->conexoes) {
+        u->conexoes->ant = uc;
+    }
+    u->conexoes = uc;
+    return uc;
+}
+
+static void aceitar_cliente(uring_t *u, int client_fd) {
+    // Verificar se há slots disponíveis
+    if (registro_contar() >= registro_limite()) {
+        reject_client(client_fd);
+        close(client_fd);
+        return;
+    }
+
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    if (getpeername(client_fd, (struct sockaddr *)&addr, &addr_len) < 0) {
+        log_server_error("getpeername", errno);
+        close(client_fd);
+        return;
+    }
+    conexao_t *c = conexao_criar(client_fd, &addr);
+    if (c == NULL) {
+        log_server_error("alocação da conexão", errno);
+        close(client_fd);
+        return;
+    }
+    uring_conexao_t *uc = instalar(u, c);
+    if (uc == NULL) {
+        log_server_error("alocação da conexão", errno);
+        conexao_unref(c);
+        return;
+    }
+    conexao_registrar(c, &u->laco);
+
+    if (add_client(c) != 0) {
+        reject_client(c->fd);
+        conexao_encerrar(c);
+        conexao_unref(c);
+        uc->fechada = 1;
+        liberar_se_ociosa(u, uc);
+        return;
+    }
+    if (preparar_receber(u, uc) != 0 || announce_client_join(c) != 0) {
+        fechar(uc);
+        liberar_se_ociosa(u, uc);
+        return;
+    }
+    printf("👥 Clientes conectados: %d/%zu (io_uring)\n", count_connected_clients(), registro_limite());
+}
+
+/**
+ * Adota uma conexão herdada no hot upgrade: a saída herdada entra nos
+ * pendentes do laço e sai no primeiro SENDMSG
+ */
+static void adotar_cliente(uring_t *u, herdada_t *h) {
+    uring_conexao_t *uc = instalar(u, h->c);
+    if (uc == NULL) {
+        log_server_error("alocação da conexão", errno);
+        transferencia_descartar(h);
+        return;
+    }
+    if (transferencia_adotar(h, &u->laco) == NULL) {
+        uc->fechada = 1;
+        liberar_se_ociosa(u, uc);
+        return;
+    }
+    if (preparar_receber(u, uc) != 0) {
+        fechar(uc);
+        liberar_se_ociosa(u, uc);
+    }
+}
+
+static void tratar_aceite(uring_t *u, const struct io_uring_cqe *cqe) {
+    int local = (cqe->user_data & ACEITE_LOCAL) != 0;
+    if (cqe->res >= 0) {
+        aceitar_cliente(u, cqe->res);
+    } else if (cqe->res == -EINVAL && u->aceitar_multishot) {
+        u->aceitar_multishot = 0;  // kernel sem accept multishot (< 5.19)
+    } else if (cqe->res != -ECANCELED) {
+        log_server_error("accept", -cqe->res);
+    }
+
+    if (!(cqe->flags & IORING_CQE_F_MORE) && !shutdown_requested) {
+        preparar_aceitar(u, local);
+    }
+}
+
+/**
+ * Copia o buffer recebido para o anel da conexão e processa os quadros
+ * completos; o anel sempre tem espaço para o resto após o processamento,
+ * a não ser com a conexão suspensa pelo limite de taxa
+ * @return bytes consumidos (menos que n só na suspensão), -1 se a conexão deve ser encerrada
+ */
+static ssize_t consumir_recepcao(conexao_t *c, const char *dados, size_t n) {
+    size_t total = 0;
+    while (total < n) {
+        size_t copiados = proto_ring_escrever(&c->ring, dados + total, n - total);
+        if (process_client_frames(c) < 0) {
+            return -1;
+        }
+        if (copiados == 0) {
+            if (c->retomar_ns != 0) {
+                break;
+            }
+            return -1;
+        }
+        total += copiados;
+    }
+    return (ssize_t)total;
+}
+
+/**
+ * Entrega a recepção à conexão. Suspensa e com o anel cheio, o resto fica
+ * retido em ordem e a recepção é cancelada até a retomada, para que o TCP
+ * segure o cliente em vez de a memória do servidor.
+ * @return 0 se a conexão continua, -1 se deve ser encerrada
+ */
+static int receber_dados(uring_t *u, uring_conexao_t *uc, const char *dados, size_t n) {
+    size_t consumidos = 0;
+    if (uc->retido_bytes == 0) {
+        ssize_t r = consumir_recepcao(uc->c, dados, n);
+        if (r < 0) {
+            return -1;
+        }
+        consumidos = (size_t)r;
+    }
+    if (consumidos == n) {
+        return 0;
+    }
+
+    char *retido = realloc(uc->retido, uc->retido_bytes + n - consumidos);
+    if (retido == NULL) {
+        return -1;
+    }
+    memcpy(retido + uc->retido_bytes, dados + consumidos, n - consumidos);
+    uc->retido = retido;
+    uc->retido_bytes += n - consumidos;
+    if (!uc->parada) {
+        uc->parada = 1;
+        if (uc->recebendo && u->receber_multishot &&
+            preparar_cancelar(u, (uintptr_t)uc | OP_RECEBER) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Fim da suspensão: processa o anel e o que ficou retido e, se a conexão
+ * não voltou a ser suspensa, rearma a recepção
+ */
+static void retomar(uring_t *u, uring_conexao_t *uc) {
+    conexao_t *c = uc->c;
+    if (process_client_frames(c) < 0) {
+        fechar(uc);
+        return;
+    }
+    if (uc->retido_bytes > 0) {
+        ssize_t r = consumir_recepcao(c, uc->retido, uc->retido_bytes);
+        if (r < 0) {
+            fechar(uc);
+            return;
+        }
+        uc->retido_bytes -= (size_t)r;
+        memmove(uc->retido, uc->retido + r, uc->retido_bytes);
+    }
+    if (uc->parada && uc->retido_bytes == 0 && c->retomar_ns == 0) {
+        uc->parada = 0;
+        if (!uc->recebendo && preparar_receber(u, uc) != 0) {
+            fechar(uc);
+        }
+    }
+}
+
+static void tratar_recepcao(uring_t *u, uring_conexao_t *uc, const struct io_uring_cqe *cqe) {
+    int mais = cqe->flags & IORING_CQE_F_MORE;
+    if (!mais) {
+        uc->operacoes--;
+        uc->recebendo = 0;
+    }
+
+    if (cqe->res > 0) {
+        metricas_somar(METRICA_BYTES_RECEBIDOS, (uint64_t)cqe->res);
+        unsigned bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        const char *dados = u->areas + (size_t)bid * URING_BUFFER_TAMANHO;
+        if (!uc->fechada && receber_dados(u, uc, dados, (size_t)cqe->res) < 0) {
+            fechar(uc);
+        }
+        devolver_buffer(u, bid);
+    } else if (cqe->res == -ENOBUFS || (cqe->res == -ECANCELED && (u->pausado || uc->parada))) {
+        // Buffers esgotados no meio do lote: já foram devolvidos, basta rearmar
+        // (cancelado no hot upgrade: o socket segue para o processo novo;
+        // cancelado pelo limite de taxa: a retomada rearma)
+    } else if (cqe->res == -EINVAL && u->receber_multishot) {
+        u->receber_multishot = 0;  // kernel sem recv multishot (< 6.0)
+    } else {
+        fechar(uc);  // 0 = cliente fechou a conexão; negativo = erro
+    }
+
+    if (!mais && !uc->fechada && !uc->parada && preparar_receber(u, uc) != 0) {
+        fechar(uc);
+    }
+    liberar_se_ociosa(u, uc);
+}
+
+static void tratar_envio(uring_t *u, uring_conexao_t *uc, const struct io_uring_cqe *cqe) {
+    uc->operacoes--;
+    uc->enviando = 0;
+
+    if (cqe->res < 0) {
+        mark_socket_for_removal(uc->c);
+        fechar(uc);
+    } else {
+        conexao_confirmar_envio(uc->c, (size_t)cqe->res);
+        if (enviar(u, uc) != 0) {
+            fechar(uc);
+        }
+    }
+    liberar_se_ociosa(u, uc);
+}
+
+/**
+ * Consome todas as conclusões disponíveis no anel
+ */
+static void processar_conclusoes(uring_t *u) {
+    unsigned cabeca = *u->cq_cabeca;
+    while (cabeca != __atomic_load_n(u->cq_cauda, __ATOMIC_ACQUIRE)) {
+        struct io_uring_cqe cqe = u->cqes[cabeca & *u->cq_mascara];
+        cabeca++;
+        __atomic_store_n(u->cq_cabeca, cabeca, __ATOMIC_RELEASE);
+
+        uring_conexao_t *uc = (uring_conexao_t *)(uintptr_t)(cqe.user_data & ~(uint64_t)OP_MASCARA);
+        switch (cqe.user_data & OP_MASCARA) {
+        case OP_ACEITAR:
+            tratar_aceite(u, &cqe);
+            break;
+        case OP_RECEBER:
+            tratar_recepcao(u, uc, &cqe);
+            break;
+        case OP_ENVIAR:
+            tratar_envio(u, uc, &cqe);
+            break;
+        case OP_TEMPORIZADOR:
+            // Acorda o laço para verificar o shutdown e coletar o registro
+            preparar_temporizador(u);
+            break;
+        case OP_PRAZO:
+            u->prazo_armado = 0;
+            break;
+        }
+    }
+}
+
+/**
+ * Hot upgrade: cancela os recv e espera os SENDMSG em voo, para que nenhuma
+ * operação do anel leia ou escreva no socket depois de ele ser transferido
+ */
+static void pausar(uring_t *u) {
+    u->pausado = 1;
+    preparar_cancelar(u, OP_ACEITAR);
+    if (local_escuta() >= 0) {
+        preparar_cancelar(u, OP_ACEITAR | ACEITE_LOCAL);
+    }
+    for (uring_conexao_t *uc = u->conexoes; uc; uc = uc->prox) {
+        if (!uc->fechada && preparar_cancelar(u, (uintptr_t)uc | OP_RECEBER) != 0) {
+            break;
+        }
+    }
+    for (int i = 0; i < URING_DRENAGEM_MAX; i++) {
+        int em_voo = 0;
+        for (uring_conexao_t *uc = u->conexoes; uc && !em_voo; uc = uc->prox) {
+            em_voo = !uc->fechada && uc->operacoes > 0;
+        }
+        if (!em_voo || (submeter(u, 1) < 0 && errno != EINTR)) {
+            break;
+        }
+        processar_conclusoes(u);
+    }
+}
+
+/**
+ * Event loop io_uring: accept e recv multishot, recepção em buffers
+ * fornecidos e envios em lote. Cada iteração faz um único io_uring_enter que
+ * submete os SENDMSG da iteração anterior e espera novas conclusões.
+ * @return 0 ao finalizar, -1 em erro, URING_INDISPONIVEL se o kernel não suporta
+ */
+int uring_executar(int listen_fd) {
+    uring_t *u = calloc(1, sizeof(uring_t));
+    if (u == NULL) {
+        log_server_error("alocação do io_uring", errno);
+        return -1;
+    }
+    if (uring_abrir(u) != 0) {
+        log_server_error("io_uring", errno);
+        free(u);
+        return URING_INDISPONIVEL;
+    }
+
+    u->slab = slab_criar("uring", sizeof(uring_conexao_t), 1);
+    if (u->slab == NULL) {
+        log_server_error("slab das conexões do io_uring", ENOMEM);
+        uring_fechar(u);
+        free(u);
+        return -1;
+    }
+
+    u->listen_fd = listen_fd;
+    laco_iniciar(&u->laco, -1);
+    u->laco.descarregar = descarregar;
+    laco_definir_atual(&u->laco);
+    RASTRO_NOMEAR("uring");
+
+    preparar_aceitar(u, 0);
+    if (local_escuta() >= 0) {
+        preparar_aceitar(u, 1);
+    }
+    preparar_temporizador(u);
+
+    // Conexões herdadas de um hot upgrade
+    for (herdada_t *h; (h = transferencia_proxima()) != NULL;) {
+        adotar_cliente(u, h);
+    }
+
+    int resultado = 0;
+    while (!shutdown_requested) {
+        if (submeter(u, 1) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            log_server_error("io_uring_enter", errno);
+            resultado = -1;
+            break;
+        }
+        processar_conclusoes(u);
+
+        // Conexões cuja suspensão pelo limite de taxa terminou
+        for (conexao_t *c; (c = laco_retomar(&u->laco, 0)) != NULL;) {
+            uring_conexao_t *uc = c->transporte;
+            if (uc != NULL && !uc->fechada) {
+                retomar(u, uc);
+                liberar_se_ociosa(u, uc);
+            }
+            conexao_unref(c);
+        }
+
+        // Um SENDMSG por conexão com tudo o que foi enfileirado nesta iteração
+        laco_descarregar(&u->laco);
+        uint64_t prazo = laco_proximo_prazo(&u->laco);
+        if (prazo != 0 && (u->prazo_armado == 0 || prazo < u->prazo_armado)) {
+            preparar_prazo(u, prazo);
+        }
+
+        // Conexões removidas cujo período de graça já terminou
+        registro_coletar();
+    }
+
+    // Shutdown: fecha as conexões e espera as operações em voo terminarem
+    if (transferencia_ativa()) {
+        pausar(u);
+    }
+    for (uring_conexao_t *uc = u->conexoes, *prox; uc; uc = prox) {
+        prox = uc->prox;
+        fechar(uc);
+        liberar_se_ociosa(u, uc);
+    }
+    laco_finalizar(&u->laco);
+    for (int i = 0; u->conexoes && i < URING_DRENAGEM_MAX; i++) {
+        if (submeter(u, 1) < 0 && errno != EINTR) {
+            break;
+        }
+        processar_conclusoes(u);
+    }
+    laco_definir_atual(NULL);
+
+    // Fechar o anel cancela o que restou em voo
+    uring_fechar(u);
+    while (u->conexoes) {
+        uring_conexao_t *uc = u->conexoes;
+        uc->operacoes = 0;
+        liberar_se_ociosa(u, uc);
+    }
+    free(u);
+    return resultado;
+}
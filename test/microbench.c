@@ -0,0 +1,458 @@
+#define _GNU_SOURCE
+#include "../include/libtslog.h"
+#include "../include/fila_threadsafe.h"
+#include "../include/histograma.h"
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <getopt.h>
+
+/*
+ * Microbenchmarks da fila (tsqueue_push/tsqueue_pop) e das entradas da
+ * libtslog. Cada combinação de produtores x tamanho de mensagem (x capacidade
+ * da fila) vira um resultado com ops/s e histograma de latência por chamada,
+ * gravados em JSON para comparar builds. O resumo legível vai para stderr.
+ */
+
+#define MICRO_MAX_LISTA 16
+#define MICRO_OPS_PADRAO 200000
+#define MICRO_AMOSTRAGEM 16          // mede a latência de 1 a cada N chamadas
+#define MICRO_ARQUIVO_LOG "microbench.log"
+#define MICRO_ARQUIVO_BIN "microbench.bin"
+
+typedef struct {
+    int valores[MICRO_MAX_LISTA];
+    int n;
+} lista_t;
+
+typedef struct {
+    lista_t produtores;
+    lista_t tamanhos;
+    lista_t capacidades;
+    long ops;                        // chamadas por thread produtora
+    int fila;
+    int log;
+    const char *saida;
+} config_micro_t;
+
+// Entradas da libtslog medidas
+typedef enum {
+    ENTRADA_ESCREVER,
+    ENTRADA_VERBOSE,
+    ENTRADA_ERRO,
+    ENTRADA_EVENTO,
+    ENTRADA_QUANTIDADE
+} entrada_t;
+
+static const char *const nomes_entrada[] = {
+    "log_escrever", "log_escrever_verbose", "log_erro", "log_evento"
+};
+
+typedef struct {
+    pthread_t tid;
+    long ops;
+    size_t tamanho;
+    ThreadSafeQueue *fila;
+    logger_t *log;
+    entrada_t entrada;
+    histograma_t latencia;
+} trabalhador_t;
+
+static config_micro_t cfg;
+static FILE *saida_json;
+static int resultados_gravados = 0;
+static atomic_int largada;           // libera as threads juntas
+
+static uint64_t agora_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void esperar_largada(void) {
+    while (!atomic_load_explicit(&largada, memory_order_acquire)) {
+    }
+}
+
+/**
+ * Grava um resultado no JSON e uma linha de resumo em stderr
+ */
+static void gravar_resultado(const char *suite, const char *operacao, const char *modo,
+                             int produtores, size_t tamanho, size_t capacidade,
+                             uint64_t ops, double segundos, const histograma_t *h) {
+    fprintf(saida_json, "%s\n    {\"suite\":\"%s\",\"operacao\":\"%s\",\"modo\":\"%s\","
+            "\"produtores\":%d,\"tamanho\":%zu,\"capacidade\":%zu,"
+            "\"ops\":%llu,\"segundos\":%.6f,\"ops_s\":%.1f,"
+            "\"latencia_ns\":{\"amostras\":%llu,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,"
+            "\"p999\":%llu,\"max\":%llu},\"histograma\":[",
+            resultados_gravados ? "," : "", suite, operacao, modo, produtores, tamanho, capacidade,
+            (unsigned long long)ops, segundos, ops / segundos,
+            (unsigned long long)h->contagem,
+            (unsigned long long)hist_percentil(h, 50.0), (unsigned long long)hist_percentil(h, 90.0),
+            (unsigned long long)hist_percentil(h, 99.0), (unsigned long long)hist_percentil(h, 99.9),
+            (unsigned long long)h->max);
+
+    // Só as faixas ocupadas: [limite inferior em ns, contagem]
+    int primeiro = 1;
+    for (int i = 0; i < HIST_FAIXAS; i++) {
+        if (h->faixas[i] == 0) {
+            continue;
+        }
+        fprintf(saida_json, "%s[%llu,%llu]", primeiro ? "" : ",",
+                (unsigned long long)hist_valor(i), (unsigned long long)h->faixas[i]);
+        primeiro = 0;
+    }
+    fprintf(saida_json, "]}");
+    resultados_gravados++;
+
+    fprintf(stderr, "%-5s %-21s %-6s P=%-2d tam=%-5zu cap=%-8zu %12.0f ops/s  p50=%6lluns p99=%7lluns\n",
+            suite, operacao, modo, produtores, tamanho, capacidade, ops / segundos,
+            (unsigned long long)hist_percentil(h, 50.0), (unsigned long long)hist_percentil(h, 99.0));
+}
+
+/* ---------------------------------------------------------------------------
+ * Fila: P produtores com tsqueue_push e um consumidor com tsqueue_pop
+ * ------------------------------------------------------------------------- */
+
+static void *produtor_fila(void *arg) {
+    trabalhador_t *t = arg;
+    char msg[MSG_SIZE];
+    memset(msg, 'a', t->tamanho - 1);
+    msg[t->tamanho - 1] = '\0';
+
+    esperar_largada();
+    for (long i = 0; i < t->ops; i++) {
+        if (i % MICRO_AMOSTRAGEM == 0) {
+            uint64_t inicio = agora_ns();
+            tsqueue_push(t->fila, msg);
+            hist_registrar(&t->latencia, agora_ns() - inicio);
+        } else {
+            tsqueue_push(t->fila, msg);
+        }
+    }
+    return NULL;
+}
+
+static void *consumidor_fila(void *arg) {
+    trabalhador_t *t = arg;
+    char msg[MSG_SIZE];
+
+    esperar_largada();
+    for (long i = 0; i < t->ops; i++) {
+        if (i % MICRO_AMOSTRAGEM == 0) {
+            uint64_t inicio = agora_ns();
+            tsqueue_pop(t->fila, msg);
+            hist_registrar(&t->latencia, agora_ns() - inicio);
+        } else {
+            tsqueue_pop(t->fila, msg);
+        }
+    }
+    return NULL;
+}
+
+static int medir_fila(int produtores, size_t tamanho, size_t capacidade) {
+    ThreadSafeQueue fila;
+    if (tsqueue_init(&fila, capacidade) != 0) {
+        return -1;
+    }
+    trabalhador_t *ts = calloc((size_t)produtores + 1, sizeof(trabalhador_t));
+    if (ts == NULL) {
+        tsqueue_destroy(&fila);
+        return -1;
+    }
+
+    atomic_store(&largada, 0);
+    trabalhador_t *consumidor = &ts[produtores];
+    consumidor->fila = &fila;
+    consumidor->ops = cfg.ops * produtores;
+    pthread_create(&consumidor->tid, NULL, consumidor_fila, consumidor);
+    for (int i = 0; i < produtores; i++) {
+        ts[i].fila = &fila;
+        ts[i].ops = cfg.ops;
+        ts[i].tamanho = tamanho;
+        pthread_create(&ts[i].tid, NULL, produtor_fila, &ts[i]);
+    }
+
+    uint64_t inicio = agora_ns();
+    atomic_store_explicit(&largada, 1, memory_order_release);
+    histograma_t *push = calloc(1, sizeof(histograma_t));
+    for (int i = 0; i < produtores; i++) {
+        pthread_join(ts[i].tid, NULL);
+        hist_somar(push, &ts[i].latencia);
+    }
+    pthread_join(consumidor->tid, NULL);
+    double segundos = (double)(agora_ns() - inicio) / 1e9;
+
+    // O consumidor só termina depois de retirar tudo: o tempo total vale para os dois lados
+    uint64_t total = (uint64_t)cfg.ops * (uint64_t)produtores;
+    gravar_resultado("fila", "tsqueue_push", "-", produtores, tamanho, capacidade, total, segundos, push);
+    gravar_resultado("fila", "tsqueue_pop", "-", produtores, tamanho, capacidade, total, segundos,
+                     &consumidor->latencia);
+
+    free(push);
+    free(ts);
+    tsqueue_destroy(&fila);
+    return 0;
+}
+
+/* ---------------------------------------------------------------------------
+ * libtslog: P threads chamando uma entrada, em modo síncrono e assíncrono
+ * ------------------------------------------------------------------------- */
+
+static void chamar_entrada(trabalhador_t *t, const char *msg, uint64_t id) {
+    switch (t->entrada) {
+    case ENTRADA_ESCREVER:
+        log_escrever(t->log, msg);
+        break;
+    case ENTRADA_VERBOSE:
+        log_escrever_verbose(t->log, msg);
+        break;
+    case ENTRADA_ERRO:
+        log_erro(t->log, msg, EIO);
+        break;
+    case ENTRADA_EVENTO:
+        log_evento(t->log, 3, id, msg, t->tamanho);
+        break;
+    default:
+        break;
+    }
+}
+
+static void *produtor_log(void *arg) {
+    trabalhador_t *t = arg;
+    char msg[MSG_SIZE];
+    memset(msg, 'a', t->tamanho - 1);
+    msg[t->tamanho - 1] = '\0';
+
+    esperar_largada();
+    for (long i = 0; i < t->ops; i++) {
+        if (i % MICRO_AMOSTRAGEM == 0) {
+            uint64_t inicio = agora_ns();
+            chamar_entrada(t, msg, (uint64_t)i);
+            hist_registrar(&t->latencia, agora_ns() - inicio);
+        } else {
+            chamar_entrada(t, msg, (uint64_t)i);
+        }
+    }
+    return NULL;
+}
+
+static int medir_log(entrada_t entrada, int assincrono, int produtores, size_t tamanho) {
+    unlink(MICRO_ARQUIVO_LOG);
+    unlink(MICRO_ARQUIVO_BIN);
+    logger_t *log = log_init(MICRO_ARQUIVO_LOG);
+    if (log == NULL) {
+        return -1;
+    }
+    if (entrada == ENTRADA_VERBOSE) {
+        log_set_verbose(log, 1);
+    }
+    if (assincrono && log_set_assincrono(log, LOG_LOTE_PADRAO, LOG_INTERVALO_MS_PADRAO) != 0) {
+        log_destruir(log);
+        return -1;
+    }
+    if (entrada == ENTRADA_EVENTO && log_abrir_binario(log, MICRO_ARQUIVO_BIN) != 0) {
+        log_destruir(log);
+        return -1;
+    }
+
+    trabalhador_t *ts = calloc((size_t)produtores, sizeof(trabalhador_t));
+    if (ts == NULL) {
+        log_destruir(log);
+        return -1;
+    }
+
+    // log_escrever_verbose e log_erro também escrevem no terminal: o stdout
+    // vai para /dev/null durante a medição (o custo da escrita é mantido)
+    int stdout_original = -1;
+    if (entrada == ENTRADA_VERBOSE || entrada == ENTRADA_ERRO) {
+        fflush(stdout);
+        stdout_original = dup(STDOUT_FILENO);
+        int nulo = open("/dev/null", O_WRONLY);
+        dup2(nulo, STDOUT_FILENO);
+        close(nulo);
+    }
+
+    atomic_store(&largada, 0);
+    for (int i = 0; i < produtores; i++) {
+        ts[i].log = log;
+        ts[i].entrada = entrada;
+        ts[i].ops = cfg.ops;
+        ts[i].tamanho = tamanho;
+        pthread_create(&ts[i].tid, NULL, produtor_log, &ts[i]);
+    }
+
+    uint64_t inicio = agora_ns();
+    atomic_store_explicit(&largada, 1, memory_order_release);
+    histograma_t *h = calloc(1, sizeof(histograma_t));
+    for (int i = 0; i < produtores; i++) {
+        pthread_join(ts[i].tid, NULL);
+        hist_somar(h, &ts[i].latencia);
+    }
+    double segundos = (double)(agora_ns() - inicio) / 1e9;
+
+    // Custo de tornar tudo durável (relevante no modo assíncrono)
+    histograma_t *flush = calloc(1, sizeof(histograma_t));
+    uint64_t inicio_flush = agora_ns();
+    log_flush(log);
+    hist_registrar(flush, agora_ns() - inicio_flush);
+    double segundos_total = (double)(agora_ns() - inicio) / 1e9;
+
+    log_destruir(log);
+    if (stdout_original >= 0) {
+        fflush(stdout);
+        dup2(stdout_original, STDOUT_FILENO);
+        close(stdout_original);
+    }
+
+    const char *modo = assincrono ? "async" : "sync";
+    uint64_t total = (uint64_t)cfg.ops * (uint64_t)produtores;
+    gravar_resultado("log", nomes_entrada[entrada], modo, produtores, tamanho, 0, total, segundos, h);
+    gravar_resultado("log", "log_flush", modo, produtores, tamanho, 0, total, segundos_total, flush);
+
+    free(flush);
+    free(h);
+    free(ts);
+    unlink(MICRO_ARQUIVO_LOG);
+    unlink(MICRO_ARQUIVO_BIN);
+    return 0;
+}
+
+/**
+ * Lê uma lista "1,2,4,8"
+ * @return 0 em sucesso, -1 se vazia ou com valor inválido
+ */
+static int parse_lista(const char *texto, lista_t *l) {
+    l->n = 0;
+    while (*texto != '\0' && l->n < MICRO_MAX_LISTA) {
+        char *fim;
+        long v = strtol(texto, &fim, 10);
+        if (fim == texto || v <= 0) {
+            return -1;
+        }
+        l->valores[l->n++] = (int)v;
+        texto = (*fim == ',') ? fim + 1 : fim;
+        if (*fim != ',' && *fim != '\0') {
+            return -1;
+        }
+    }
+    return l->n > 0 ? 0 : -1;
+}
+
+/**
+ * Interpreta os argumentos de linha de comando
+ * @return 0 em sucesso, -1 se houver argumento inválido
+ */
+static int parse_args(int argc, char *argv[]) {
+    static const struct option opcoes[] = {
+        {"produtores",  required_argument, NULL, 'p'},
+        {"tamanhos",    required_argument, NULL, 't'},
+        {"capacidades", required_argument, NULL, 'c'},
+        {"ops",         required_argument, NULL, 'n'},
+        {"suite",       required_argument, NULL, 's'},
+        {"saida",       required_argument, NULL, 'o'},
+        {"help",        no_argument,       NULL, 'h'},
+        {NULL,          0,                 NULL, 0}
+    };
+    int opt;
+
+    parse_lista("1,2,4,8", &cfg.produtores);
+    parse_lista("16,128,1000", &cfg.tamanhos);
+    parse_lista("4096,65536,1048576", &cfg.capacidades);
+    cfg.ops = MICRO_OPS_PADRAO;
+    cfg.fila = 1;
+    cfg.log = 1;
+    cfg.saida = "microbench.json";
+
+    while ((opt = getopt_long(argc, argv, "p:t:c:n:s:o:h", opcoes, NULL)) != -1) {
+        int ok = 0;
+        switch (opt) {
+        case 'p':
+            ok = parse_lista(optarg, &cfg.produtores) == 0;
+            break;
+        case 't':
+            ok = parse_lista(optarg, &cfg.tamanhos) == 0;
+            for (int i = 0; ok && i < cfg.tamanhos.n; i++) {
+                ok = cfg.tamanhos.valores[i] >= 2 && cfg.tamanhos.valores[i] <= MSG_SIZE;
+            }
+            break;
+        case 'c':
+            ok = parse_lista(optarg, &cfg.capacidades) == 0;
+            break;
+        case 'n':
+            cfg.ops = atol(optarg);
+            ok = cfg.ops > 0;
+            break;
+        case 's':
+            ok = 1;
+            cfg.fila = strcmp(optarg, "fila") == 0 || strcmp(optarg, "todas") == 0;
+            cfg.log = strcmp(optarg, "log") == 0 || strcmp(optarg, "todas") == 0;
+            ok = cfg.fila || cfg.log;
+            break;
+        case 'o':
+            cfg.saida = optarg;
+            ok = 1;
+            break;
+        default:
+            break;
+        }
+        if (!ok) {
+            fprintf(stderr, "Uso: %s [--suite fila|log|todas] [--produtores 1,2,4,8]\n"
+                            "          [--tamanhos 16,128,1000] [--capacidades 4096,65536,1048576]\n"
+                            "          [--ops N] [--saida ARQUIVO.json]\n",
+                    argv[0]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (parse_args(argc, argv) != 0) {
+        return 1;
+    }
+    saida_json = fopen(cfg.saida, "w");
+    if (saida_json == NULL) {
+        perror(cfg.saida);
+        return 1;
+    }
+
+    fprintf(saida_json, "{\"versao\":1,\"timestamp\":%lld,\"cpus\":%ld,\"ops_por_thread\":%ld,"
+            "\"amostragem\":%d,\"resultados\":[",
+            (long long)time(NULL), sysconf(_SC_NPROCESSORS_ONLN), cfg.ops, MICRO_AMOSTRAGEM);
+
+    int erros = 0;
+    if (cfg.fila) {
+        for (int c = 0; c < cfg.capacidades.n; c++) {
+            for (int p = 0; p < cfg.produtores.n; p++) {
+                for (int t = 0; t < cfg.tamanhos.n; t++) {
+                    if (medir_fila(cfg.produtores.valores[p], (size_t)cfg.tamanhos.valores[t],
+                                   (size_t)cfg.capacidades.valores[c]) != 0) {
+                        erros++;
+                    }
+                }
+            }
+        }
+    }
+    if (cfg.log) {
+        for (int e = 0; e < ENTRADA_QUANTIDADE; e++) {
+            for (int modo = 0; modo <= 1; modo++) {
+                for (int p = 0; p < cfg.produtores.n; p++) {
+                    for (int t = 0; t < cfg.tamanhos.n; t++) {
+                        if (medir_log((entrada_t)e, modo, cfg.produtores.valores[p],
+                                      (size_t)cfg.tamanhos.valores[t]) != 0) {
+                            erros++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    fprintf(saida_json, "\n  ]}\n");
+    fclose(saida_json);
+    fprintf(stderr, "%d resultado(s) gravado(s) em %s\n", resultados_gravados, cfg.saida);
+    return erros ? 1 : 0;
+}